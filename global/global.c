@@ -38,6 +38,17 @@
 #ifdef HAVE_UNISTD_H
 #include <unistd.h>
 #endif
+#ifdef HAVE_FCNTL_H
+#include <fcntl.h>
+#endif
+#if defined(HAVE_SYS_MMAN_H) && defined(HAVE_MMAP)
+#include <sys/mman.h>
+#define USE_MMAP
+#endif
+#if defined(HAVE_PTHREAD_H) && defined(HAVE_PTHREAD)
+#include <pthread.h>
+#define USE_THREADS
+#endif
 #include "getopt.h"
 
 #include "global.h"
@@ -48,17 +59,21 @@
 static void usage(void);
 static void help(void);
 static void setcom(int);
+static void querykey(STRBUF *, int, char **);
+static void print_query_statistics(void);
 int decide_tag_by_context(const char *, const char *, int);
 int main(int, char **);
-int completion_tags(const char *, const char *, const char *, int);
+int completion_tags(const char *, const char *, const char *, int, int);
 void completion(const char *, const char *, const char *, int);
 void completion_idutils(const char *, const char *, const char *);
 void completion_path(const char *, const char *);
+void fuzzysearch(const char *, const char *, const char *, int);
+void patternsearch(const char *, const char *, const char *, const char *, int);
 void idutils(const char *, const char *);
 void grep(const char *, char *const *, const char *);
 void pathlist(const char *, const char *);
 void parsefile(char *const *, const char *, const char *, const char *, int);
-int search(const char *, const char *, const char *, const char *, int);
+int search(const char *, const char *, const char *, const char *, int, int);
 void tagsearch(const char *, const char *, const char *, const char *, int);
 void encode(char *, int, const char *);
 
@@ -87,6 +102,7 @@ int uflag;				/* command		*/
 int vflag;				/* [option]		*/
 int Vflag;				/* [option]		*/
 int xflag;				/* [option]		*/
+int fuzzy;				/* command		*/
 int show_version;
 int show_help;
 int nofilter;
@@ -97,12 +113,21 @@ int print0;				/* -print0 option	*/
 int format;
 int type;				/* path conversion type */
 int match_part;				/* match part only	*/
+int max_count;				/* --max-count=N	*/
+int truncated;				/* output was truncated	*/
 const char *cwd, *root, *dbpath;
 char *context_file;
 char *context_lineno;
 char *file_list;
 char *encode_chars;
 char *single_update;
+char *patterns_from;			/* --patterns-from=FILE	*/
+int statistics = STATISTICS_STYLE_NONE;	/* --statistics	*/
+const char *pattern_label;		/* pattern printed with each record */
+int pattern_prefix;			/* 1: the pattern is a prefix */
+int keep_gtop;				/* 1: keep the tag file open */
+GTOP *kept_gtop;			/* tag file kept open */
+char kept_dbpath[MAXPATHLEN];		/* dbpath of kept_gtop */
 
 static void
 usage(void)
@@ -124,6 +149,10 @@ help(void)
 #define ENCODE_PATH	130
 #define MATCH_PART	131
 #define SINGLE_UPDATE	132
+#define MAX_COUNT	133
+#define FUZZY_SEARCH	134
+#define PATTERNS_FROM	135
+#define STATISTICS	136
 #define SORT_FILTER     1
 #define PATH_FILTER     2
 #define BOTH_FILTER     (SORT_FILTER|PATH_FILTER)
@@ -162,18 +191,32 @@ static struct option const long_options[] = {
 	/* long name only */
 	{"encode-path", required_argument, NULL, ENCODE_PATH},
 	{"from-here", required_argument, NULL, FROM_HERE},
+	{"fuzzy", no_argument, NULL, FUZZY_SEARCH},
+	{"patterns-from", required_argument, NULL, PATTERNS_FROM},
 	{"debug", no_argument, &debug, 1},
 	{"literal", no_argument, &literal, 1},
 	{"match-part", required_argument, NULL, MATCH_PART},
+	{"max-count", required_argument, NULL, MAX_COUNT},
 	{"print0", no_argument, &print0, 1},
 	{"version", no_argument, &show_version, 1},
 	{"help", no_argument, &show_help, 1},
 	{"result", required_argument, NULL, RESULT},
 	{"nosource", no_argument, &nosource, 1},
 	{"single-update", required_argument, NULL, SINGLE_UPDATE},
+	{"statistics", optional_argument, NULL, STATISTICS},
 	{ 0 }
 };
 
+/*
+ * print_query_statistics: print statistics at exit (--statistics).
+ */
+static void
+print_query_statistics(void)
+{
+	libpath_close();		/* add the counters of the library trees */
+	dbop_statistics();
+	print_statistics(statistics);
+}
 static int command;
 static void
 setcom(int c)
@@ -202,12 +245,12 @@ setcom(int c)
 int
 decide_tag_by_context(const char *tag, const char *file, int lineno)
 {
-	STRBUF *sb = NULL;
 	char path[MAXPATHLEN], s_fid[MAXFIDLEN];
 	const char *tagline, *p;
-	DBOP *dbop;
+	DBOP *dbop = NULL;
 	int db = GSYMS;
 	int iscompline = 0;
+	int defined;
 
 	if (normalize(file, get_root_with_slash(), cwd, path, sizeof(path)) == NULL)
 		die("'%s' is out of the source project.", file);
@@ -219,13 +262,27 @@ decide_tag_by_context(const char *tag, const char *file, int lineno)
 	if ((p = gpath_path2fid(path, NULL)) == NULL)
 		die("path name in the context is not found.");
 	strlimcpy(s_fid, p, sizeof(s_fid));
+	/*
+	 * If the definition index of the file is available, it tells whether
+	 * the tag is defined at the line. (See libutil/defindex.c)
+	 */
+	defined = defindex_lookup(s_fid, tag, lineno);
 	gpath_close();
+	if (defined > 0) {
+		db = GRTAGS;
+		goto finish;
+	}
 	/*
 	 * read btree records directly to avoid the overhead.
 	 */
 	dbop = dbop_open(makepath(dbpath, dbname(GTAGS), NULL), 0, 0, 0);
 	if (dbop == NULL)
 		die("cannot open GTAGS.");
+	if (defined == 0) {
+		if (dbop_first(dbop, tag, NULL, 0) != NULL)
+			db = GTAGS;
+		goto finish;
+	}
 	if (dbop_getoption(dbop, COMPLINEKEY))
 		iscompline = 1;
 	tagline = dbop_first(dbop, tag, NULL, 0);
@@ -286,31 +343,19 @@ decide_tag_by_context(const char *tag, const char *file, int lineno)
 		}
 	}
 finish:
-	dbop_close(dbop);
+	if (dbop)
+		dbop_close(dbop);
 	if (db == GSYMS && getenv("GTAGSLIBPATH")) {
-		char libdbpath[MAXPATHLEN];
-		char *libdir = NULL, *nextp = NULL;
-
-		sb = strbuf_open(0);
-		strbuf_puts(sb, getenv("GTAGSLIBPATH"));
-		for (libdir = strbuf_value(sb); libdir; libdir = nextp) {
-			 if ((nextp = locatestring(libdir, PATHSEP, MATCH_FIRST)) != NULL)
-                                *nextp++ = 0;
-			if (!gtagsexist(libdir, libdbpath, sizeof(libdbpath), 0))
-				continue;
-			if (!strcmp(dbpath, libdbpath))
-				continue;
-			dbop = dbop_open(makepath(libdbpath, dbname(GTAGS), NULL), 0, 0, 0);
-			if (dbop == NULL)
-				continue;
-			tagline = dbop_first(dbop, tag, NULL, 0);
-			dbop_close(dbop);
-			if (tagline != NULL) {
+		LIBTREE *trees;
+		int i, n = libpath_open(dbpath, &trees);
+
+		libpath_probe(tag, 0);
+		for (i = 0; i < n; i++) {
+			if (trees[i].status == LIBPATH_HIT) {
 				db = GTAGS;
 				break;
 			}
 		}
-		strbuf_close(sb);
 	}
 	return db;
 }
@@ -318,6 +363,8 @@ int
 main(int argc, char **argv)
 {
 	const char *av = NULL;
+	char **args = argv;
+	int nargs = argc;
 	int db;
 	int optchar;
 	int option_index = 0;
@@ -449,6 +496,18 @@ main(int argc, char **argv)
 			else
 				die_with_code(2, "unknown part type for the --match-part option.");
 			break;
+		case FUZZY_SEARCH:
+			fuzzy++;
+			setcom(optchar);
+			break;
+		case PATTERNS_FROM:
+			patterns_from = optarg;
+			break;
+		case MAX_COUNT:
+			max_count = atoi(optarg);
+			if (max_count <= 0)
+				die_with_code(2, "invalid number for the --max-count option.");
+			break;
 		case RESULT:
 			if (!strcmp(optarg, "ctags-x"))
 				format = FORMAT_CTAGS_X;
@@ -470,6 +529,16 @@ main(int argc, char **argv)
 		case SINGLE_UPDATE:
 			single_update = optarg;
 			break;
+		case STATISTICS:
+			if (optarg == NULL || !strcmp(optarg, "table"))
+				statistics = STATISTICS_STYLE_TABLE;
+			else if (!strcmp(optarg, "list"))
+				statistics = STATISTICS_STYLE_LIST;
+			else if (!strcmp(optarg, "tsv"))
+				statistics = STATISTICS_STYLE_TSV;
+			else
+				die_with_code(2, "unknown style for the --statistics option.");
+			break;
 		default:
 			usage();
 			break;
@@ -511,6 +580,14 @@ main(int argc, char **argv)
 		vflag = 0;
 	if (show_help)
 		help();
+	/*
+	 * Statistics are printed at exit, since several commands exit
+	 * from the middle of processing.
+	 */
+	if (statistics != STATISTICS_STYLE_NONE) {
+		init_statistics();
+		atexit(print_query_statistics);
+	}
 
 	argc -= optind;
 	argv += optind;
@@ -537,10 +614,15 @@ main(int argc, char **argv)
 			;	/* ignored */
 		}
 	}
+	/*
+	 * --patterns-from is a tag search whose patterns are read from a file.
+	 */
+	if (patterns_from && (command != 0 || av))
+		usage();
 	/*
 	 * only -c, -u, -P and -p allows no argument.
 	 */
-	if (!av) {
+	if (!av && !patterns_from) {
 		switch (command) {
 		case 'c':
 		case 'u':
@@ -661,6 +743,15 @@ main(int argc, char **argv)
 		else
 			db = (rflag) ? GRTAGS : ((sflag) ? GSYMS : GTAGS);
 	}
+	/*
+	 * fuzzy search of tag names.
+	 */
+	if (fuzzy) {
+		fuzzysearch(dbpath, root, av, db);
+		if (truncated && !qflag)
+			warning("output truncated. (--max-count=%d)", max_count);
+		exit(0);
+	}
 	/*
 	 * complete function name
 	 */
@@ -671,6 +762,8 @@ main(int argc, char **argv)
 			completion_path(dbpath, av);
 		else
 			completion(dbpath, root, av, db);
+		if (truncated && !qflag)
+			warning("output truncated. (--max-count=%d)", max_count);
 		exit(0);
 	}
 	/*
@@ -746,11 +839,84 @@ main(int argc, char **argv)
 	/*
 	 * tag search.
 	 */
+	else if (patterns_from) {
+		patternsearch(patterns_from, cwd, root, dbpath, db);
+	}
 	else {
-		tagsearch(av, cwd, root, dbpath, db);
+		STRBUF *key = strbuf_open(0);
+
+		querykey(key, nargs, args);
+		if (vflag || querycache_begin(dbpath, strbuf_value(key), strbuf_getlen(key)) != 1) {
+			tagsearch(av, cwd, root, dbpath, db);
+			querycache_end(!truncated);
+		}
+		strbuf_close(key);
 	}
+	if (truncated && !qflag)
+		warning("output truncated. (--max-count=%d)", max_count);
 	return 0;
 }
+/*
+ * querykey: make key of the query cache.
+ *
+ *	o)	sb	key
+ *	i)	argc	argc of main()
+ *	i)	argv	argv of main()
+ *
+ * The key includes everything which affects the output except for
+ * the tag files. (See libutil/querycache.c)
+ */
+static void
+querykey(STRBUF *sb, int argc, char **argv)
+{
+	static const char *envs[] = {
+		"GTAGSLIBPATH", "GTAGSCONF", "GTAGSLABEL", "GTAGSTHROUGH", "GTAGSBLANKENCODE", NULL
+	};
+	const char *p;
+	int i;
+
+	for (i = 1; i < argc; i++)
+		strbuf_puts0(sb, argv[i]);
+	strbuf_putc(sb, '\n');
+	strbuf_puts0(sb, cwd);
+	strbuf_puts0(sb, root);
+	for (i = 0; envs[i]; i++) {
+		if ((p = getenv(envs[i])) != NULL) {
+			strbuf_puts(sb, envs[i]);
+			strbuf_putc(sb, '=');
+			strbuf_puts0(sb, p);
+		}
+	}
+}
+/*
+ * Key reader for completion.
+ *
+ * If the key dictionary is available, keys are read from it.
+ * Otherwise, they are read from the tag file.
+ */
+static GTOP *key_gtop;
+static KEYDICT *key_dict;
+
+static const char *
+key_first(const char *prefix, int flags)
+{
+	GTP *gtp;
+
+	if (key_dict)
+		return keydict_first(key_dict, prefix);
+	gtp = gtags_first(key_gtop, prefix, flags);
+	return gtp ? gtp->tag : NULL;
+}
+static const char *
+key_next(void)
+{
+	GTP *gtp;
+
+	if (key_dict)
+		return keydict_next(key_dict);
+	gtp = gtags_next(key_gtop);
+	return gtp ? gtp->tag : NULL;
+}
 /*
  * completion_tags: print completion list of specified prefix
  *
@@ -758,15 +924,22 @@ main(int argc, char **argv)
  *	i)	root	root directory
  *	i)	prefix	prefix of primary key
  *	i)	db	GTAGS,GRTAGS,GSYMS
+ *	i)	limit	max number of words (-1: unlimited)
  *	r)		number of words
  */
 int
-completion_tags(const char *dbpath, const char *root, const char *prefix, int db)
+completion_tags(const char *dbpath, const char *root, const char *prefix, int db, int limit)
 {
 	int flags = GTOP_KEY;
-	GTOP *gtop = gtags_open(dbpath, root, db, GTAGS_READ, 0);
-	GTP *gtp;
+	const char *key;
 	int count = 0;
+	unsigned long nkey = 0;
+	STATISTICS_TIME *tim;
+
+	tim = statistics_time_start("Time of reading keys of %s", dbname(db));
+	key_gtop = NULL;
+	if ((key_dict = keydict_open(dbpath, db)) == NULL)
+		key_gtop = gtags_open(dbpath, root, db, GTAGS_READ, 0);
 
 	if (prefix && isalpha(*prefix) && iflag) {
 		/*
@@ -803,9 +976,14 @@ completion_tags(const char *dbpath, const char *root, const char *prefix, int db
 		for (i = 0; i < 2; i++) {
 			strbuf_reset(sb);
 			strbuf_putc(sb, firstchar[i]);
-			for (gtp = gtags_first(gtop, strbuf_value(sb), flags); gtp; gtp = gtags_next(gtop)) {
-				if (regexec(&preg, gtp->tag, 0, 0, 0) == 0) {
-					fputs(gtp->tag, stdout);
+			for (key = key_first(strbuf_value(sb), flags); key; key = key_next()) {
+				nkey++;
+				if (regexec(&preg, key, 0, 0, 0) == 0) {
+					if (limit >= 0 && count >= limit) {
+						truncated = 1;
+						break;
+					}
+					fputs(key, stdout);
 					fputc('\n', stdout);
 					count++;
 				}
@@ -816,13 +994,31 @@ completion_tags(const char *dbpath, const char *root, const char *prefix, int db
 		flags |= GTOP_NOREGEX;
 		if (prefix)
 			flags |= GTOP_PREFIX;
-		for (gtp = gtags_first(gtop, prefix, flags); gtp; gtp = gtags_next(gtop)) {
-			fputs(gtp->tag, stdout);
+		/*
+		 * Read one more word to know whether the output is truncated.
+		 */
+		if (limit >= 0 && key_gtop)
+			key_gtop->limit = limit + 1;
+		for (key = key_first(prefix, flags); key; key = key_next()) {
+			nkey++;
+			if (limit >= 0 && count >= limit) {
+				truncated = 1;
+				break;
+			}
+			fputs(key, stdout);
 			fputc('\n', stdout);
 			count++;
 		}
 	}
-	gtags_close(gtop);
+	if (key_dict) {
+		keydict_close(key_dict);
+		statistics_count("Keys read from " KEYDICT_NAME, nkey);
+	} else {
+		gtags_close(key_gtop);
+		statistics_count("Keys read from tag file", nkey);
+	}
+	statistics_time_end(tim);
+	statistics_count("Lines output", count);
 	return count;
 }
 /*
@@ -837,40 +1033,33 @@ void
 completion(const char *dbpath, const char *root, const char *prefix, int db)
 {
 	int count, total = 0;
-	char libdbpath[MAXPATHLEN];
 
 	if (prefix && *prefix == 0)	/* In the case global -c '' */
 		prefix = NULL;
-	count = completion_tags(dbpath, root, prefix, db);
+	count = completion_tags(dbpath, root, prefix, db, max_count > 0 ? max_count : -1);
+	total += count;
 	/*
 	 * search in library path.
 	 */
 	if (db == GTAGS && getenv("GTAGSLIBPATH") && (count == 0 || Tflag) && !lflag) {
-		STRBUF *sb = strbuf_open(0);
-		char *libdir, *nextp = NULL;
+		LIBTREE *trees;
+		int i, n = libpath_open(dbpath, &trees);
 
-		strbuf_puts(sb, getenv("GTAGSLIBPATH"));
 		/*
-		* search for each tree in the library path.
-		*/
-		for (libdir = strbuf_value(sb); libdir; libdir = nextp) {
-			if ((nextp = locatestring(libdir, PATHSEP, MATCH_FIRST)) != NULL)
-				*nextp++ = 0;
-			if (!gtagsexist(libdir, libdbpath, sizeof(libdbpath), 0))
-				continue;
-			if (!strcmp(dbpath, libdbpath))
-				continue;
-			if (!test("f", makepath(libdbpath, dbname(db), NULL)))
+		 * Trees which don't have the prefix are skipped.
+		 */
+		libpath_probe(iflag ? NULL : prefix, 1);
+		for (i = 0; i < n && !truncated; i++) {
+			if (trees[i].status == LIBPATH_MISS)
 				continue;
 			/*
 			 * search again
 			 */
-			count = completion_tags(libdbpath, libdir, prefix, db);
+			count = completion_tags(trees[i].dbpath, trees[i].root, prefix, db, max_count > 0 ? max_count - total : -1);
 			total += count;
 			if (count > 0 && !Tflag)
 				break;
 		}
-		strbuf_close(sb);
 	}
 	/* return total; */
 }
@@ -935,16 +1124,16 @@ completion_idutils(const char *dbpath, const char *root, const char *prefix)
 void
 completion_path(const char *dbpath, const char *prefix)
 {
-	GFIND *gp;
+	GFIND *gp = NULL;
 	const char *localprefix = "./";
-	DBOP *dbop = dbop_open(NULL, 1, 0600, DBOP_RAW);
+	DBOP *dbop = NULL;
+	KEYDICT *kd[2];
 	const char *path;
 	int prefix_length;
 	int target = GPATH_SOURCE;
 	int flags = (match_part == MATCH_PART_LAST) ? MATCH_LAST : MATCH_FIRST;
+	int i, started, nkd = 0;
 
-	if (dbop == NULL)
-		die("cannot open temporary file.");
 	if (prefix && *prefix == 0)	/* In the case global -c '' */
 		prefix = NULL;
 	prefix_length = (prefix == NULL) ? 0 : strlen(prefix);
@@ -954,8 +1143,46 @@ completion_path(const char *dbpath, const char *prefix)
 		target = GPATH_OTHER;
 	if (iflag || getconfb("icase_path"))
 		flags |= IGNORE_CASE;
-	gp = gfind_open(dbpath, localprefix, target);
-	while ((path = gfind_read(gp)) != NULL) {
+	/*
+	 * The key dictionary has the path names of each type in sorted order.
+	 * If only one type is required and no prefix is specified,
+	 * we need not sort them again.
+	 */
+	if (target & GPATH_SOURCE && (kd[nkd] = keydict_open(dbpath, KEYDICT_SOURCE)) != NULL)
+		nkd++;
+	if (target & GPATH_OTHER && (kd[nkd] = keydict_open(dbpath, KEYDICT_OTHER)) != NULL)
+		nkd++;
+	if (nkd != (target == GPATH_BOTH ? 2 : 1)) {
+		for (i = 0; i < nkd; i++)
+			keydict_close(kd[i]);
+		nkd = 0;
+		gp = gfind_open(dbpath, localprefix, target);
+	} else if (prefix == NULL && nkd == 1) {
+		for (path = keydict_first(kd[0], localprefix); path; path = keydict_next(kd[0])) {
+			fputs(path + 2, stdout);
+			fputc('\n', stdout);
+		}
+		keydict_close(kd[0]);
+		return;
+	}
+	dbop = dbop_open(NULL, 1, 0600, DBOP_RAW);
+	if (dbop == NULL)
+		die("cannot open temporary file.");
+	for (i = started = 0; ; ) {
+		if (gp) {
+			if ((path = gfind_read(gp)) == NULL)
+				break;
+		} else {
+			if (i >= nkd)
+				break;
+			path = started ? keydict_next(kd[i]) : keydict_first(kd[i], localprefix);
+			started = 1;
+			if (path == NULL) {
+				i++;
+				started = 0;
+				continue;
+			}
+		}
 		path++;					/* skip '.'*/
 		if (prefix == NULL) {
 			dbop_put(dbop, path + 1, "");
@@ -973,13 +1200,157 @@ completion_path(const char *dbpath, const char *prefix)
 			}
 		}
 	}
-	gfind_close(gp);
+	if (gp)
+		gfind_close(gp);
+	for (i = 0; i < nkd; i++)
+		keydict_close(kd[i]);
 	for (path = dbop_first(dbop, NULL, NULL, DBOP_KEY); path != NULL; path = dbop_next(dbop)) {
 		fputs(path, stdout);
 		fputc('\n', stdout);
 	}
 	dbop_close(dbop);
 }
+/*
+ * Candidates of fuzzy search.
+ */
+struct fuzzy_candidate {
+	char *name;			/* tag name */
+	int score;			/* score of the match */
+	int length;			/* length of the name */
+};
+/*
+ * compare_candidate: compare candidates.
+ *
+ *	r)		<0: c1 is better than c2, >0: c1 is worse than c2
+ *
+ * A candidate with the higher score is better. If the scores are the same,
+ * the shorter name is better. At last, names are compared.
+ */
+static int
+compare_candidate(const void *v1, const void *v2)
+{
+	const struct fuzzy_candidate *c1 = v1, *c2 = v2;
+
+	if (c1->score != c2->score)
+		return c2->score - c1->score;
+	if (c1->length != c2->length)
+		return c1->length - c2->length;
+	return strcmp(c1->name, c2->name);
+}
+/*
+ * add_candidate: add a candidate.
+ *
+ *	i)	vb	array of candidates
+ *	i)	name	tag name
+ *	i)	score	score
+ *	i)	limit	max number of candidates (0: unlimited)
+ *
+ * If the number of candidates is limited, the array is a heap whose root
+ * is the worst candidate. A new candidate replaces the root if it is better.
+ */
+static void
+add_candidate(VARRAY *vb, const char *name, int score, int limit)
+{
+	struct fuzzy_candidate cand, tmp, *heap;
+	int i, child;
+
+	cand.name = (char *)name;
+	cand.score = score;
+	cand.length = strlen(name);
+	if (limit == 0 || vb->length < limit) {
+		heap = varray_append(vb);
+		*heap = cand;
+		heap->name = check_strdup(name);
+		if (limit == 0)
+			return;
+		/* sift up */
+		heap = varray_assign(vb, 0, 0);
+		for (i = vb->length - 1; i > 0 && compare_candidate(&heap[i], &heap[(i - 1) / 2]) > 0; i = (i - 1) / 2) {
+			tmp = heap[i];
+			heap[i] = heap[(i - 1) / 2];
+			heap[(i - 1) / 2] = tmp;
+		}
+		return;
+	}
+	heap = varray_assign(vb, 0, 0);
+	if (compare_candidate(&cand, &heap[0]) >= 0)
+		return;
+	free(heap[0].name);
+	heap[0] = cand;
+	heap[0].name = check_strdup(name);
+	/* sift down */
+	for (i = 0; (child = i * 2 + 1) < limit; i = child) {
+		if (child + 1 < limit && compare_candidate(&heap[child + 1], &heap[child]) > 0)
+			child++;
+		if (compare_candidate(&heap[child], &heap[i]) <= 0)
+			break;
+		tmp = heap[i];
+		heap[i] = heap[child];
+		heap[child] = tmp;
+	}
+}
+/*
+ * fuzzysearch: print tag names which match to the pattern fuzzily.
+ *
+ *	i)	dbpath	dbpath directory
+ *	i)	root	root directory
+ *	i)	pattern	pattern (See libutil/fuzzy.c)
+ *	i)	db	GTAGS,GRTAGS,GSYMS
+ *
+ * Tag names are printed in order of the score. With --max-count=N,
+ * only the best N names are kept.
+ * If the key dictionary is available, blocks of the dictionary which don't
+ * have all characters of the pattern are skipped.
+ */
+void
+fuzzysearch(const char *dbpath, const char *root, const char *pattern, int db)
+{
+	FUZZY *fz = fuzzy_open(pattern);
+	VARRAY *vb = varray_open(sizeof(struct fuzzy_candidate), 100);
+	struct fuzzy_candidate *cand;
+	const char *key;
+	int limit = max_count > 0 ? max_count : 0;
+	int i, score, matched = 0;
+
+	key_gtop = NULL;
+	if ((key_dict = keydict_open(dbpath, db)) == NULL)
+		key_gtop = gtags_open(dbpath, root, db, GTAGS_READ, 0);
+	if (key_dict) {
+		unsigned long block;
+
+		for (block = 0; block < key_dict->nblocks; block++) {
+			if ((keydict_mask(key_dict, block) & fz->mask) != fz->mask)
+				continue;
+			for (key = keydict_block(key_dict, block); key; key = keydict_next(key_dict)) {
+				if ((score = fuzzy_match(fz, key)) >= 0) {
+					add_candidate(vb, key, score, limit);
+					matched++;
+				}
+			}
+		}
+		keydict_close(key_dict);
+	} else {
+		for (key = key_first(NULL, GTOP_KEY|GTOP_NOREGEX); key; key = key_next()) {
+			if ((score = fuzzy_match(fz, key)) >= 0) {
+				add_candidate(vb, key, score, limit);
+				matched++;
+			}
+		}
+		gtags_close(key_gtop);
+	}
+	if (limit > 0 && matched > limit)
+		truncated = 1;
+	cand = varray_assign(vb, 0, 0);
+	if (cand)
+		qsort(cand, vb->length, sizeof(struct fuzzy_candidate), compare_candidate);
+	for (i = 0; i < vb->length; i++) {
+		fputs(cand[i].name, stdout);
+		fputc('\n', stdout);
+		free(cand[i].name);
+	}
+	varray_close(vb);
+	fuzzy_close(fz);
+}
 /*
  * Output filter
  *
@@ -1125,26 +1496,292 @@ idutils(const char *pattern, const char *dbpath)
 		fprintf(stderr, " (using idutils index in '%s').\n", dbpath);
 	}
 }
+/*
+ * Grep engine for the -g command.
+ *
+ * Files are processed in batches. In each batch, worker threads read
+ * files and collect matched lines into the result buffer of each file,
+ * and then the main thread prints the results in the order of files.
+ * So, the output is the same as that of sequential processing.
+ *
+ * Each file is mapped into memory (or read at once), and a literal
+ * string is searched over the whole image to find candidate lines.
+ * For the --literal option, the literal string is the pattern itself.
+ * For regular expressions, it is a literal string which every matched
+ * line must have (see literal_from_regex()). Only candidate lines are
+ * checked with regexec(3).
+ */
+#ifndef O_BINARY
+#define O_BINARY 0
+#endif
+#define GREP_BATCH	256		/* number of files in a batch */
+#define GREP_MAXJOBS	16		/* max number of worker threads */
+
+struct grep_file {
+	const char *path;		/* path name */
+	const char *fid;		/* file id (NULL: not in GPATH) */
+	STRBUF *result;			/* <line number>\0<line image>\0... */
+	int count;			/* number of matched lines */
+	int error;			/* 1: cannot open file */
+	off_t size;			/* bytes read */
+};
+struct grep_worker {
+	regex_t preg;			/* compiled regex (not shared) */
+	STRBUF *ib;			/* line buffer */
+};
+static const LITERAL *grep_literal;	/* literal prefilter */
+static struct grep_file *grep_files;	/* files in a batch */
+static unsigned long grep_bytes;	/* bytes read (statistics) */
+static unsigned long grep_matched;	/* files matched (statistics) */
+static int grep_count;			/* number of files in a batch */
+static int grep_next;			/* next file to be processed */
+#ifdef USE_THREADS
+static pthread_mutex_t grep_lock = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
+/*
+ * grep_jobs: decide the number of worker threads.
+ */
+static int
+grep_jobs(void)
+{
+	int jobs = 1;
+#ifdef USE_THREADS
+	const char *p = getenv("GTAGSJOBS");
+
+	if (p != NULL)
+		jobs = atoi(p);
+#ifdef _SC_NPROCESSORS_ONLN
+	else
+		jobs = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+	if (jobs > GREP_MAXJOBS)
+		jobs = GREP_MAXJOBS;
+#endif
+	return jobs < 1 ? 1 : jobs;
+}
+/*
+ * grep_match: decide whether or not a line matches the pattern.
+ *
+ *	i)	w	worker
+ *	i)	line	start of line
+ *	i)	end	end of line
+ *	r)		1: matched, 0: not matched
+ */
+static int
+grep_match(struct grep_worker *w, const char *line, const char *end)
+{
+	if (grep_literal && !literal_search(grep_literal, line, end))
+		return 0;
+	/*
+	 * Like locatestring(), an empty line doesn't match even
+	 * an empty pattern.
+	 */
+	if (literal)
+		return line < end;
+	strbuf_reset(w->ib);
+	strbuf_nputs(w->ib, line, end - line);
+	return regexec(&w->preg, strbuf_value(w->ib), 0, 0, 0) == 0;
+}
+/*
+ * grep_file: search the pattern in a file.
+ *
+ *	i)	w	worker
+ *	io)	f	file
+ */
+static void
+grep_file(struct grep_worker *w, struct grep_file *f)
+{
+	struct stat st;
+	const char *image, *p, *end;
+	char *buf = NULL;
+	int fd, lineno = 0;
+
+	if ((fd = open(f->path, O_RDONLY|O_BINARY)) < 0 || fstat(fd, &st) < 0) {
+		f->error = 1;
+		if (fd >= 0)
+			close(fd);
+		return;
+	}
+	if (st.st_size == 0) {
+		close(fd);
+		return;
+	}
+#ifdef USE_MMAP
+	if ((buf = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0)) == MAP_FAILED)
+		buf = NULL;
+#endif
+	if (buf == NULL) {
+		size_t n = 0;
+		int r;
+
+		buf = check_malloc(st.st_size);
+		while (n < (size_t)st.st_size && (r = read(fd, buf + n, st.st_size - n)) > 0)
+			n += r;
+		st.st_size = n;
+		image = buf;
+	} else {
+		image = buf;
+		buf = NULL;
+	}
+	close(fd);
+	f->size = st.st_size;
+	p = image;
+	end = image + st.st_size;
+	while (p < end) {
+		const char *nl, *eol, *q;
+		int matched;
+
+		/*
+		 * Skip to the line which has the literal string.
+		 */
+		if (grep_literal && !Vflag) {
+			const char *hit = literal_search(grep_literal, p, end);
+
+			if (hit == NULL)
+				break;
+			for (q = hit; q > p && q[-1] != '\n'; q--)
+				;
+			for (; p < q; p++)
+				if (*p == '\n')
+					lineno++;
+		}
+		nl = memchr(p, '\n', end - p);
+		/*
+		 * Like strbuf_fgets(STRBUF_NOCRLF), a line ends with
+		 * '\0', '\r\n' or '\n'.
+		 */
+		if ((eol = memchr(p, '\0', (nl ? nl : end) - p)) == NULL) {
+			eol = nl ? nl : end;
+			if (eol > p && eol[-1] == '\r')
+				eol--;
+		}
+		lineno++;
+		matched = grep_match(w, p, eol);
+		if ((!Vflag && matched) || (Vflag && !matched)) {
+			f->count++;
+			if (format == FORMAT_PATH)
+				break;
+			strbuf_putn(f->result, lineno);
+			strbuf_putc(f->result, '\0');
+			strbuf_nputs(f->result, p, eol - p);
+			strbuf_putc(f->result, '\0');
+		}
+		p = nl ? nl + 1 : end;
+	}
+#ifdef USE_MMAP
+	if (buf == NULL)
+		munmap((void *)image, st.st_size);
+#endif
+	if (buf)
+		free(buf);
+}
+/*
+ * grep_worker: process files in the current batch.
+ *
+ *	i)	arg	worker
+ */
+static void *
+grep_worker(void *arg)
+{
+	struct grep_worker *w = arg;
+	int i;
+
+	for (;;) {
+#ifdef USE_THREADS
+		pthread_mutex_lock(&grep_lock);
+#endif
+		i = grep_next++;
+#ifdef USE_THREADS
+		pthread_mutex_unlock(&grep_lock);
+#endif
+		if (i >= grep_count)
+			break;
+		grep_file(w, &grep_files[i]);
+	}
+	return NULL;
+}
+/*
+ * grep_batch: process a batch of files and print the results.
+ *
+ *	i)	workers	workers
+ *	i)	jobs	number of workers
+ *	i)	cv	CONVERT structure
+ *	i)	pattern	encoded pattern
+ *	r)		number of matched objects
+ */
+static int
+grep_batch(struct grep_worker *workers, int jobs, CONVERT *cv, const char *pattern)
+{
+	int i, count = 0;
+
+	grep_next = 0;
+	if (jobs > grep_count)
+		jobs = grep_count;
+#ifdef USE_THREADS
+	if (jobs > 1) {
+		pthread_t tid[GREP_MAXJOBS];
+
+		for (i = 1; i < jobs; i++)
+			if (pthread_create(&tid[i], NULL, grep_worker, &workers[i]) != 0)
+				die("cannot create thread.");
+		grep_worker(&workers[0]);
+		for (i = 1; i < jobs; i++)
+			pthread_join(tid[i], NULL);
+	} else
+#endif
+		grep_worker(&workers[0]);
+	for (i = 0; i < grep_count; i++) {
+		struct grep_file *f = &grep_files[i];
+		const char *p, *end;
+
+		if (f->error)
+			die("cannot open file '%s'.", f->path);
+		grep_bytes += f->size;
+		if (f->count == 0)
+			continue;
+		grep_matched++;
+		count += f->count;
+		if (format == FORMAT_PATH) {
+			convert_put_path(cv, f->path);
+			continue;
+		}
+		p = strbuf_value(f->result);
+		end = p + strbuf_getlen(f->result);
+		while (p < end) {
+			int linenum = atoi(p);
+			const char *buffer = p + strlen(p) + 1;
+
+			convert_put_using(cv, pattern, f->path, linenum, buffer, f->fid);
+			p = buffer + strlen(buffer) + 1;
+		}
+	}
+	return count;
+}
 /*
  * grep: grep pattern
  *
  *	i)	pattern	POSIX regular expression
+ *	i)	argv	file list
+ *	i)	dbpath	GTAGS directory
  */
 void
 grep(const char *pattern, char *const *argv, const char *dbpath)
 {
-	FILE *fp;
 	CONVERT *cv;
 	GFIND *gp = NULL;
-	STRBUF *ib = strbuf_open(MAXBUFLEN);
+	IDSET *candidates = NULL;
+	POOL *pool = pool_open();
+	struct grep_worker workers[GREP_MAXJOBS];
 	const char *path;
 	char encoded_pattern[IDENTLEN];
-	const char *buffer;
-	int linenum, count;
+	char *prefilter = NULL;
+	int count, i, jobs;
 	int flags = 0;
 	int target = GPATH_SOURCE;
-	regex_t	preg;
 	int user_specified = 1;
+	unsigned long nfile = 0, nskip = 0;
+	STATISTICS_TIME *tim;
 
 	/*
 	 * convert spaces into %FF format.
@@ -1155,18 +1792,30 @@ grep(const char *pattern, char *const *argv, const char *dbpath)
 		target = GPATH_BOTH;
 	if (Oflag)
 		target = GPATH_OTHER;
+	jobs = grep_jobs();
 	if (literal) {
-		flags = MATCH_FIRST;
-		if (iflag)
-			flags |= IGNORE_CASE;
+		grep_literal = literal_open(pattern, iflag);
 	} else {
 		if (!Gflag)
 			flags |= REG_EXTENDED;
 		if (iflag)
 			flags |= REG_ICASE;
-		if (regcomp(&preg, pattern, flags) != 0)
-			die("invalid regular expression.");
+		/*
+		 * Since regexec(3) may lock the compiled pattern,
+		 * each worker has its own copy.
+		 */
+		for (i = 0; i < jobs; i++)
+			if (regcomp(&workers[i].preg, pattern, flags) != 0)
+				die("invalid regular expression.");
+		prefilter = literal_from_regex(pattern, Gflag, iflag);
+		if (prefilter)
+			grep_literal = literal_open(prefilter, iflag);
 	}
+	for (i = 0; i < jobs; i++)
+		workers[i].ib = strbuf_open(MAXBUFLEN);
+	grep_files = (struct grep_file *)check_calloc(sizeof(struct grep_file), GREP_BATCH);
+	for (i = 0; i < GREP_BATCH; i++)
+		grep_files[i].result = strbuf_open(0);
 	cv = convert_open(type, format, root, cwd, dbpath, stdout, NOTAGS);
 	count = 0;
 
@@ -1179,8 +1828,24 @@ grep(const char *pattern, char *const *argv, const char *dbpath)
 	else {
 		args_open_gfind(gp = gfind_open(dbpath, localprefix, target));
 		user_specified = 0;
+		/*
+		 * The full-text index tells the source files which have
+		 * all the trigrams of the literal string.
+		 */
+		if (target == GPATH_SOURCE && !Vflag && grep_literal && fulltext_usable(dbpath)) {
+			tim = statistics_time_start("Time of selecting candidates with %s", FULLTEXT_NAME);
+			if (fulltext_open(dbpath, 0) < 0)
+				die("cannot open '%s'.", FULLTEXT_NAME);
+			candidates = fulltext_candidates(literal ? pattern : prefilter, iflag, gpath_nextkey());
+			fulltext_close();
+			statistics_time_end(tim);
+		}
 	}
+	tim = statistics_time_start("Time of searching files");
+	grep_count = 0;
 	while ((path = args_read()) != NULL) {
+		struct grep_file *f;
+
 		if (user_specified) {
 			static char buf[MAXPATHLEN];
 
@@ -1200,40 +1865,58 @@ grep(const char *pattern, char *const *argv, const char *dbpath)
 		}
 		if (lflag && !locatestring(path, localprefix, MATCH_AT_FIRST))
 			continue;
-		if (!(fp = fopen(path, "r")))
-			die("cannot open file '%s'.", path);
-		linenum = 0;
-		while ((buffer = strbuf_fgets(ib, fp, STRBUF_NOCRLF)) != NULL) {
-			int result;
-
-			if (literal) {
-				result = locatestring(buffer, pattern, flags) ? 0 : -1;
-			} else {
-				result = regexec(&preg, buffer, 0, 0, 0);
-			}
-			linenum++;
-			if ((!Vflag && result == 0) || (Vflag && result != 0)) {
-				count++;
-				if (format == FORMAT_PATH) {
-					convert_put_path(cv, path);
-					break;
-				} else {
-					convert_put_using(cv, encoded_pattern, path, linenum, buffer,
-						(user_specified) ? NULL : gp->dbop->lastdat);
-				}
-			}
+		if (candidates && !idset_contains(candidates, atoi(gp->dbop->lastdat))) {
+			nskip++;
+			continue;
+		}
+		nfile++;
+		f = &grep_files[grep_count++];
+		f->path = pool_strdup(pool, path, 0);
+		f->fid = user_specified ? NULL : pool_strdup(pool, gp->dbop->lastdat, 0);
+		strbuf_reset(f->result);
+		f->count = f->error = 0;
+		f->size = 0;
+		if (grep_count == GREP_BATCH) {
+			count += grep_batch(workers, jobs, cv, encoded_pattern);
+			grep_count = 0;
+			pool_reset(pool);
 		}
-		fclose(fp);
 	}
+	if (grep_count > 0)
+		count += grep_batch(workers, jobs, cv, encoded_pattern);
 	args_close();
+	statistics_time_end(tim);
+	tim = statistics_time_start("Time of flushing output");
 	convert_close(cv);
-	strbuf_close(ib);
-	if (literal == 0)
-		regfree(&preg);
+	statistics_time_end(tim);
+	statistics_count("Files searched", nfile);
+	if (candidates)
+		statistics_count("Files skipped by full-text index", nskip);
+	statistics_count("Files matched", grep_matched);
+	statistics_count("Bytes read", grep_bytes);
+	statistics_count("Lines output", count);
+	for (i = 0; i < GREP_BATCH; i++)
+		strbuf_close(grep_files[i].result);
+	free(grep_files);
+	for (i = 0; i < jobs; i++) {
+		strbuf_close(workers[i].ib);
+		if (literal == 0)
+			regfree(&workers[i].preg);
+	}
+	if (grep_literal)
+		literal_close((LITERAL *)grep_literal);
+	if (prefilter)
+		free(prefilter);
+	pool_close(pool);
 	if (vflag) {
 		print_count(count);
-		fprintf(stderr, " (no index used).\n");
+		if (candidates)
+			fprintf(stderr, " (using full-text index in '%s').\n", dbpath);
+		else
+			fprintf(stderr, " (no index used).\n");
 	}
+	if (candidates)
+		idset_close(candidates);
 }
 /*
  * pathlist: print candidate path list.
@@ -1249,6 +1932,8 @@ pathlist(const char *pattern, const char *dbpath)
 	regex_t preg;
 	int count;
 	int target = GPATH_SOURCE;
+	unsigned long npath = 0;
+	STATISTICS_TIME *tim;
 
 	if (oflag)
 		target = GPATH_BOTH;
@@ -1280,8 +1965,10 @@ pathlist(const char *pattern, const char *dbpath)
 	cv = convert_open(type, format, root, cwd, dbpath, stdout, GPATH);
 	count = 0;
 
+	tim = statistics_time_start("Time of searching %s", dbname(GPATH));
 	gp = gfind_open(dbpath, localprefix, target);
 	while ((path = gfind_read(gp)) != NULL) {
+		npath++;
 		/*
 		 * skip localprefix because end-user doesn't see it.
 		 */
@@ -1300,7 +1987,12 @@ pathlist(const char *pattern, const char *dbpath)
 		count++;
 	}
 	gfind_close(gp);
+	statistics_time_end(tim);
+	tim = statistics_time_start("Time of flushing output");
 	convert_close(cv);
+	statistics_time_end(tim);
+	statistics_count("Paths examined", npath);
+	statistics_count("Lines output", count);
 	if (pattern)
 		regfree(&preg);
 	if (vflag) {
@@ -1508,6 +2200,7 @@ parsefile(char *const *argv, const char *cwd, const char *root, const char *dbpa
  *	i)	cwd		current directory
  *	i)	dbpath		database directory
  *	i)	db		GTAGS,GRTAGS,GSYMS
+ *	i)	limit		max count of output lines (-1: unlimited)
  *	r)			count of output lines
  */
 /* get next number and seek to the next character */
@@ -1518,7 +2211,7 @@ parsefile(char *const *argv, const char *cwd, const char *root, const char *dbpa
                         n = n * 10 + (*p - '0');                                \
         } while (0)
 int
-search(const char *pattern, const char *root, const char *cwd, const char *dbpath, int db)
+search(const char *pattern, const char *root, const char *cwd, const char *dbpath, int db, int limit)
 {
 	CONVERT *cv;
 	int count = 0;
@@ -1528,16 +2221,38 @@ search(const char *pattern, const char *root, const char *cwd, const char *dbpat
 	STRBUF *sb = NULL, *ib = NULL;
 	char curpath[MAXPATHLEN], curtag[IDENTLEN];
 	FILE *fp = NULL;
+	LINEINDEX *li = NULL;
 	const char *src = "";
 	int lineno, last_lineno;
+	unsigned long nrecord = 0, nsource = 0, nline = 0;
+	STATISTICS_TIME *tim;
 
 	lineno = last_lineno = 0;
 	curpath[0] = curtag[0] = '\0';
 	/*
 	 * open tag file.
 	 */
-	gtop = gtags_open(dbpath, root, db, GTAGS_READ, 0);
+	tim = statistics_time_start("Time of opening %s", dbname(db));
+	if (keep_gtop) {
+		/*
+		 * The tag file is kept open for the next pattern.
+		 * Only one is kept, since GPATH can be opened only for one tree.
+		 */
+		if (kept_gtop && strcmp(kept_dbpath, dbpath)) {
+			gtags_close(kept_gtop);
+			kept_gtop = NULL;
+		}
+		if (kept_gtop == NULL) {
+			kept_gtop = gtags_open(dbpath, root, db, GTAGS_READ, 0);
+			strlimcpy(kept_dbpath, dbpath, sizeof(kept_dbpath));
+		}
+		gtop = kept_gtop;
+		gtop->limit = 0;
+	} else
+		gtop = gtags_open(dbpath, root, db, GTAGS_READ, 0);
 	cv = convert_open(type, format, root, cwd, dbpath, stdout, db);
+	cv->label = pattern_label;
+	statistics_time_end(tim);
 	/*
 	 * search through tag file.
 	 */
@@ -1548,10 +2263,13 @@ search(const char *pattern, const char *root, const char *cwd, const char *dbpat
 			sb = strbuf_open(0);
 			strbuf_putc(sb, '^');
 			strbuf_puts(sb, pattern);
-			strbuf_putc(sb, '$');
+			if (!pattern_prefix)
+				strbuf_putc(sb, '$');
 			pattern = strbuf_value(sb);
 		}
 		flags |= GTOP_IGNORECASE;
+	} else if (pattern_prefix) {
+		flags |= GTOP_PREFIX | GTOP_NOREGEX;
 	}
 	if (Gflag)
 		flags |= GTOP_BASICREGEX;
@@ -1559,9 +2277,23 @@ search(const char *pattern, const char *root, const char *cwd, const char *dbpat
 		flags |= GTOP_PATH;
 	if (gtop->format & GTAGS_COMPACT)
 		ib = strbuf_open(0);
+	/*
+	 * Since each record makes at least one output line, we need not
+	 * read more than limit + 1 records. The extra one is read to know
+	 * whether the output is truncated. The -l option filters records
+	 * after reading, so the limit cannot be applied to the reading.
+	 */
+	if (limit >= 0 && !lflag)
+		gtop->limit = limit + 1;
+	tim = statistics_time_start("Time of searching %s", dbname(db));
 	for (gtp = gtags_first(gtop, pattern, flags); gtp; gtp = gtags_next(gtop)) {
+		nrecord++;
 		if (lflag && !locatestring(gtp->path, localprefix, MATCH_AT_FIRST))
 			continue;
+		if (limit >= 0 && count >= limit) {
+			truncated = 1;
+			break;
+		}
 		if (format == FORMAT_PATH) {
 			convert_put_path(cv, gtp->path);
 			count++;
@@ -1590,15 +2322,25 @@ search(const char *pattern, const char *root, const char *cwd, const char *dbpat
 				if (strcmp(gtp->path, curpath) != 0) {
 					if (curpath[0] != '\0' && fp != NULL)
 						fclose(fp);
+					if (li != NULL)
+						lineindex_close(li);
 					strlimcpy(curtag, tagname, sizeof(curtag));
 					strlimcpy(curpath, gtp->path, sizeof(curpath));
 					/*
 					 * Use absolute path name to support GTAGSROOT
 					 * environment variable.
+					 * If the line index is available, each line is
+					 * read directly. Otherwise, the source file is
+					 * read sequentially.
 					 */
-					fp = fopen(makepath(root, curpath, NULL), "r");
-					if (fp == NULL)
-						warning("source file '%s' is not available.", curpath);
+					fp = NULL;
+					nsource++;
+					li = lineindex_open(makepath(root, curpath, NULL), fid);
+					if (li == NULL) {
+						fp = fopen(makepath(root, curpath, NULL), "r");
+						if (fp == NULL)
+							warning("source file '%s' is not available.", curpath);
+					}
 					last_lineno = lineno = 0;
 				} else if (strcmp(gtp->tag, curtag) != 0) {
 					strlimcpy(curtag, gtp->tag, sizeof(curtag));
@@ -1640,7 +2382,11 @@ search(const char *pattern, const char *root, const char *cwd, const char *dbpat
 						GET_NEXT_NUMBER(p);
 						n += last;
 					}
-					if (last_lineno != n && fp) {
+					if (last_lineno != n && li) {
+						if ((src = lineindex_read(li, n)) == NULL)
+							src = "";
+						nline++;
+					} else if (last_lineno != n && fp) {
 						while (lineno < n) {
 							if (!(src = strbuf_fgets(ib, fp, STRBUF_NOCRLF))) {
 								src = "";
@@ -1649,8 +2395,13 @@ search(const char *pattern, const char *root, const char *cwd, const char *dbpat
 								break;
 							}
 							lineno++;
+							nline++;
 						}
 					}
+					if (limit >= 0 && count >= limit) {
+						truncated = 1;
+						break;
+					}
 					if (gtop->format & GTAGS_COMPNAME)
 						tagname = (char *)uncompress(tagname, gtp->tag);
 					convert_put_using(cv, tagname, gtp->path, n, src, fid);
@@ -1670,7 +2421,11 @@ search(const char *pattern, const char *root, const char *cwd, const char *dbpat
 						p++;
 					if (last_lineno == n)
 						continue;
-					if (last_lineno != n && fp) {
+					if (last_lineno != n && li) {
+						if ((src = lineindex_read(li, n)) == NULL)
+							src = "";
+						nline++;
+					} else if (last_lineno != n && fp) {
 						while (lineno < n) {
 							if (!(src = strbuf_fgets(ib, fp, STRBUF_NOCRLF))) {
 								src = "";
@@ -1679,8 +2434,13 @@ search(const char *pattern, const char *root, const char *cwd, const char *dbpat
 								break;
 							}
 							lineno++;
+							nline++;
 						}
 					}
+					if (limit >= 0 && count >= limit) {
+						truncated = 1;
+						break;
+					}
 					if (gtop->format & GTAGS_COMPNAME)
 						tagname = (char *)uncompress(tagname, gtp->tag);
 					convert_put_using(cv, tagname, gtp->path, n, src, fid);
@@ -1723,14 +2483,24 @@ search(const char *pattern, const char *root, const char *cwd, const char *dbpat
 			count++;
 		}
 	}
+	statistics_time_end(tim);
+	tim = statistics_time_start("Time of flushing output");
 	convert_close(cv);
+	statistics_time_end(tim);
+	statistics_count("Tag records matched", nrecord);
+	statistics_count("Source files opened", nsource);
+	statistics_count("Source lines read", nline);
+	statistics_count("Lines output", count);
 	if (sb)
 		strbuf_close(sb);
 	if (ib)
 		strbuf_close(ib);
 	if (fp)
 		fclose(fp);
-	gtags_close(gtop);
+	if (li)
+		lineindex_close(li);
+	if (!keep_gtop)
+		gtags_close(gtop);
 	return count;
 }
 /*
@@ -1746,45 +2516,38 @@ void
 tagsearch(const char *pattern, const char *cwd, const char *root, const char *dbpath, int db)
 {
 	int count, total = 0;
-	char libdbpath[MAXPATHLEN];
 
 	/*
 	 * search in current source tree.
 	 */
-	count = search(pattern, root, cwd, dbpath, db);
+	count = search(pattern, root, cwd, dbpath, db, max_count > 0 ? max_count : -1);
 	total += count;
 	/*
 	 * search in library path.
 	 */
 	if (db == GTAGS && getenv("GTAGSLIBPATH") && (count == 0 || Tflag) && !lflag) {
-		STRBUF *sb = strbuf_open(0);
-		char *libdir, *nextp = NULL;
+		LIBTREE *trees;
+		int i, n = libpath_open(dbpath, &trees);
 
-		strbuf_puts(sb, getenv("GTAGSLIBPATH"));
 		/*
-		 * search for each tree in the library path.
+		 * Trees which don't have the tag are skipped.
+		 * A regular expression cannot be probed.
 		 */
-		for (libdir = strbuf_value(sb); libdir; libdir = nextp) {
-			if ((nextp = locatestring(libdir, PATHSEP, MATCH_FIRST)) != NULL)
-				*nextp++ = 0;
-			if (!gtagsexist(libdir, libdbpath, sizeof(libdbpath), 0))
-				continue;
-			if (!strcmp(dbpath, libdbpath))
-				continue;
-			if (!test("f", makepath(libdbpath, dbname(db), NULL)))
+		libpath_probe((iflag || isregex(pattern)) ? NULL : pattern, pattern_prefix);
+		for (i = 0; i < n && !truncated; i++) {
+			if (trees[i].status == LIBPATH_MISS)
 				continue;
 			/*
 			 * search again
 			 */
-			count = search(pattern, libdir, cwd, libdbpath, db);
+			count = search(pattern, trees[i].root, cwd, trees[i].dbpath, db, max_count > 0 ? max_count - total : -1);
 			total += count;
 			if (count > 0 && !Tflag) {
 				/* for verbose message */
-				dbpath = libdbpath;
+				dbpath = trees[i].dbpath;
 				break;
 			}
 		}
-		strbuf_close(sb);
 	}
 	if (vflag) {
 		print_count(total);
@@ -1793,6 +2556,89 @@ tagsearch(const char *pattern, const char *cwd, const char *root, const char *db
 		fputs(".\n", stderr);
 	}
 }
+/*
+ * compare_pattern: compare patterns for qsort(3).
+ */
+static int
+compare_pattern(const void *v1, const void *v2)
+{
+	return strcmp(*(char *const *)v1, *(char *const *)v2);
+}
+/*
+ * patternsearch: execute tag search for each pattern in a file
+ *
+ *	i)	file		pattern file ("-": standard input)
+ *	i)	cwd		current directory
+ *	i)	root		root of source tree
+ *	i)	dbpath		database directory
+ *	i)	db		GTAGS,GRTAGS,GSYMS
+ *
+ * Each line of the file is a tag name, or a prefix of tag names
+ * followed by '*'. Empty lines and lines which start with '#' are ignored.
+ * The tag file is kept open between the patterns. Patterns are sorted
+ * so that the B-tree is looked up in the key order, which reads the pages
+ * cached by the previous lookup.
+ * Each output record is preceded by the pattern and a tab.
+ * --max-count is applied to each pattern.
+ */
+void
+patternsearch(const char *file, const char *cwd, const char *root, const char *dbpath, int db)
+{
+	STRBUF *ib = strbuf_open(0);
+	STRBUF *name = strbuf_open(0);
+	VARRAY *vb = varray_open(sizeof(char *), 100);
+	FILE *ip;
+	char *line, **patterns;
+	int i, len, was_truncated = truncated;
+
+	if (!strcmp(file, "-"))
+		ip = stdin;
+	else if ((ip = fopen(file, "r")) == NULL)
+		die("cannot open '%s'.", file);
+	while ((line = strbuf_fgets(ib, ip, STRBUF_NOCRLF)) != NULL) {
+		if (*line == '\0' || *line == '#')
+			continue;
+		*(char **)varray_append(vb) = check_strdup(line);
+	}
+	if (ip != stdin)
+		fclose(ip);
+	patterns = varray_assign(vb, 0, 0);
+	if (patterns)
+		qsort(patterns, vb->length, sizeof(char *), compare_pattern);
+	keep_gtop = 1;
+	for (i = 0; i < vb->length; i++) {
+		if (i > 0 && !strcmp(patterns[i], patterns[i - 1]))
+			continue;
+		len = strlen(patterns[i]);
+		pattern_prefix = (len > 1 && patterns[i][len - 1] == '*');
+		strbuf_reset(name);
+		strbuf_nputs(name, patterns[i], pattern_prefix ? len - 1 : len);
+		if (isregex(strbuf_value(name)))
+			die_with_code(2, "only name char is allowed in the pattern file. '%s'", patterns[i]);
+		pattern_label = patterns[i];
+		if (vflag)
+			fprintf(stderr, "%s: ", pattern_label);
+		/*
+		 * The truncation of a pattern must not stop the search of
+		 * the library trees for the following patterns.
+		 */
+		truncated = 0;
+		tagsearch(strbuf_value(name), cwd, root, dbpath, db);
+		was_truncated |= truncated;
+	}
+	truncated = was_truncated;
+	if (kept_gtop)
+		gtags_close(kept_gtop);
+	kept_gtop = NULL;
+	keep_gtop = 0;
+	pattern_label = NULL;
+	pattern_prefix = 0;
+	for (i = 0; i < vb->length; i++)
+		free(patterns[i]);
+	varray_close(vb);
+	strbuf_close(name);
+	strbuf_close(ib);
+}
 /*
  * encode: string copy with converting blank chars into %ff format.
  *
@@ -62,10 +62,12 @@ int incremental(const char *, const char *);
 void updatetags(const char *, const char *, IDSET *, STRBUF *);
 void createtags(const char *, const char *);
 int printconf(const char *);
+void makekeydict(const char *);
 
 int cflag;					/* compact format */
 int iflag;					/* incremental update */
 int Iflag;					/* make  idutils index */
+int fulltext;					/* make full-text index */
 int Oflag;					/* use objdir */
 int qflag;					/* quiet mode */
 int wflag;					/* warning message */
@@ -92,6 +94,7 @@ int convert_type = PATH_RELATIVE;
 
 int extractmethod;
 int total;
+STRHASH *touched_keys;				/* keys put or deleted by updatetags() */
 
 static void
 usage(void)
@@ -141,6 +144,7 @@ static struct option const long_options[] = {
 	/* flag value */
 	{"accept-dotfiles", no_argument, NULL, OPT_ACCEPT_DOTFILES},
 	{"debug", no_argument, &debug, 1},
+	{"fulltext", no_argument, &fulltext, 1},
 	{"statistics", no_argument, &statistics, STATISTICS_STYLE_TABLE},
 	{"version", no_argument, &show_version, 1},
 	{"help", no_argument, &show_help, 1},
@@ -463,7 +467,16 @@ main(int argc, char **argv)
 		 */
 		if (!test("f", makepath(dbpath, dbname(GPATH), NULL)))
 			die("Old version tag file found. Please remake it.");
-		(void)incremental(dbpath, cwd);
+		/*
+		 * If the key dictionary is up to date, only the keys of
+		 * the updated records are applied to it.
+		 */
+		if (keydict_current(dbpath))
+			touched_keys = strhash_open(1024);
+		if (incremental(dbpath, cwd) || !test("f", makepath(dbpath, KEYDICT_NAME, NULL)))
+			makekeydict(dbpath);
+		if (touched_keys)
+			strhash_close(touched_keys);
 		print_statistics(statistics);
 		exit(0);
 	}
@@ -471,6 +484,8 @@ main(int argc, char **argv)
 	 * create GTAGS and GRTAGS
 	 */
 	createtags(dbpath, cwd);
+	makekeydict(dbpath);
+	querycache_purge(dbpath);
 	/*
 	 * create idutils index.
 	 */
@@ -659,6 +674,7 @@ incremental(const char *dbpath, const char *root)
 	{
 		int db;
 		updated = 1;
+		gpath_newgeneration();
 		tim = statistics_time_start("Time of updating %s and %s.", dbname(GTAGS), dbname(GRTAGS));
 		if (!idset_empty(deleteset) || strbuf_getlen(addlist) > 0)
 			updatetags(dbpath, root, deleteset, addlist);
@@ -691,6 +707,8 @@ incremental(const char *dbpath, const char *root)
 		 */
 		for (db = GTAGS; db < GTAGLIM; db++)
 			utime(makepath(dbpath, dbname(db), NULL), NULL);
+		if (test("f", makepath(dbpath, FULLTEXT_NAME, NULL)))
+			utime(makepath(dbpath, FULLTEXT_NAME, NULL), NULL);
 		statistics_time_end(tim);
 	}
 exit:
@@ -726,6 +744,7 @@ put_syms(int type, const char *tag, int lno, const char *path, const char *line_
 	switch (type) {
 	case PARSER_DEF:
 		gtop = data->gtop[GTAGS];
+		defindex_add(gtags_tagkey(gtop, tag), lno);
 		break;
 	case PARSER_REF_SYM:
 		gtop = data->gtop[GRTAGS];
@@ -749,8 +768,9 @@ void
 updatetags(const char *dbpath, const char *root, IDSET *deleteset, STRBUF *addlist)
 {
 	struct put_func_data data;
-	int seqno, flags;
-	const char *path, *start, *end;
+	char fid[MAXFIDLEN];
+	int seqno, flags, do_fulltext;
+	const char *path, *start, *end, *p;
 
 	if (vflag)
 		fprintf(stderr, "[%s] Updating '%s' and '%s'.\n", now(), dbname(GTAGS), dbname(GRTAGS));
@@ -767,12 +787,20 @@ updatetags(const char *dbpath, const char *root, IDSET *deleteset, STRBUF *addli
 		 */
 		data.gtop[GRTAGS] = NULL;
 	}
+	data.gtop[GTAGS]->touched = touched_keys;
+	if (data.gtop[GRTAGS] != NULL)
+		data.gtop[GRTAGS]->touched = touched_keys;
+	/*
+	 * The full-text index is maintained only if it exists.
+	 */
+	do_fulltext = test("f", makepath(dbpath, FULLTEXT_NAME, NULL));
+	if (do_fulltext && fulltext_open(dbpath, 2) < 0)
+		die("cannot open '%s'.", FULLTEXT_NAME);
 	/*
 	 * Delete tags from GTAGS.
 	 */
 	if (!idset_empty(deleteset)) {
 		if (vflag) {
-			char fid[MAXFIDLEN];
 			int total = idset_count(deleteset);
 			unsigned int id;
 
@@ -788,6 +816,8 @@ updatetags(const char *dbpath, const char *root, IDSET *deleteset, STRBUF *addli
 		gtags_delete(data.gtop[GTAGS], deleteset);
 		if (data.gtop[GRTAGS] != NULL)
 			gtags_delete(data.gtop[GRTAGS], deleteset);
+		if (do_fulltext)
+			fulltext_delete(deleteset);
 	}
 	/*
 	 * Set flags.
@@ -811,20 +841,27 @@ updatetags(const char *dbpath, const char *root, IDSET *deleteset, STRBUF *addli
 	seqno = 0;
 	for (path = start; path < end; path += strlen(path) + 1) {
 		gpath_put(path, GPATH_SOURCE);
-		data.fid = gpath_path2fid(path, NULL);
-		if (data.fid == NULL)
+		if ((p = gpath_path2fid(path, NULL)) == NULL)
 			die("GPATH is corrupted.('%s' not found)", path);
+		strlimcpy(fid, p, sizeof(fid));
+		data.fid = fid;
 		if (vflag)
 			fprintf(stderr, " [%d/%d] extracting tags of %s\n", ++seqno, total, path + 2);
 		parse_file(path, flags, put_syms, &data);
 		gtags_flush(data.gtop[GTAGS], data.fid);
 		if (data.gtop[GRTAGS] != NULL)
 			gtags_flush(data.gtop[GRTAGS], data.fid);
+		if (do_fulltext)
+			fulltext_put(path, data.fid);
+		lineindex_put(path, data.fid);
+		defindex_put(data.fid);
 	}
 	parser_exit();
 	gtags_close(data.gtop[GTAGS]);
 	if (data.gtop[GRTAGS] != NULL)
 		gtags_close(data.gtop[GRTAGS]);
+	if (do_fulltext)
+		fulltext_close();
 }
 /*
  * createtags: create tags file
@@ -838,8 +875,9 @@ createtags(const char *dbpath, const char *root)
 	STATISTICS_TIME *tim;
 	STRBUF *sb = strbuf_open(0);
 	struct put_func_data data;
+	char fid[MAXFIDLEN];
 	int openflags, flags, seqno;
-	const char *path;
+	const char *path, *p;
 
 	tim = statistics_time_start("Time of creating %s and %s.", dbname(GTAGS), dbname(GRTAGS));
 	if (vflag)
@@ -851,6 +889,16 @@ createtags(const char *dbpath, const char *root)
 		data.gtop[GTAGS]->flags |= GTAGS_EXTRACTMETHOD;
 	data.gtop[GRTAGS] = gtags_open(dbpath, root, GRTAGS, GTAGS_CREATE, openflags);
 	data.gtop[GRTAGS]->flags = data.gtop[GTAGS]->flags;
+	/*
+	 * The full-text index of old tag files is removed, since it
+	 * would not be maintained any longer.
+	 */
+	if (fulltext) {
+		if (fulltext_open(dbpath, 1) < 0)
+			die("cannot make '%s'.", FULLTEXT_NAME);
+	} else if (test("f", makepath(dbpath, FULLTEXT_NAME, NULL))) {
+		unlink(makepath(dbpath, FULLTEXT_NAME, NULL));
+	}
 	flags = 0;
 	if (vflag)
 		flags |= PARSER_VERBOSE;
@@ -874,15 +922,27 @@ createtags(const char *dbpath, const char *root)
 			continue;
 		}
 		gpath_put(path, GPATH_SOURCE);
-		data.fid = gpath_path2fid(path, NULL);
-		if (data.fid == NULL)
+		if ((p = gpath_path2fid(path, NULL)) == NULL)
 			die("GPATH is corrupted.('%s' not found)", path);
+		/*
+		 * Writing GPATH may overwrite the value returned by gpath_path2fid().
+		 */
+		strlimcpy(fid, p, sizeof(fid));
+		data.fid = fid;
 		seqno++;
 		if (vflag)
 			fprintf(stderr, " [%d] extracting tags of %s\n", seqno, path + 2);
 		parse_file(path, flags, put_syms, &data);
 		gtags_flush(data.gtop[GTAGS], data.fid);
 		gtags_flush(data.gtop[GRTAGS], data.fid);
+		if (fulltext)
+			fulltext_put(path, data.fid);
+		/*
+		 * Line index is used to pick up line images for the compact format.
+		 * Definition index is used to decide the type of a tag by context.
+		 */
+		lineindex_put(path, data.fid);
+		defindex_put(data.fid);
 	}
 	total = seqno;
 	parser_exit();
@@ -891,6 +951,8 @@ createtags(const char *dbpath, const char *root)
 	tim = statistics_time_start("Time of flushing B-tree cache");
 	gtags_close(data.gtop[GTAGS]);
 	gtags_close(data.gtop[GRTAGS]);
+	if (fulltext)
+		fulltext_close();
 	statistics_time_end(tim);
 	strbuf_reset(sb);
 	if (getconfs("GTAGS_extra", sb)) {
@@ -908,6 +970,23 @@ createtags(const char *dbpath, const char *root)
 	}
 	strbuf_close(sb);
 }
+/*
+ * makekeydict: make key dictionary for completion.
+ *
+ *	i)	dbpath	dbpath directory
+ */
+void
+makekeydict(const char *dbpath)
+{
+	STATISTICS_TIME *tim;
+
+	tim = statistics_time_start("Time of creating %s", KEYDICT_NAME);
+	if (touched_keys)
+		keydict_update(dbpath, touched_keys);
+	else
+		keydict_make(dbpath);
+	statistics_time_end(tim);
+}
 /*
  * printconf: print configuration data.
  *
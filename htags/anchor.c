@@ -34,10 +34,11 @@
 #endif
 #include "global.h"
 #include "anchor.h"
+#include "cache.h"
 #include "htags.h"
 #include "path2url.h"
 
-static XARGS *anchor_input[GTAGLIM];
+static DBOP *anchor_db;			/* anchor records by file id */
 static struct anchor *table;
 static VARRAY *vb;
 
@@ -46,11 +47,37 @@ static struct anchor *curp;
 static struct anchor *end;
 static struct anchor *CURRENT;
 
-/* compare routine for qsort(3) */
+/*
+ * rank of the type: definition (D, M, T, ?), reference (R), symbol (Y)
+ */
+static int
+rank(int type)
+{
+	return (type == 'R') ? 1 : (type == 'Y') ? 2 : 0;
+}
+/*
+ * compare routine for qsort(3)
+ *
+ * Anchors in a line are ordered by the kind of the type (definition,
+ * reference and symbol) and the name, so that the order doesn't depend
+ * on the order of the records in the tag files. A definition should come
+ * before a reference of the same name, since anchor_get() returns the
+ * first one.
+ */
 static int
 cmp(const void *s1, const void *s2)
 {
-	return ((struct anchor *)s1)->lineno - ((struct anchor *)s2)->lineno;
+	struct anchor *a1 = (struct anchor *)s1;
+	struct anchor *a2 = (struct anchor *)s2;
+	int diff;
+
+	if ((diff = a1->lineno - a2->lineno) != 0)
+		return diff;
+	if ((diff = rank(a1->type) - rank(a2->type)) != 0)
+		return diff;
+	if ((diff = strcmp(gettag(a1), gettag(a2))) != 0)
+		return diff;
+	return a1->type - a2->type;
 }
 /*
  * Pointers (as lineno).
@@ -60,43 +87,161 @@ static int LAST;
 static struct anchor *CURRENTDEF;
 
 /*
- * anchor_prepare: setup input stream.
+ * deftype: decide the type of a definition from its line image.
+ *
+ *	i)	image	line image
+ *	i)	tag	tag name
+ *	r)		'D': function, 'M': macro, 'T': type
  *
- *	i)	anchor_stream	file pointer of path list
+ * Function header is applied only to the anchor whoes type is 'D'.
+ */
+static int
+deftype(const char *image, const char *tag)
+{
+	const char *p = image;
+
+	for (; *p && isspace((unsigned char)*p); p++)
+		;
+	if (!*p)
+		die("The line image of '%s' is illegal.\n%s", tag, image);
+	if (*p == '#')
+		return 'M';
+	if (locatestring(p, "typedef", MATCH_AT_FIRST))
+		return 'T';
+	if ((p = locatestring(p, tag, MATCH_FIRST)) != NULL) {
+		/* skip a tag and the following blanks */
+		p += strlen(tag);
+		for (; *p && isspace((unsigned char)*p); p++)
+			;
+		if (*p == '(')
+			return 'D';
+	}
+	return 'T';
+}
+/*
+ * anchor_put: put an anchor record into the anchor table.
+ *
+ *	i)	sb	work buffer
+ *	i)	fid	file id
+ *	i)	type	'D', 'M', 'T', 'R', 'Y' or '?' (not yet decided)
+ *	i)	lineno	line number
+ *	i)	tag	tag name
+ *
+ * record = <type> <line number> <tag name>
+ */
+static void
+anchor_put(STRBUF *sb, const char *fid, int type, int lineno, const char *tag)
+{
+	strbuf_reset(sb);
+	strbuf_putc(sb, type);
+	strbuf_putc(sb, ' ');
+	strbuf_putn(sb, lineno);
+	strbuf_putc(sb, ' ');
+	strbuf_puts(sb, tag);
+	dbop_put(anchor_db, fid, strbuf_value(sb));
+}
+/*
+ * Anchor records which share the file id, the type and the tag name.
+ */
+struct anchor_record {
+	STRBUF *sb;
+	const char *fid;
+	int type;
+	const char *tag;
+};
+/*
+ * put_compact: put an anchor record of compact format (callback of gtags_unfold()).
+ */
+static void
+put_compact(int lineno, void *arg)
+{
+	struct anchor_record *rec = arg;
+
+	anchor_put(rec->sb, rec->fid, rec->type, lineno, rec->tag);
+}
+/*
+ * anchor_prepare: make the anchor table of the files.
+ *
+ *	i)	fids	file ids of the files to be converted
+ *
+ * Each tag file is read once through the library, and the records
+ * concerning the files are stored into a temporary database keyed by
+ * the file id. So, anchor_load() can get the anchors of a file directly,
+ * without parsing source files again.
  */
 void
-anchor_prepare(FILE *anchor_stream)
+anchor_prepare(IDSET *fids)
 {
-	/*
-	 * Option table:
-	 * We use blank string as null option instead of null string("")
-	 * not to change the command length. This length influences
-	 * the number of arguments in the xargs processing.
-	 */
-	static const char *const options[] = {NULL, " ", "r", "s"};
-	char comline[MAXFILLEN];
+	STRBUF *sb = strbuf_open(0);
+	char s_fid[MAXFIDLEN], tag[IDENTLEN];
 	int db;
 
+	anchor_db = dbop_open(NULL, 1, 0600, DBOP_DUP);
+	if (anchor_db == NULL)
+		die("cannot make anchor table.");
 	for (db = GTAGS; db < GTAGLIM; db++) {
-		anchor_input[db] = NULL;
-		/*
-		 * Htags(1) should not use gtags-parser(1) directly;
-		 * it should use global(1) with the -f option instead.
-		 * Because gtags-parser is part of the implementation of
-		 * gtags(1) and global(1), and htags is only an application
-		 * program which uses global(1). If htags depends on
-		 * gtags-parser, it will become difficult to change the
-		 * implementation of gtags and global.
-		 *
-		 * Though the output of global -f is not necessarily sorted
-		 * by the path, it is guaranteed that the records concerning
-		 * the same file are consecutive.
-		 */
-		if (gtags_exist[db] == 1) {
-			snprintf(comline, sizeof(comline), "%s -f%s --encode-path=\" \t\" --result=ctags-xid --nofilter=path", quote_shell(global_path), options[db]);
-			anchor_input[db] = xargs_open_with_file(comline, 0, anchor_stream);
+		GTOP *gtop;
+		GTP *gtp;
+
+		if (gtags_exist[db] != 1)
+			continue;
+		gtop = gtags_open(dbpath, cwdpath, db, GTAGS_READ, 0);
+		for (gtp = gtags_first(gtop, NULL, GTOP_NOSORT); gtp; gtp = gtags_next(gtop)) {
+			const char *p = gtp->tagline, *name;
+			int type, n;
+
+			if (!idset_contains(fids, gtp->fid))
+				continue;
+			/*
+			 * tagline = <file id> <tag name> <line no> <line image>	(standard)
+			 * tagline = <file id> <tag name> <line no>,...		(compact)
+			 */
+			for (n = 0; *p && *p != ' '; p++)
+				if (n < (int)sizeof(s_fid) - 1)
+					s_fid[n++] = *p;
+			s_fid[n] = '\0';
+			for (p++, n = 0; *p && *p != ' '; p++)
+				if (n < (int)sizeof(tag) - 1)
+					tag[n++] = *p;
+			tag[n] = '\0';
+			if (*p++ != ' ')
+				die("illegal tag record.\n%s", gtp->tagline);
+			name = (gtop->format & GTAGS_COMPNAME) ? uncompress(tag, gtp->tag) : tag;
+			if (db == GTAGS)
+				type = '?';
+			else if (db == GRTAGS)
+				type = 'R';
+			else
+				type = 'Y';
+			if (!(gtop->format & GTAGS_COMPACT)) {
+				if (db == GTAGS) {
+					const char *image = locatestring(p, " ", MATCH_FIRST);
+
+					if (image == NULL)
+						die("illegal tag record.\n%s", gtp->tagline);
+					image++;
+					if (gtop->format & GTAGS_COMPRESS) {
+						if (name != tag)
+							strlimcpy(tag, name, sizeof(tag));
+						name = tag;
+						image = uncompress(image, gtp->tag);
+					}
+					type = deftype(image, name);
+				}
+				anchor_put(sb, s_fid, type, gtp->lineno, name);
+			} else {
+				struct anchor_record rec;
+
+				rec.sb = sb;
+				rec.fid = s_fid;
+				rec.type = type;
+				rec.tag = name;
+				gtags_unfold(gtop, p, put_compact, &rec);
+			}
 		}
+		gtags_close(gtop);
 	}
+	strbuf_close(sb);
 }
 /*
  * anchor_load: load anchor table
@@ -106,15 +251,13 @@ anchor_prepare(FILE *anchor_stream)
 void
 anchor_load(const char *path)
 {
-	int db, current_fid;
+	const char *fid, *record;
+	int undecided = 0;
 
 	/* Get fid of the path */
-	{
-		const char *p = path2fid(path);
-		if (p == NULL)
-			die("anchor_load: internal error. file '%s' not found in GPATH.", path);
-		current_fid = atoi(p);
-	}
+	fid = path2fid(path);
+	if (fid == NULL)
+		die("anchor_load: internal error. file '%s' not found in GPATH.", path);
 	FIRST = LAST = 0;
 	end = CURRENT = NULL;
 
@@ -123,75 +266,20 @@ anchor_load(const char *path)
 	else
 		varray_reset(vb);
 
-	for (db = GTAGS; db < GTAGLIM; db++) {
-		XARGS *xp;
-		char *ctags_xid;
-
-		if ((xp = anchor_input[db]) == NULL)
-			continue;
-		/*
-		 * Read from input stream until it reaches end of file
-		 * or the line of another file appears.
-		 */
-		while ((ctags_xid = xargs_read(xp)) != NULL) {
-			SPLIT ptable;
-			struct anchor *a;
-			int type, fid;
-			const char *ctags_x = parse_xid(ctags_xid, NULL, &fid);
-
-			/*
-			 * It is the following file.
-			 */
-			if (current_fid != fid) {
-				xargs_unread(xp);
-				break;
-			}
-			if (split(ctags_x, 4, &ptable) < 4) {
-				recover(&ptable);
-				die("too small number of parts in anchor_load().\n'%s'", ctags_x);
-			}
-			if (db == GTAGS) {
-				char *p = ptable.part[PART_LINE].start;
+	for (record = dbop_first(anchor_db, fid, NULL, 0); record; record = dbop_next(anchor_db)) {
+		struct anchor *a;
+		char *p = (char *)record + 2;	/* skip '<type> ' */
 
-				for (; *p && isspace((unsigned char)*p); p++)
-					;
-				if (!*p) {
-					recover(&ptable);
-					die("The output of parser is illegal.\n%s", ctags_x);
-				}
-				/*
-				 * Function header is applied only to the anchor whoes type is 'D'.
-				 * (D: function, M: macro, T: type)
-				 */
-				type = 'T';
-				if (*p == '#')
-					type = 'M';
-				else if (locatestring(p, "typedef", MATCH_AT_FIRST))
-					type = 'T';
-				else if ((p = locatestring(p, ptable.part[PART_TAG].start, MATCH_FIRST)) != NULL) {
-					/* skip a tag and the following blanks */
-					p += strlen(ptable.part[PART_TAG].start);
-					for (; *p && isspace((unsigned char)*p); p++)
-						;
-					if (*p == '(')
-						type = 'D';
-				}
-			}  else if (db == GRTAGS)
-				type = 'R';
-			else
-				type = 'Y';
-			/* allocate an entry */
-			a = varray_append(vb);
-			a->lineno = atoi(ptable.part[PART_LNO].start);
-			a->type = type;
-			a->done = 0;
-			settag(a, ptable.part[PART_TAG].start);
-			recover(&ptable);
-		}
-		if (ctags_xid == NULL) {
-			xargs_close(anchor_input[db]);
-			anchor_input[db] = NULL;
-		}
+		/* allocate an entry */
+		a = varray_append(vb);
+		a->lineno = 0;
+		for (; isdigit((unsigned char)*p); p++)
+			a->lineno = a->lineno * 10 + *p - '0';
+		a->type = *record;
+		a->done = 0;
+		settag(a, p + 1);
+		if (a->type == '?')
+			undecided++;
 	}
 	if (vb->length == 0) {
 		table = NULL;
@@ -202,6 +290,31 @@ anchor_load(const char *path)
 		 */
 		table = varray_assign(vb, 0, 0);
 		qsort(table, used, sizeof(struct anchor), cmp); 
+		/*
+		 * The type of definitions in compact format is decided
+		 * by the line image, which is read from the source file.
+		 */
+		if (undecided) {
+			STRBUF *ib = strbuf_open(0);
+			FILE *ip = fopen(path, "r");
+			const char *image = NULL;
+			int lineno = 0;
+
+			if (ip == NULL)
+				die("cannot open file '%s'.", path);
+			for (i = 0; i < used; i++) {
+				if (table[i].type != '?')
+					continue;
+				while (lineno < table[i].lineno) {
+					if ((image = strbuf_fgets(ib, ip, STRBUF_NOCRLF)) == NULL)
+						die("tag file is not up to date. (%s:%d)", path, table[i].lineno);
+					lineno++;
+				}
+				table[i].type = deftype(image, gettag((&table[i])));
+			}
+			fclose(ip);
+			strbuf_close(ib);
+		}
 		/*
 		 * Setup some lineno.
 		 */
@@ -243,6 +356,47 @@ anchor_unload(void)
 	FIRST = LAST = 0;
 	start = curp = end = NULL;
 }
+/*
+ * anchor_close: close the anchor table made by anchor_prepare().
+ */
+void
+anchor_close(void)
+{
+	if (anchor_db != NULL) {
+		dbop_close(anchor_db);
+		anchor_db = NULL;
+	}
+}
+/*
+ * anchor_links: put the link targets of the anchors.
+ *
+ *	o)	sb	"<line number> <type><tag> <target>\n" for each anchor
+ *
+ * About the target, please see put_anchor() in src2html.c.
+ */
+void
+anchor_links(STRBUF *sb)
+{
+	struct anchor *a;
+
+	for (a = start; a && a < end; a++) {
+		int db = (a->type == 'R') ? GTAGS : (a->type == 'Y') ? GSYMS : GRTAGS;
+		const char *line = cache_get(db, gettag(a));
+
+		strbuf_putn(sb, a->lineno);
+		strbuf_putc(sb, ' ');
+		strbuf_putc(sb, a->type);
+		strbuf_puts(sb, gettag(a));
+		strbuf_putc(sb, ' ');
+		if (line != NULL) {
+			/* " <tag number> <frequency>" or "<line number> <fid>" */
+			strbuf_puts(sb, line);
+			strbuf_putc(sb, ' ');
+			strbuf_puts(sb, nextstring(line));
+		}
+		strbuf_putc(sb, '\n');
+	}
+}
 /*
  * anchor_first: return the first anchor
  */
@@ -299,6 +453,14 @@ anchor_get(const char *name, int length, int type, int lineno)
 		if (!p->done && p->length == length && !strcmp(gettag(p), name))
 			if (!type || p->type == type)
 				return p;
+	/*
+	 * A reference is recorded only once in a line, though it may
+	 * appear more than once there.
+	 */
+	for (p = curp; p < end && p->lineno == lineno; p++)
+		if ((p->type == 'R' || p->type == 'Y') && p->length == length && !strcmp(gettag(p), name))
+			if (!type || p->type == type)
+				return p;
 	return NULL;
 }
 /*
@@ -20,6 +20,8 @@
 #define _ANCHOR_H_
 
 #include "checkalloc.h"
+#include "idset.h"
+#include "strbuf.h"
 /*
  * Anchor table.
  *
@@ -63,9 +65,11 @@ struct anchor {
 #define A_HELP		7
 #define A_LIMIT		8
 
-void anchor_prepare(FILE *);
+void anchor_prepare(IDSET *);
 void anchor_load(const char *);
 void anchor_unload(void);
+void anchor_close(void);
+void anchor_links(STRBUF *);
 struct anchor *anchor_first(void);
 struct anchor *anchor_next(void);
 struct anchor *anchor_get(const char *, int, int, int);
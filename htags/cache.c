@@ -26,12 +26,15 @@
 #include <strings.h>
 #endif
 #include <errno.h>
+#ifdef STDC_HEADERS
+#include <stdlib.h>
+#endif
 #include "global.h"
 #include "assoc.h"
+#include "strhash.h"
 #include "htags.h"
 #include "cache.h"
 
-static ASSOC *assoc[GTAGLIM];
 /*
  * Cache file is used for duplicate object entry.
  *
@@ -54,15 +57,70 @@ static ASSOC *assoc[GTAGLIM];
  *    Tag is referred to as 'S/<fid>.html#<line number>'.
  */
 
+/*
+ * Cache of each tag file.
+ *
+ * Records are kept in a hash table in memory, and the record data are
+ * allocated from the pool of the hash table. If the total size exceeds
+ * the limit (HTAGSCACHE bytes or the value of the environment variable
+ * HTAGSCACHE), the records of the tag file being written are moved to
+ * a temporary file (ASSOC), and the following records go there.
+ */
+#define CACHEBUCKETS	65536
+
+struct cache {
+	STRHASH *hash;			/* records in memory */
+	ASSOC *assoc;			/* records in temporary file */
+	long size;			/* memory size of the records */
+};
+struct record {
+	int len;			/* length of the record */
+	char *line;			/* record */
+};
+static struct cache cache[GTAGLIM];
+static long total_size;			/* memory size of all records */
+static long limit;			/* limit of total_size */
+
+/*
+ * spill: move the records of the tag file to temporary file.
+ *
+ *	i)	db	db type
+ */
+static void
+spill(int db)
+{
+	struct cache *c = &cache[db];
+	struct sh_entry *entry;
+
+	message(" Tag cache exceeds %ld bytes. Using temporary file.", limit);
+	c->assoc = assoc_open();
+	for (entry = strhash_first(c->hash); entry; entry = strhash_next(c->hash)) {
+		struct record *r = entry->value;
+
+		assoc_put_withlen(c->assoc, entry->name, r->line, r->len);
+	}
+	strhash_close(c->hash);
+	c->hash = NULL;
+	total_size -= c->size;
+	c->size = 0;
+}
 /*
  * cache_open: open cache file.
  */
 void
 cache_open(void)
 {
-	assoc[GTAGS]  = assoc_open();
-	assoc[GRTAGS] = assoc_open();
-	assoc[GSYMS] = symbol ? assoc_open() : NULL;
+	int db;
+
+	limit = HTAGSCACHE;
+	if (getenv("HTAGSCACHE") != NULL)
+		limit = atol(getenv("HTAGSCACHE"));
+	total_size = 0;
+	for (db = GTAGS; db < GTAGLIM; db++) {
+		cache[db].hash = (db != GSYMS || symbol) ? strhash_open(CACHEBUCKETS) : NULL;
+		cache[db].assoc = NULL;
+		cache[db].size = 0;
+	}
 }
 /*
  * cache_put: put tag line.
@@ -70,13 +128,37 @@ cache_open(void)
  *	i)	db	db type
  *	i)	tag	tag name
  *	i)	line	tag line
+ *	i)	len	length of the tag line
  */
 void
 cache_put(int db, const char *tag, const char *line, int len)
 {
+	struct cache *c;
+	struct sh_entry *entry;
+	struct record *r;
+	long size;
+
 	if (db >= GTAGLIM)
 		die("I don't know such tag file.");
-	assoc_put_withlen(assoc[db], tag, line, len);
+	c = &cache[db];
+	if (c->assoc) {
+		assoc_put_withlen(c->assoc, tag, line, len);
+		return;
+	}
+	size = len;
+	entry = strhash_assign(c->hash, tag, 1);
+	if (entry->value == NULL) {
+		entry->value = pool_malloc(c->hash->pool, sizeof(struct record));
+		size += sizeof(struct sh_entry) + sizeof(struct record) + strlen(tag) + 1;
+	}
+	r = entry->value;
+	r->line = pool_malloc(c->hash->pool, len);
+	memcpy(r->line, line, len);
+	r->len = len;
+	c->size += size;
+	total_size += size;
+	if (total_size > limit)
+		spill(db);
 }
 /*
  * cache_get: get tag line.
@@ -88,9 +170,18 @@ cache_put(int db, const char *tag, const char *line, int len)
 const char *
 cache_get(int db, const char *tag)
 {
+	struct cache *c;
+	struct sh_entry *entry;
+
 	if (db >= GTAGLIM)
 		die("I don't know such tag file.");
-	return assoc_get(assoc[db], tag);
+	c = &cache[db];
+	if (c->assoc)
+		return assoc_get(c->assoc, tag);
+	if (c->hash == NULL)
+		return NULL;
+	entry = strhash_assign(c->hash, tag, 0);
+	return entry ? ((struct record *)entry->value)->line : NULL;
 }
 /*
  * cache_close: close cache file.
@@ -98,12 +189,16 @@ cache_get(int db, const char *tag)
 void
 cache_close(void)
 {
-	int i;
+	int db;
 
-	for (i = GTAGS; i < GTAGLIM; i++) {
-		if (assoc[i]) {
-			assoc_close(assoc[i]);
-			assoc[i] = NULL;
+	for (db = GTAGS; db < GTAGLIM; db++) {
+		if (cache[db].hash) {
+			strhash_close(cache[db].hash);
+			cache[db].hash = NULL;
+		}
+		if (cache[db].assoc) {
+			assoc_close(cache[db].assoc);
+			cache[db].assoc = NULL;
 		}
 	}
 }
@@ -649,6 +649,110 @@ gen_list_begin(void)
 	}
 	return strbuf_value(sb);
 }
+/*
+ * Generate list body from a tag record.
+ *
+ *	i)	srcdir	source directory
+ *	i)	tag	tag name
+ *	i)	lineno	line number
+ *	i)	path	path name (./...)
+ *	i)	image	line image
+ *	i)	fid	file id (NULL: computed from path)
+ *	r)		list body
+ *
+ * The line is laid out as the output of 'global -x'.
+ */
+const char *
+gen_list_record(const char *srcdir, const char *tag, int lineno, const char *path, const char *image, const char *fid)
+{
+	STATIC_STRBUF(sb);
+	char lno[32];
+	const char *p;
+	int width;
+
+	strbuf_clear(sb);
+	snprintf(lno, sizeof(lno), "%d", lineno);
+	if (fid == NULL)
+		fid = path2fid(path);
+	if (table_list) {
+		strbuf_puts(sb, current_row_begin);
+		if (enable_xhtml) {
+			strbuf_puts(sb, "<td class='tag'>");
+			strbuf_puts(sb, gen_href_begin(srcdir, fid, HTML, lno));
+			strbuf_puts(sb, tag);
+			strbuf_puts(sb, gen_href_end());
+			strbuf_sprintf(sb, "</td><td class='line'>%s</td><td class='file'>%s</td><td class='code'>",
+				lno, path + 2);
+		} else {
+			strbuf_puts(sb, "<td nowrap>");
+			strbuf_puts(sb, gen_href_begin(srcdir, fid, HTML, lno));
+			strbuf_puts(sb, tag);
+			strbuf_puts(sb, gen_href_end());
+			strbuf_sprintf(sb, "</td><td nowrap align='right'>%s</td><td nowrap align='left'>%s</td><td nowrap>",
+				lno, path + 2);
+		}
+		for (p = image; *p == ' ' || *p == '\t'; p++)
+			;
+		for (; *p; p++) {
+			unsigned char c = *p;
+
+			if (c == '&')
+				strbuf_puts(sb, quote_amp);
+			else if (c == '<')
+				strbuf_puts(sb, quote_little);
+			else if (c == '>')
+				strbuf_puts(sb, quote_great);
+			else if (c == ' ')
+				strbuf_puts(sb, quote_space);
+			else if (c == '\t') {
+				strbuf_puts(sb, quote_space);
+				strbuf_puts(sb, quote_space);
+			} else
+				strbuf_putc(sb, c);
+		}
+		strbuf_puts(sb, "</td>");
+		strbuf_puts(sb, current_row_end);
+	} else {
+		/* print tag name with anchor */
+		strbuf_puts(sb, current_line_begin);
+		strbuf_puts(sb, gen_href_begin(srcdir, fid, HTML, lno));
+		strbuf_puts(sb, tag);
+		strbuf_puts(sb, gen_href_end());
+
+		/* print line number: "%-16s %4d " */
+		width = strlen(tag);
+		if (width < 16)
+			strbuf_nputc(sb, ' ', 16 - width);
+		strbuf_putc(sb, ' ');
+		width = strlen(lno);
+		if (width < 4)
+			strbuf_nputc(sb, ' ', 4 - width);
+		strbuf_puts(sb, lno);
+		strbuf_putc(sb, ' ');
+		/* print file name: "%-16s " (the width is that of the encoded path) */
+		strbuf_puts(sb, path + 2);
+		for (width = 0, p = path; *p; p++)
+			width += (*p == ' ' || *p == '\t' || *p == '%') ? 3 : 1;
+		if (width < 16)
+			strbuf_nputc(sb, ' ', 16 - width);
+		strbuf_putc(sb, ' ');
+		/* print the rest */
+		for (p = image; *p; p++) {
+			unsigned char c = *p;
+
+			if (c == '&')
+				strbuf_puts(sb, quote_amp);
+			else if (c == '<')
+				strbuf_puts(sb, quote_little);
+			else if (c == '>')
+				strbuf_puts(sb, quote_great);
+			else
+				strbuf_putc(sb, c);
+		}
+		strbuf_puts(sb, current_line_end);
+	}
+	return strbuf_value(sb);
+}
 /*
  * Generate list body.
  *
@@ -32,6 +32,7 @@
 #include "global.h"
 #include "cache.h"
 #include "htags.h"
+#include "pack.h"
 #include "path2url.h"
 #include "common.h"
 
@@ -50,14 +51,15 @@ makedefineindex(const char *file, int total, STRBUF *defines)
 	int alpha_count = 0;
 	FILEOP *fileop_MAP = NULL, *fileop_DEFINES, *fileop_ALPHA = NULL;
 	FILE *MAP = NULL;
-	FILE *DEFINES, *STDOUT, *TAGS, *ALPHA = NULL;
-	STRBUF *sb = strbuf_open(0);
+	FILE *DEFINES, *STDOUT, *ALPHA = NULL;
+	GTOP *gtop;
+	GTP *gtp;
 	STRBUF *url = strbuf_open(0);
 	/* Index link */
 	const char *target = (Fflag) ? "mains" : "_top";
 	const char *indexlink;
 	const char *index_string = "Index Page";
-	char command[1024], buf[1024], alpha[32], alpha_f[32], *_;
+	char buf[1024], alpha[32], alpha_f[32];
 
 	if (!aflag && !Fflag)
 		indexlink = "mains";
@@ -97,16 +99,17 @@ makedefineindex(const char *file, int total, STRBUF *defines)
 	 * map DEFINES to STDOUT.
 	 */
 	STDOUT = DEFINES;
-	snprintf(command, sizeof(command), PQUOTE "%s -c" PQUOTE, quote_shell(global_path));
-	if ((TAGS = popen(command, "r")) == NULL)
-		die("cannot fork.");
+	/*
+	 * Read the keys of GTAGS in order.
+	 */
+	gtop = gtags_open(dbpath, cwdpath, GTAGS, GTAGS_READ, 0);
 	alpha[0] = '\0';
-	while ((_ = strbuf_fgets(sb, TAGS, STRBUF_NOCRLF)) != NULL) {
+	for (gtp = gtags_first(gtop, NULL, GTOP_KEY); gtp; gtp = gtags_next(gtop)) {
 		const char *tag, *line;
 		char guide[1024], url_for_map[1024];
 
 		count++;
-		tag = _;
+		tag = gtp->tag;
 		message(" [%d/%d] adding %s", count, total, tag);
 		if (aflag && (alpha[0] == '\0' || !locatestring(tag, alpha, MATCH_AT_FIRST))) {
 			const char *msg = (alpha_count == 1) ? "definition" : "definitions";
@@ -210,6 +213,10 @@ makedefineindex(const char *file, int total, STRBUF *defines)
 					strbuf_puts(url, "../");
 				strbuf_puts(url, action);
 				strbuf_sprintf(url, "?pattern=%s%stype=definitions", tag, quote_amp);
+			} else if (packed) {
+				if (aflag)
+					strbuf_puts(url, "../");
+				strbuf_puts(url, pack_url(DEFS, fid));
 			} else {
 				if (aflag)
 					strbuf_puts(url, "../");
@@ -242,8 +249,7 @@ makedefineindex(const char *file, int total, STRBUF *defines)
 		if (map_file)
 			fprintf(MAP, "%s\t%s\n", tag, url_for_map);
 	}
-	if (pclose(TAGS) != 0)
-		die("'%s' failed.", command);
+	gtags_close(gtop);
 	if (aflag && alpha[0]) {
 		char tmp[128];
 		const char *msg = (alpha_count == 1) ? "definition" : "definitions";
@@ -285,7 +291,6 @@ makedefineindex(const char *file, int total, STRBUF *defines)
 	html_count++;
 	if (map_file)
 		close_file(fileop_MAP);
-	strbuf_close(sb);
 	strbuf_close(url);
 	return count;
 }
@@ -30,6 +30,8 @@
 #include "common.h"
 #include "global.h"
 #include "htags.h"
+#include "incremental.h"
+#include "pack.h"
 
 /*
  * Data for each tag file.
@@ -38,176 +40,326 @@
  */
 static const char *dirs[]    = {NULL, DEFS,         REFS,        SYMS};
 static const char *kinds[]   = {NULL, "definition", "reference", "symbol"};
-static const char *options[] = {NULL, "",           "r",         "s"};
 
+/*
+ * State of the duplicate object index of a tag file.
+ */
+struct dupindex {
+	int db;				/* GTAGS, GRTAGS or GSYMS */
+	int count;			/* number of tags */
+	int number;			/* page number of the tag list */
+	int entry_count;		/* number of entries of the tag */
+	int writing;			/* 1: writing the tag list */
+	char prev[IDENTLEN];		/* current tag name */
+	/*
+	 * The first entry of the current tag.
+	 * It is pending until the second entry appears.
+	 */
+	int first_lineno;		/* 0: no entry is pending */
+	char first_fid[MAXFIDLEN];
+	char first_path[MAXPATHLEN];
+	STRBUF *first_image;
+	FILEOP *fileop;
+	FILE *op;
+	PACK *pack;			/* pack file (--pack) */
+	STRBUF *tmp;
+};
+/*
+ * Source file which is read for the line image of compact format.
+ */
+static struct {
+	char path[MAXPATHLEN];
+	FILE *ip;
+	LINEINDEX *li;
+	int lineno;
+	STRBUF *ib;
+} source;
+
+static const char *srcdir = "../" SRCS;
+
+/*
+ * get_image: get the line image from the source file.
+ *
+ *	i)	path	path name
+ *	i)	fid	file id
+ *	i)	lineno	line number
+ *	r)		line image
+ *
+ * If the line index is available, the line is read directly.
+ * Otherwise, the source file is read sequentially.
+ * This is also used by the server (--server).
+ */
+const char *
+get_image(const char *path, const char *fid, int lineno)
+{
+	const char *image;
+
+	if (strcmp(source.path, path) != 0) {
+		if (source.ip != NULL)
+			fclose(source.ip);
+		if (source.li != NULL)
+			lineindex_close(source.li);
+		source.ip = NULL;
+		strlimcpy(source.path, path, sizeof(source.path));
+		source.li = lineindex_open(path, fid);
+		if (source.li == NULL) {
+			source.ip = fopen(path, "r");
+			if (source.ip == NULL)
+				warning("source file '%s' is not available.", path);
+		}
+		source.lineno = 0;
+	}
+	if (source.li != NULL)
+		return (image = lineindex_read(source.li, lineno)) != NULL ? image : "";
+	if (source.ip == NULL)
+		return "";
+	if (lineno <= source.lineno) {
+		rewind(source.ip);
+		source.lineno = 0;
+	}
+	if (source.ib == NULL)
+		source.ib = strbuf_open(0);
+	do {
+		if (strbuf_fgets(source.ib, source.ip, STRBUF_NOCRLF) == NULL)
+			return "";
+		source.lineno++;
+	} while (source.lineno < lineno);
+	return strbuf_value(source.ib);
+}
+/*
+ * close_source: close the source file.
+ */
+void
+close_source(void)
+{
+	if (source.ip != NULL)
+		fclose(source.ip);
+	if (source.li != NULL)
+		lineindex_close(source.li);
+	if (source.ib != NULL)
+		strbuf_close(source.ib);
+	memset(&source, 0, sizeof(source));
+}
+/*
+ * end_of_tag: finish the current tag.
+ *
+ *	i)	d	dupindex
+ *
+ * cache record: " <page number>\0<entry number>\0"	(two or more entries)
+ * cache record: "<line number>\0<fid>\0"		(single entry)
+ */
+static void
+end_of_tag(struct dupindex *d)
+{
+	if (d->writing) {
+		if (!dynamic) {
+			fputs_nl(gen_list_end(), d->op);
+			fputs_nl(body_end, d->op);
+			fputs_nl(gen_page_end(), d->op);
+			if (d->pack)
+				pack_end(d->pack);
+			else
+				close_file(d->fileop);
+			html_count++;
+		}
+		d->writing = 0;
+		strbuf_reset(d->tmp);
+		strbuf_putc(d->tmp, ' ');
+		strbuf_putn(d->tmp, d->number);
+		strbuf_putc(d->tmp, '\0');
+		strbuf_putn(d->tmp, d->entry_count);
+		cache_put(d->db, d->prev, strbuf_value(d->tmp), strbuf_getlen(d->tmp) + 1);
+	}
+	if (d->first_lineno) {
+		strbuf_reset(d->tmp);
+		strbuf_putn(d->tmp, d->first_lineno);
+		strbuf_putc(d->tmp, '\0');
+		strbuf_puts(d->tmp, d->first_fid);
+		cache_put(d->db, d->prev, strbuf_value(d->tmp), strbuf_getlen(d->tmp) + 1);
+		d->first_lineno = 0;
+	}
+}
+/*
+ * put_entry: put an entry of the tag.
+ *
+ *	i)	d	dupindex
+ *	i)	tag	tag name
+ *	i)	lineno	line number
+ *	i)	path	path name
+ *	i)	fid	file id
+ *	i)	image	line image
+ *
+ * If referred tag is only one, the entry is kept as the first entry.
+ * Else if two or more tag exists, the tag list is written.
+ */
+static void
+put_entry(struct dupindex *d, const char *tag, int lineno, const char *path, const char *fid, const char *image)
+{
+	if (strcmp(d->prev, tag)) {
+		end_of_tag(d);
+		d->count++;
+		if (vflag)
+			fprintf(stderr, " [%d] adding %s %s\n", d->count, kinds[d->db], tag);
+		d->first_lineno = lineno;
+		strlimcpy(d->first_fid, fid, sizeof(d->first_fid));
+		strlimcpy(d->first_path, path, sizeof(d->first_path));
+		strbuf_reset(d->first_image);
+		strbuf_puts(d->first_image, image);
+		strlimcpy(d->prev, tag, sizeof(d->prev));
+		d->entry_count = 0;
+		return;
+	}
+	/* duplicate entry */
+	if (d->first_lineno) {
+		/*
+		 * In the incremental mode, the tag keeps the page number
+		 * of the previous run.
+		 */
+		d->number = incremental ? incremental_number(d->db, tag, d->count) : d->count;
+		if (d->pack) {
+			d->op = pack_begin(d->pack, d->number);
+		} else if (!dynamic) {
+			char path[MAXPATHLEN];
+
+			snprintf(path, sizeof(path), "%s/%s/%d.%s", distpath, dirs[d->db], d->number, HTML);
+			d->fileop = open_output_file(path, cflag);
+			d->op = get_descripter(d->fileop);
+		}
+		if (!dynamic) {
+			fputs_nl(gen_page_begin(tag, SUBDIR), d->op);
+			fputs_nl(body_begin, d->op);
+			fputs_nl(gen_list_begin(), d->op);
+			fputs_nl(gen_list_record(srcdir, tag, d->first_lineno, d->first_path,
+				strbuf_value(d->first_image), d->first_fid), d->op);
+		}
+		d->writing = 1;
+		d->entry_count++;
+		d->first_lineno = 0;
+	}
+	if (!dynamic)
+		fputs_nl(gen_list_record(srcdir, tag, lineno, path, image, fid), d->op);
+	d->entry_count++;
+}
+/*
+ * Arguments for put_compact().
+ */
+struct compact_record {
+	struct dupindex *d;
+	const char *tag;
+	const char *path;
+	const char *fid;
+};
+/*
+ * put_compact: put an entry of compact format (callback of gtags_unfold()).
+ */
+static void
+put_compact(int lineno, void *arg)
+{
+	struct compact_record *rec = arg;
+	const char *image = dynamic ? " " : get_image(rec->path, rec->fid, lineno);
+
+	put_entry(rec->d, rec->tag, lineno, rec->path, rec->fid, image);
+}
+/*
+ * put_record: put entries of a tag record.
+ *
+ *	i)	d	dupindex
+ *	i)	gtop	GTOP structure
+ *	i)	gtp	tag record
+ *
+ * tagline = <file id> <tag name> <line no> <line image>	(standard)
+ * tagline = <file id> <tag name> <line no>,...		(compact)
+ */
+static void
+put_record(struct dupindex *d, GTOP *gtop, GTP *gtp)
+{
+	char fid[MAXFIDLEN], tag[IDENTLEN];
+	const char *p = gtp->tagline, *name;
+	int n;
+
+	for (n = 0; *p && *p != ' '; p++)
+		if (n < (int)sizeof(fid) - 1)
+			fid[n++] = *p;
+	fid[n] = '\0';
+	for (p++, n = 0; *p && *p != ' '; p++)
+		if (n < (int)sizeof(tag) - 1)
+			tag[n++] = *p;
+	tag[n] = '\0';
+	if (*p++ != ' ')
+		die("illegal tag record.\n%s", gtp->tagline);
+	name = tag;
+	if (gtop->format & GTAGS_COMPNAME)
+		strlimcpy(tag, uncompress(tag, gtp->tag), sizeof(tag));
+	if (gtop->format & GTAGS_COMPACT) {
+		struct compact_record rec;
+
+		rec.d = d;
+		rec.tag = name;
+		rec.path = gtp->path;
+		rec.fid = fid;
+		gtags_unfold(gtop, p, put_compact, &rec);
+	} else {
+		const char *image = " ";
+
+		if (!dynamic) {
+			if ((image = locatestring(p, " ", MATCH_FIRST)) == NULL)
+				die("illegal tag record.\n%s", gtp->tagline);
+			image++;
+			if (gtop->format & GTAGS_COMPRESS)
+				image = uncompress(image, gtp->tag);
+		}
+		put_entry(d, name, gtp->lineno, gtp->path, fid, image);
+	}
+}
 /*
  * Make duplicate object index.
  *
  * If referred tag is only one, direct link which points the tag is generated.
  * Else if two or more tag exists, indirect link which points the tag list
  * is generated.
+ *
+ * Each tag file is read in key order through the library.
  */
 int
 makedupindex(void)
 {
-	STRBUF *sb = strbuf_open(0);
-	STRBUF *tmp = strbuf_open(0);
-	STRBUF *command = strbuf_open(0);
+	struct dupindex d;
 	int definition_count = 0;
-	char srcdir[MAXPATHLEN];
 	int db;
-	FILEOP *fileop = NULL;
-	FILE *op = NULL;
-	FILE *ip = NULL;
 
-	snprintf(srcdir, sizeof(srcdir), "../%s", SRCS);
+	d.first_image = strbuf_open(0);
+	d.tmp = strbuf_open(0);
 	for (db = GTAGS; db < GTAGLIM; db++) {
-		const char *kind = kinds[db];
-		const char *option = options[db];
-		int writing = 0;
-		int count = 0;
-		int entry_count = 0;
-		const char *ctags_xid, *ctags_x;
-		char tag[IDENTLEN], prev[IDENTLEN], first_line[MAXBUFLEN];
+		GTOP *gtop;
+		GTP *gtp;
+		int flags = 0;
 
 		if (gtags_exist[db] == 0)
 			continue;
-		prev[0] = 0;
-		first_line[0] = 0;
-		/*
-		 * construct command line.
-		 */
-		strbuf_reset(command);
-#if defined(_WIN32) && !defined(__CYGWIN__)
-		strbuf_putc(command, '"');
-#endif
-		strbuf_sprintf(command, "%s -x%s --result=ctags-xid --encode-path=\" \t\" --nofilter=path", quote_shell(global_path), option);
+		d.db = db;
+		d.count = d.number = d.entry_count = d.writing = 0;
+		d.prev[0] = '\0';
+		d.first_lineno = 0;
+		d.fileop = NULL;
+		d.op = NULL;
+		d.pack = (packed && !dynamic) ? pack_open(dirs[db]) : NULL;
 		/*
 		 * Optimization when the --dynamic option is specified.
 		 */
-		if (dynamic) {
-			strbuf_puts(command, " --nosource");
-			if (db != GSYMS)
-				strbuf_puts(command, " --nofilter=sort");
-		}
-		strbuf_puts(command, " \".*\"");
-#if defined(_WIN32) && !defined(__CYGWIN__)
-		strbuf_putc(command, '"');
-#endif
-		if ((ip = popen(strbuf_value(command), "r")) == NULL)
-			die("cannot execute command '%s'.", strbuf_value(command));
-		while ((ctags_xid = strbuf_fgets(sb, ip, STRBUF_NOCRLF)) != NULL) {
-			char fid[MAXFIDLEN];
-
-			ctags_x = parse_xid(ctags_xid, fid, NULL);
-			/* tag name */
-			(void)strcpy_withterm(tag, ctags_x, sizeof(tag), ' ');
-			if (strcmp(prev, tag)) {
-				count++;
-				if (vflag)
-					fprintf(stderr, " [%d] adding %s %s\n", count, kind, tag);
-				if (writing) {
-					if (!dynamic) {
-						fputs_nl(gen_list_end(), op);
-						fputs_nl(body_end, op);
-						fputs_nl(gen_page_end(), op);
-						close_file(fileop);
-						html_count++;
-					}
-					writing = 0;
-					/*
-					 * cache record: " <fid>\0<entry number>\0"
-					 */
-					strbuf_reset(tmp);
-					strbuf_putc(tmp, ' ');
-					strbuf_putn(tmp, count - 1);
-					strbuf_putc(tmp, '\0');
-					strbuf_putn(tmp, entry_count);
-					cache_put(db, prev, strbuf_value(tmp), strbuf_getlen(tmp) + 1);
-				}				
-				/* single entry */
-				if (first_line[0]) {
-					char fid[MAXFIDLEN];
-					const char *ctags_x = parse_xid(first_line, fid, NULL);
-					const char *lno = nextelement(ctags_x);
-
-					strbuf_reset(tmp);
-					strbuf_puts_withterm(tmp, lno, ' ');
-					strbuf_putc(tmp, '\0');
-					strbuf_puts(tmp, fid);
-					cache_put(db, prev, strbuf_value(tmp), strbuf_getlen(tmp) + 1);
-				}
-				/*
-				 * Chop the tail of the line. It is not important.
-				 * strlimcpy(first_line, ctags_x, sizeof(first_line));
-				 */
-				strncpy(first_line, ctags_xid, sizeof(first_line));
-				first_line[sizeof(first_line) - 1] = '\0';
-				strlimcpy(prev, tag, sizeof(prev));
-				entry_count = 0;
-			} else {
-				/* duplicate entry */
-				if (first_line[0]) {
-					char fid[MAXFIDLEN];
-					const char *ctags_x = parse_xid(first_line, fid, NULL);
-
-					if (!dynamic) {
-						char path[MAXPATHLEN];
-
-						snprintf(path, sizeof(path), "%s/%s/%d.%s", distpath, dirs[db], count, HTML);
-						fileop = open_output_file(path, cflag);
-						op = get_descripter(fileop);
-						fputs_nl(gen_page_begin(tag, SUBDIR), op);
-						fputs_nl(body_begin, op);
-						fputs_nl(gen_list_begin(), op);
-						fputs_nl(gen_list_body(srcdir, ctags_x, fid), op);
-					}
-					writing = 1;
-					entry_count++;
-					first_line[0] = 0;
-				}
-				if (!dynamic) {
-					fputs_nl(gen_list_body(srcdir, ctags_x, fid), op);
-				}
-				entry_count++;
-			}
-		}
+		if (dynamic && db != GSYMS)
+			flags |= GTOP_NOSORT;
+		gtop = gtags_open(dbpath, cwdpath, db, GTAGS_READ, 0);
+		for (gtp = gtags_first(gtop, NULL, flags); gtp; gtp = gtags_next(gtop))
+			put_record(&d, gtop, gtp);
+		close_source();
+		gtags_close(gtop);
+		end_of_tag(&d);
+		if (d.pack)
+			pack_close(d.pack);
 		if (db == GTAGS)
-			definition_count = count;
-		if (pclose(ip) != 0)
-			die("'%s' failed.", strbuf_value(command));
-		if (writing) {
-			if (!dynamic) {
-				fputs_nl(gen_list_end(), op);
-				fputs_nl(body_end, op);
-				fputs_nl(gen_page_end(), op);
-				close_file(fileop);
-				html_count++;
-			}
-			/*
-			 * cache record: " <fid>\0<entry number>\0"
-			 */
-			strbuf_reset(tmp);
-			strbuf_putc(tmp, ' ');
-			strbuf_putn(tmp, count);
-			strbuf_putc(tmp, '\0');
-			strbuf_putn(tmp, entry_count);
-			cache_put(db, prev, strbuf_value(tmp), strbuf_getlen(tmp) + 1);
-		}
-		if (first_line[0]) {
-			char fid[MAXFIDLEN];
-			const char *ctags_x = parse_xid(first_line, fid, NULL);
-			const char *lno = nextelement(ctags_x);
-
-			strbuf_reset(tmp);
-			strbuf_puts_withterm(tmp, lno, ' ');
-			strbuf_putc(tmp, '\0');
-			strbuf_puts(tmp, fid);
-			cache_put(db, prev, strbuf_value(tmp), strbuf_getlen(tmp) + 1);
-		}
+			definition_count = d.count;
 	}
-	strbuf_close(sb);
-	strbuf_close(tmp);
-	strbuf_close(command);
+	strbuf_close(d.first_image);
+	strbuf_close(d.tmp);
 	return definition_count;
 }
@@ -38,6 +38,9 @@
 #include <sys/stat.h>
 #include <sys/param.h>
 #include <errno.h>
+#if !defined(_WIN32) || defined(__CYGWIN__)
+#include <sys/wait.h>
+#endif
 
 #include "checkalloc.h"
 #include "getopt.h"
@@ -48,11 +51,15 @@
 #include "common.h"
 #include "htags.h"
 #include "incop.h"
+#include "incremental.h"
+#include "pack.h"
 #include "path2url.h"
+#include "server.h"
 #include "const.h"
 
 void src2html(const char *, const char *, int);
 int makedupindex(void);
+int makesuggestindex(void);
 int makedefineindex(const char *, int, STRBUF *);
 int makefileindex(const char *, STRBUF *);
 void makeincludeindex(void);
@@ -73,6 +80,7 @@ int sep = '/';
 int need_bless;
 const char *save_config;
 const char *save_argv;
+const char *save_options;
 
 char cwdpath[MAXPATHLEN];
 char dbpath[MAXPATHLEN];
@@ -114,6 +122,10 @@ int qflag;
 int vflag;				/* --verbose(-v) option		*/
 int wflag;				/* --warning(-w) option		*/
 int debug;				/* --debug option		*/
+int jobs = 1;				/* --jobs option		*/
+int incremental;			/* --incremental option		*/
+int packed;				/* --pack option		*/
+int server_port;			/* --server option		*/
 
 int show_help;				/* --help command		*/
 int show_version;			/* --version command		*/
@@ -291,8 +303,10 @@ static struct option const long_options[] = {
         {"full-path", no_argument, &full_path, 1},
         {"fixed-guide",  no_argument, &fixed_guide, 1},
         {"html", no_argument, &enable_xhtml, 0},
+        {"incremental", no_argument, &incremental, 1},
         {"map-file", no_argument, &map_file, 1},
         {"overwrite-key", no_argument, &overwrite_key, 1},
+        {"pack", no_argument, &packed, 1},
         {"show-position", no_argument, &show_position, 1},
         {"statistics", no_argument, &statistics, STATISTICS_STYLE_TABLE},
         {"suggest", no_argument, &suggest, 1},
@@ -317,6 +331,8 @@ static struct option const long_options[] = {
 #define OPT_HTML_HEADER		140
 #define OPT_CALL_TREE		141
 #define OPT_CALLEE_TREE		142
+#define OPT_JOBS		143
+#define OPT_SERVER		144
         {"auto-completion", optional_argument, NULL, OPT_AUTO_COMPLETION},
         {"call-tree", required_argument, NULL, OPT_CALL_TREE},
         {"callee-tree", required_argument, NULL, OPT_CALLEE_TREE},
@@ -328,8 +344,10 @@ static struct option const long_options[] = {
         {"html-header", required_argument,NULL, OPT_HTML_HEADER},
         {"ncol", required_argument, NULL, OPT_NCOL},
         {"insert-footer", required_argument, NULL, OPT_INSERT_FOOTER},
+        {"jobs", required_argument, NULL, OPT_JOBS},
         {"insert-header", required_argument, NULL, OPT_INSERT_HEADER},
         {"item-order", required_argument, NULL, OPT_ITEM_ORDER},
+        {"server", optional_argument, NULL, OPT_SERVER},
 	{"tabs", required_argument, NULL, OPT_TABS},
         {"tree-view",  optional_argument, NULL, OPT_TREE_VIEW},
         { 0 }
@@ -889,55 +907,107 @@ makehtaccess(const char *cgidir, const char *file)
 	}
 	fclose(op);
 }
+#if !defined(_WIN32) || defined(__CYGWIN__)
 /*
- * makehtml: make html files
+ * open_tmpfile: open an anonymous temporary file.
+ *
+ *	r)		file pointer
+ */
+static FILE *
+open_tmpfile(void)
+{
+	FILE *fp = tmpfile();
+
+	if (fp == NULL)
+		die("cannot make temporary file.");
+	return fp;
+}
+/*
+ * start_job: start a worker process.
+ *
+ *	r)		0: child process, >0: parent process
+ *
+ * Stdio buffers are flushed in advance so that nothing is written twice.
+ */
+static pid_t
+start_job(void)
+{
+	pid_t pid;
+
+	fflush(NULL);
+	if ((pid = fork()) < 0)
+		die("fork(2) failed.");
+	return pid;
+}
+/*
+ * wait_job: wait for a worker process to finish.
+ *
+ *	i)	pid	process id
+ */
+static void
+wait_job(pid_t pid)
+{
+	int status;
+
+	while (waitpid(pid, &status, 0) < 0)
+		if (errno != EINTR)
+			die("waitpid(2) failed.");
+	if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+		die("worker process failed.");
+}
+#endif
+/*
+ * convert_files: convert a part of the files into HTML.
  *
  *	i)	total	number of files.
+ *	i)	job	worker number (0 ... njobs - 1)
+ *	i)	njobs	number of workers
+ *	i)	result	the signatures of the pages are written to (--incremental)
+ *			NULL: put them directly
+ *
+ * The n-th path in GPATH is processed by the worker (n % njobs).
+ * Each worker has its own anchor table, and the lexers reset
+ * their state at the head of each file, so the result doesn't
+ * depend on the partition.
  */
 static void
-makehtml(int total)
+convert_files(int total, int job, int njobs, FILE *result)
 {
 	GFIND *gp;
-	FILE *anchor_stream;
+	IDSET *fids;
 	const char *path;
 	int count = 0;
 
 	/*
-	 * Create anchor stream for anchor_load().
+	 * Make anchor table of the files for anchor_load().
 	 */
-	anchor_stream = tmpfile();
-#if defined(_WIN32) && !defined(__CYGWIN__)
-	/*
-	 * tmpfile is created in the root, which user's can't write on Vista+.
-	 * Use _tempnam and open it directly.
-	 */
-	if (anchor_stream == NULL) {
-		char *name = _tempnam(tmpdir, "htags");
-		anchor_stream = fopen(name, "w+bD");
-		free(name);
-	}
-#endif
+	if (gpath_open(dbpath, 0) < 0)
+		die("GPATH not found.");
+	fids = idset_open(gpath_nextkey());
+	gpath_close();
 	gp = gfind_open(dbpath, NULL, other_files ? GPATH_BOTH : GPATH_SOURCE);
 	while ((path = gfind_read(gp)) != NULL) {
-		if (gp->type == GPATH_OTHER)
-			fputc(' ', anchor_stream);
-		fputs(path, anchor_stream);
-		fputc('\n', anchor_stream);
+		if (count++ % njobs != job)
+			continue;
+		if (gp->type == GPATH_SOURCE)
+			idset_add(fids, atoi(path2fid(path)));
 	}
 	gfind_close(gp);
-	/*
-	 * Prepare anchor stream for anchor_load().
-	 */
-	anchor_prepare(anchor_stream);
+	anchor_prepare(fids);
+	idset_close(fids);
 	/*
 	 * For each path in GPATH, convert the path into HTML file.
 	 */
+	count = 0;
 	gp = gfind_open(dbpath, NULL, other_files ? GPATH_BOTH : GPATH_SOURCE);
 	while ((path = gfind_read(gp)) != NULL) {
 		char html[MAXPATHLEN];
+		const char *fid, *signature;
 
 		if (gp->type == GPATH_OTHER && !other_files)
 			continue;
+		if (count++ % njobs != job)
+			continue;
 		/*
 		 * load tags belonging to the path.
 		 * The path must be start "./".
@@ -947,13 +1017,81 @@ makehtml(int total)
 		 * inform the current path name to lex() function.
 		 */
 		save_current_path(path);
-		count++;
 		path += 2;		/* remove './' at the head */
+		fid = path2fid(path);
+		snprintf(html, sizeof(html), "%s/%s/%s.%s", distpath, SRCS, fid, HTML);
+		if (incremental) {
+			signature = incremental_signature(path);
+			if (result)
+				fprintf(result, "%s %s\n", fid, signature);
+			else
+				incremental_put(fid, signature);
+			if (incremental_unchanged(fid, signature, html)) {
+				message(" [%d/%d] %s is up to date", count, total, path);
+				continue;
+			}
+		}
 		message(" [%d/%d] converting %s", count, total, path);
-		snprintf(html, sizeof(html), "%s/%s/%s.%s", distpath, SRCS, path2fid(path), HTML);
 		src2html(path, html, gp->type == GPATH_OTHER);
 	}
 	gfind_close(gp);
+	anchor_close();
+}
+/*
+ * makehtml: make html files
+ *
+ *	i)	total	number of files.
+ */
+static void
+makehtml(int total)
+{
+#if !defined(_WIN32) || defined(__CYGWIN__)
+	if (jobs > 1 && total > 1) {
+		int njobs = (jobs < total) ? jobs : total;
+		pid_t *pids = check_malloc(sizeof(pid_t) * njobs);
+		FILE **results = check_calloc(sizeof(FILE *), njobs);
+		int job;
+
+		for (job = 0; job < njobs; job++) {
+			if (incremental)
+				results[job] = open_tmpfile();
+			if ((pids[job] = start_job()) == 0) {
+				convert_files(total, job, njobs, results[job]);
+				if (results[job] && fflush(results[job]) != 0)
+					die("cannot write the signatures.");
+				exit(0);
+			}
+		}
+		for (job = 0; job < njobs; job++)
+			wait_job(pids[job]);
+		/*
+		 * Collect the signatures of the pages (--incremental).
+		 */
+		for (job = 0; job < njobs; job++) {
+			STRBUF *sb;
+			char *p;
+
+			if (results[job] == NULL)
+				continue;
+			sb = strbuf_open(0);
+			rewind(results[job]);
+			while ((p = strbuf_fgets(sb, results[job], STRBUF_NOCRLF)) != NULL) {
+				char *signature = locatestring(p, " ", MATCH_FIRST);
+
+				if (signature == NULL)
+					die("illegal signature record.");
+				*signature++ = '\0';
+				incremental_put(p, signature);
+			}
+			strbuf_close(sb);
+			fclose(results[job]);
+		}
+		free(results);
+		free(pids);
+		return;
+	}
+#endif
+	convert_files(total, 0, 1, NULL);
 }
 /*
  * Load file.
@@ -1261,6 +1399,12 @@ configuration(int argc, char *const *argv)
 		else
 			tabs = n;
 	}
+	if (getconfn("compress_level", &n)) {
+		if (n < 1 || n > 9)
+			warning("parameter 'compress_level' ignored because the value (=%d) is too large or too small.", n);
+		else
+			set_compress_level(n);
+	}
 	strbuf_reset(sb);
 	if (getconfs("gzipped_suffix", sb))
 		gzipped_suffix = check_strdup(strbuf_value(sb));
@@ -1419,6 +1563,7 @@ save_environment(int argc, char *const *argv)
 	STRBUF *sb = strbuf_open(0);
 	STRBUF *save_c = strbuf_open(0);
 	STRBUF *save_a = strbuf_open(0);
+	STRBUF *save_o = strbuf_open(0);
 	int i;
 	const char *p;
 	FILE *ip;
@@ -1453,6 +1598,7 @@ save_environment(int argc, char *const *argv)
 	 */
 	{
 		char *opt_gtagsconf = "--gtagsconf";
+		int skip_value = 0;
 
 		for (i = 1; i < argc; i++) {
 			char *blank;
@@ -1473,11 +1619,32 @@ save_environment(int argc, char *const *argv)
 			strbuf_puts(save_a, argv[i]);
 			if (blank)
 				strbuf_putc(save_a, '\'');
+			/*
+			 * The following options don't affect the hypertext.
+			 */
+			if (skip_value) {
+				skip_value = 0;
+				continue;
+			}
+			if (!strcmp(argv[i], "--jobs")) {
+				skip_value = 1;
+				continue;
+			}
+			if (!strcmp(argv[i], "--incremental")
+			    || !strcmp(argv[i], "--statistics")
+			    || !strcmp(argv[i], "--verbose") || !strcmp(argv[i], "-v")
+			    || !strcmp(argv[i], "-q")
+			    || locatestring(argv[i], "--jobs=", MATCH_AT_FIRST))
+				continue;
+			strbuf_putc(save_o, ' ');
+			strbuf_puts(save_o, argv[i]);
 		}
 	}
 	save_argv = strbuf_value(save_a);
+	save_options = strbuf_value(save_o);
 	/* doesn't close string buffer for save arguments. */
 	/* strbuf_close(save_a); */
+	/* strbuf_close(save_o); */
 }
 
 char **
@@ -1615,6 +1782,21 @@ main(int argc, char **argv)
 			else
 				die("--tabs option requires numeric value.");
                         break;
+		case OPT_JOBS:
+			if (atoi(optarg) > 0)
+				jobs = atoi(optarg);
+			else
+				die("--jobs option requires numeric value.");
+                        break;
+		case OPT_SERVER:
+			server_port = SERVER_PORT;
+			if (optarg) {
+				if (atoi(optarg) > 0)
+					server_port = atoi(optarg);
+				else
+					die("The option value of --server must be numeric.");
+			}
+			break;
 		case OPT_NCOL:
 			if (atoi(optarg) > 0)
 				ncol = atoi(optarg);
@@ -1778,6 +1960,14 @@ main(int argc, char **argv)
 	}
 	if (!cflag && !fflag && !dynamic)
 		Sflag = 0;
+	/*
+	 * The --dynamic option doesn't make tag lists.
+	 * The links in packed pages are relative to the local CGI directory.
+	 */
+	if (dynamic)
+		packed = 0;
+	if (packed && Sflag)
+		die("--pack option cannot be used with --system-cgi option.");
 	if (enable_xhtml)
 		setup_xhtml();
         if (show_version)
@@ -1966,6 +2156,11 @@ main(int argc, char **argv)
 	set_env("GTAGSROOT", cwdpath);
 	set_env("GTAGSDBPATH", dbpath);
 	set_env("GTAGSLIBPATH", "");
+	/*
+	 * Serve the hypertext instead of making it.
+	 */
+	if (server_port)
+		server_run(server_port);
 	/*------------------------------------------------------------------
 	 * MAKE FILES
 	 *------------------------------------------------------------------
@@ -1993,6 +2188,11 @@ main(int argc, char **argv)
 	sethandler(clean);
 
         HTML = (cflag) ? gzipped_suffix : normal_suffix;
+	/*
+	 * In the incremental mode, a page is replaced only when it is changed.
+	 */
+	if (incremental)
+		set_update_only(1);
 
 	message("[%s] Htags started", now());
 	init_statistics();
@@ -2034,22 +2234,27 @@ main(int argc, char **argv)
 	 * 'sitekey' file will be removed in near future, because it is not used.
 	 */
 	make_file_in_distpath("sitekey", sitekey);
-	if (!dynamic) {
+	if (!dynamic && !packed) {
 		make_directory_in_distpath(DEFS);
 		make_directory_in_distpath(REFS);
 		if (symbol)
 			make_directory_in_distpath(SYMS);
 	}
-	if (fflag || cflag || dynamic)
+	if (fflag || cflag || dynamic || packed)
 		make_directory_in_distpath("cgi-bin");
 	if (Iflag)
 		make_directory_in_distpath("icons");
 	if (auto_completion || tree_view)
 		 make_directory_in_distpath("js");
+	if (auto_completion) {
+		make_directory_in_distpath("suggest");
+		make_directory_in_distpath("suggest/D");
+		make_directory_in_distpath("suggest/Y");
+	}
 	/*
 	 * (1) make CGI program
 	 */
-	if (fflag || cflag || dynamic) {
+	if (fflag || cflag || dynamic || packed) {
 		char cgidir[MAXPATHLEN];
 		int perm;
 
@@ -2059,7 +2264,7 @@ main(int argc, char **argv)
 		 * If the Sflag is specified, CGI script is invalidated.
 		 */
 		perm = Sflag ? 0644 : 0755;
-		if (fflag || dynamic) {
+		if (fflag || dynamic || packed) {
 			makeprogram(cgidir, "global.cgi");
 			if (chmod(makepath(cgidir, "global.cgi", NULL), perm) < 0)
 				die("cannot chmod CGI program.");
@@ -2126,11 +2331,24 @@ main(int argc, char **argv)
 	 *     MAKING TAG CACHE
 	 */
 	message("[%s] (3) making tag lists ...", now());
+	if (incremental)
+		incremental_open();
+	else if (test("f", makepath(distpath, INCREMENTAL_STATE, NULL)))
+		(void)unlink(makepath(distpath, INCREMENTAL_STATE, NULL));
 	cache_open();
 	tim = statistics_time_start("Time of making tag lists");
 	func_total = makedupindex();
 	statistics_time_end(tim);
 	message("Total %d functions.", func_total);
+	/*
+	 * (#) suggest index (suggest/D/ and suggest/Y/)
+	 */
+	if (auto_completion) {
+		message("[%s] (#) making suggest index ...", now());
+		tim = statistics_time_start("Time of making suggest index");
+		message("Total %d names.", makesuggestindex());
+		statistics_time_end(tim);
+	}
 	/*
 	 * (4) search index. (search.html)
 	 */
@@ -2141,16 +2359,43 @@ main(int argc, char **argv)
 	{
 		STRBUF *defines = strbuf_open(0);
 		STRBUF *files = strbuf_open(0);
+#if !defined(_WIN32) || defined(__CYGWIN__)
+		FILE *defines_result = NULL;
+		pid_t defines_job = 0;
+#endif
 
 		/*
 		 * (5) make definition index (defines.html and defines/)
 		 *     PRODUCE @defines
 		 */
 		message("[%s] (5) making definition index ...", now());
-		tim = statistics_time_start("Time of making definition index");
-		func_total = makedefineindex("defines.html", func_total, defines);
-		statistics_time_end(tim);
-		message("Total %d functions.", func_total);
+#if !defined(_WIN32) || defined(__CYGWIN__)
+		/*
+		 * With --jobs, the definition index is made by a worker
+		 * process while the file index is made here. Both only read
+		 * the tag cache. The worker returns @defines, the total and
+		 * the number of pages through a temporary file.
+		 */
+		if (jobs > 1) {
+			defines_result = open_tmpfile();
+			if ((defines_job = start_job()) == 0) {
+				int before = html_count;
+
+				func_total = makedefineindex("defines.html", func_total, defines);
+				fprintf(defines_result, "%d %d\n", func_total, html_count - before);
+				fputs(strbuf_value(defines), defines_result);
+				if (fflush(defines_result) != 0)
+					die("cannot write temporary file.");
+				exit(0);
+			}
+		} else
+#endif
+		{
+			tim = statistics_time_start("Time of making definition index");
+			func_total = makedefineindex("defines.html", func_total, defines);
+			statistics_time_end(tim);
+			message("Total %d functions.", func_total);
+		}
 		/*
 		 * (6) make file index (files.html and files/)
 		 *     PRODUCE @files, %includes
@@ -2183,6 +2428,24 @@ main(int argc, char **argv)
 		tim = statistics_time_start("Time of making include file index");
 		makeincludeindex();
 		statistics_time_end(tim);
+#if !defined(_WIN32) || defined(__CYGWIN__)
+		if (defines_job > 0) {
+			char buf[BUFSIZ];
+			size_t n;
+			int pages;
+
+			wait_job(defines_job);
+			rewind(defines_result);
+			if (fgets(buf, sizeof(buf), defines_result) == NULL
+			    || sscanf(buf, "%d %d", &func_total, &pages) != 2)
+				die("cannot read the result of definition index.");
+			html_count += pages;
+			while ((n = fread(buf, 1, sizeof(buf), defines_result)) > 0)
+				strbuf_nputs(defines, buf, n);
+			fclose(defines_result);
+			message("Total %d functions.", func_total);
+		}
+#endif
 		/*
 		 * [#] make a common part for mains.html and index.html
 		 *     USING @defines @files
@@ -2209,7 +2472,17 @@ main(int argc, char **argv)
 	 */
 	message("[%s] (9) making hypertext from source code ...", now());
 	tim = statistics_time_start("Time of making hypertext");
+	if (incremental) {
+		STRBUF *sb = strbuf_open(0);
+
+		strbuf_puts_nl(sb, save_config);
+		strbuf_puts(sb, save_options);
+		incremental_config(strbuf_value(sb));
+		strbuf_close(sb);
+	}
 	makehtml(file_total);
+	if (incremental)
+		incremental_close();
 	statistics_time_end(tim);
 	/*
 	 * (10) rebuild script. (rebuild.sh)
@@ -63,6 +63,7 @@ extern int html_count;
 extern int sep;
 extern const char *save_config;
 extern const char *save_argv;
+extern const char *save_options;
 
 extern char cwdpath[MAXPATHLEN];
 extern char dbpath[MAXPATHLEN];
@@ -89,6 +90,8 @@ extern int qflag;
 extern int vflag;
 extern int wflag;
 extern int debug;
+extern int incremental;
+extern int packed;
 
 extern int show_help;
 extern int show_version;
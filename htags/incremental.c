@@ -0,0 +1,325 @@
+/*
+ * Copyright (c) 2010 Tama Communications Corporation
+ *
+ * This file is part of GNU GLOBAL.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+#include <stdio.h>
+#ifdef STDC_HEADERS
+#include <stdlib.h>
+#endif
+#ifdef HAVE_STRING_H
+#include <string.h>
+#else
+#include <strings.h>
+#endif
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+#include <sys/types.h>
+#include <sys/stat.h>
+#include "global.h"
+#include "anchor.h"
+#include "htags.h"
+#include "incop.h"
+#include "incremental.h"
+
+/*
+ * Incremental update of the hypertext (--incremental).
+ *
+ * The state of the previous run is saved in the state file
+ * 'HTML/STATE' which has the following records.
+ *
+ *	key				data
+ *	------------------------------------------------------------
+ *	" __.CONFIG"			hash value of the configuration
+ *	"N<db> <tag>"			page number of the tag list
+ *	"S<fid>"			signature of the source page
+ *
+ * (1) Page number of the tag list
+ * The tag list of a duplicate tag is written to 'D/<number>.html'.
+ * Usually the number is the sequence number of the tag, but it changes
+ * whenever a tag is added or removed, and every source page which
+ * refers to a following tag would be changed. So, in the incremental
+ * mode, a tag keeps the number of the previous run, and a new tag gets
+ * a number greater than any used number.
+ *
+ * (2) Signature of the source page
+ * The signature consists of the size and the modification time of the
+ * source file and the hash value of everything which is embedded in
+ * the page from the outside: the link targets of the anchors and the
+ * include file references. If the signature and the configuration are
+ * the same as the previous run, the page is not regenerated.
+ *
+ * The state file is removed at the start of the run, and is written at
+ * the end of the run. If htags fails on the way, the next run regenerates
+ * all pages.
+ */
+static const char *dirs[] = {NULL, DEFS, REFS, SYMS};
+
+static STRHASH *prev_numbers;		/* "<db> <tag>" => number (previous) */
+static STRHASH *numbers;		/* "<db> <tag>" => number (this run) */
+static STRHASH *prev_files;		/* fid => signature (previous) */
+static STRHASH *files;			/* fid => signature (this run) */
+static int last_number[GTAGLIM];	/* maximum number of each tag file */
+static int first_time;			/* 1: there is no state file */
+static int renew;			/* 1: all pages should be regenerated */
+static char config[32];			/* hash value of the configuration */
+static char prev_config[32];
+
+/*
+ * incremental_open: load the state of the previous run.
+ */
+void
+incremental_open(void)
+{
+	const char *path = makepath(distpath, INCREMENTAL_STATE, NULL);
+	DBOP *dbop;
+	const char *dat;
+
+	prev_numbers = strhash_open(1024);
+	numbers = strhash_open(1024);
+	prev_files = strhash_open(1024);
+	files = strhash_open(1024);
+	first_time = 1;
+	prev_config[0] = '\0';
+	if (test("f", path) && (dbop = dbop_open(path, 0, 0, 0)) != NULL) {
+		const char *p = dbop_getoption(dbop, " __.CONFIG");
+
+		if (p)
+			strlimcpy(prev_config, p, sizeof(prev_config));
+		for (dat = dbop_first(dbop, NULL, NULL, 0); dat; dat = dbop_next(dbop)) {
+			const char *key = dbop->lastkey;
+			struct sh_entry *entry;
+
+			if (*key == 'N') {
+				int db = atoi(key + 1);
+				int number = atoi(dat);
+
+				if (db < GTAGS || db >= GTAGLIM)
+					continue;
+				entry = strhash_assign(prev_numbers, key + 1, 1);
+				entry->value = strhash_strdup(prev_numbers, dat, 0);
+				if (number > last_number[db])
+					last_number[db] = number;
+			} else if (*key == 'S') {
+				entry = strhash_assign(prev_files, key + 1, 1);
+				entry->value = strhash_strdup(prev_files, dat, 0);
+			}
+		}
+		dbop_close(dbop);
+		first_time = 0;
+	}
+	/*
+	 * The state file is written again at the end of the run.
+	 */
+	if (test("f", path))
+		(void)unlink(path);
+}
+/*
+ * incremental_number: get the page number of the tag list.
+ *
+ *	i)	db	GTAGS, GRTAGS or GSYMS
+ *	i)	tag	tag name
+ *	i)	count	sequence number of the tag
+ *	r)		page number
+ */
+int
+incremental_number(int db, const char *tag, int count)
+{
+	STATIC_STRBUF(sb);
+	struct sh_entry *entry;
+
+	strbuf_clear(sb);
+	strbuf_putn(sb, db);
+	strbuf_putc(sb, ' ');
+	strbuf_puts(sb, tag);
+	entry = strhash_assign(numbers, strbuf_value(sb), 1);
+	if (entry->value == NULL) {
+		struct sh_entry *prev = strhash_assign(prev_numbers, strbuf_value(sb), 0);
+		int number;
+
+		if (prev != NULL)
+			number = atoi(prev->value);
+		else if (first_time)
+			number = count;
+		else
+			number = ++last_number[db];
+		strbuf_clear(sb);
+		strbuf_putn(sb, number);
+		entry->value = strhash_strdup(numbers, strbuf_value(sb), 0);
+	}
+	return atoi(entry->value);
+}
+/*
+ * incremental_config: set the configuration of this run.
+ *
+ *	i)	options	configuration and arguments
+ *
+ * The include file map is a part of the configuration, because
+ * every source page may refer to it.
+ * This function should be called after making the include file index.
+ */
+void
+incremental_config(const char *options)
+{
+	STRBUF *sb = strbuf_open(0);
+	struct data *inc;
+
+	strbuf_puts_nl(sb, VERSION);
+	strbuf_puts_nl(sb, options);
+	for (inc = first_inc(); inc; inc = next_inc()) {
+		strbuf_sprintf(sb, "%s %d %d\n", inc->name, inc->id, inc->count);
+		/* NULL means that it was written to the include file index. */
+		if (inc->contents)
+			strbuf_puts_nl(sb, strbuf_value(inc->contents));
+	}
+	snprintf(config, sizeof(config), "%08lx", strhash_value(strbuf_value(sb), strbuf_getlen(sb)));
+	strbuf_close(sb);
+	/*
+	 * If GRTAGS is empty then the source pages depend on the other pages.
+	 */
+	renew = (first_time || grtags_is_empty || strcmp(config, prev_config) != 0);
+	if (renew && !first_time)
+		message(" Configuration was changed. All pages are regenerated.");
+}
+/*
+ * incremental_signature: make the signature of the source page.
+ *
+ *	i)	path	path name (without './')
+ *	r)		signature
+ *
+ * This function should be called after anchor_load().
+ */
+const char *
+incremental_signature(const char *path)
+{
+	STATIC_STRBUF(sb);
+	static char signature[128];
+	const char *basename = locatestring(path, "/", MATCH_LAST);
+	struct data *incref;
+	struct stat st;
+
+	strbuf_clear(sb);
+	strbuf_puts_nl(sb, path);
+	anchor_links(sb);
+	basename = basename ? basename + 1 : path;
+	if ((incref = get_included(basename)) != NULL) {
+		strbuf_sprintf(sb, "%d %d\n", incref->id, incref->ref_count);
+		if (incref->ref_contents)
+			strbuf_puts_nl(sb, strbuf_value(incref->ref_contents));
+	}
+	if (stat(path, &st) < 0)
+		st.st_size = st.st_mtime = 0;
+	snprintf(signature, sizeof(signature), "%ld %ld %08lx",
+		(long)st.st_size, (long)st.st_mtime,
+		strhash_value(strbuf_value(sb), strbuf_getlen(sb)));
+	return signature;
+}
+/*
+ * incremental_unchanged: whether or not the source page is up to date.
+ *
+ *	i)	fid	file id
+ *	i)	signature	signature of the source page
+ *	i)	html	path of the source page
+ *	r)		1: up to date, 0: should be regenerated
+ */
+int
+incremental_unchanged(const char *fid, const char *signature, const char *html)
+{
+	struct sh_entry *entry;
+
+	if (renew)
+		return 0;
+	entry = strhash_assign(prev_files, fid, 0);
+	if (entry == NULL || strcmp(entry->value, signature) != 0)
+		return 0;
+	return test("f", html) ? 1 : 0;
+}
+/*
+ * incremental_put: put the signature of the source page.
+ *
+ *	i)	fid	file id
+ *	i)	signature	signature of the source page
+ */
+void
+incremental_put(const char *fid, const char *signature)
+{
+	struct sh_entry *entry = strhash_assign(files, fid, 1);
+
+	entry->value = strhash_strdup(files, signature, 0);
+}
+/*
+ * incremental_close: remove obsolete pages and save the state.
+ */
+void
+incremental_close(void)
+{
+	const char *path = makepath(distpath, INCREMENTAL_STATE, NULL);
+	STRBUF *sb = strbuf_open(0);
+	struct sh_entry *entry;
+	DBOP *dbop;
+
+	/*
+	 * Remove the tag lists which are no longer used.
+	 */
+	for (entry = strhash_first(prev_numbers); entry; entry = strhash_next(prev_numbers)) {
+		if (strhash_assign(numbers, entry->name, 0) == NULL && !dynamic) {
+			strbuf_reset(sb);
+			strbuf_sprintf(sb, "%s/%s/%s.%s", distpath, dirs[atoi(entry->name)], (char *)entry->value, HTML);
+			if (test("f", strbuf_value(sb)))
+				(void)unlink(strbuf_value(sb));
+		}
+	}
+	/*
+	 * Remove the source pages of the removed files.
+	 */
+	for (entry = strhash_first(prev_files); entry; entry = strhash_next(prev_files)) {
+		if (strhash_assign(files, entry->name, 0) == NULL) {
+			strbuf_reset(sb);
+			strbuf_sprintf(sb, "%s/%s/%s.%s", distpath, SRCS, entry->name, HTML);
+			if (test("f", strbuf_value(sb)))
+				(void)unlink(strbuf_value(sb));
+		}
+	}
+	/*
+	 * Save the state.
+	 */
+	dbop = dbop_open(path, 1, 0644, 0);
+	if (dbop == NULL)
+		die("cannot make file '%s'.", path);
+	dbop_putoption(dbop, " __.CONFIG", config);
+	for (entry = strhash_first(numbers); entry; entry = strhash_next(numbers)) {
+		strbuf_reset(sb);
+		strbuf_putc(sb, 'N');
+		strbuf_puts(sb, entry->name);
+		dbop_put(dbop, strbuf_value(sb), entry->value);
+	}
+	for (entry = strhash_first(files); entry; entry = strhash_next(files)) {
+		strbuf_reset(sb);
+		strbuf_putc(sb, 'S');
+		strbuf_puts(sb, entry->name);
+		dbop_put(dbop, strbuf_value(sb), entry->value);
+	}
+	dbop_close(dbop);
+	strbuf_close(sb);
+	strhash_close(prev_numbers);
+	strhash_close(numbers);
+	strhash_close(prev_files);
+	strhash_close(files);
+}
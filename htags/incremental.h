@@ -0,0 +1,35 @@
+/*
+ * Copyright (c) 2010 Tama Communications Corporation
+ *
+ * This file is part of GNU GLOBAL.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef _INCREMENTAL_H_
+#define _INCREMENTAL_H_
+
+/*
+ * State file of the incremental update (in the distribution directory).
+ */
+#define INCREMENTAL_STATE	"STATE"
+
+void incremental_open(void);
+int incremental_number(int, const char *, int);
+void incremental_config(const char *);
+const char *incremental_signature(const char *);
+int incremental_unchanged(const char *, const char *, const char *);
+void incremental_put(const char *, const char *);
+void incremental_close(void);
+
+#endif /* ! _INCREMENTAL_H_ */
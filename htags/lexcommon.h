@@ -62,8 +62,12 @@ static int newline_terminate_string = 0;
 static int dest_column;
 static int left_spaces;
 
+/*
+ * The source file is read from the line table, which src2html()
+ * loads into memory.
+ */
 #define YY_INPUT(buf, result, max_size) do {				\
-	result = read_file_detabing(buf, max_size, LEXIN,		\
+	result = linetable_read_detabing(buf, max_size,			\
 			&dest_column, &left_spaces);			\
 } while (0)
 
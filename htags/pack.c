@@ -0,0 +1,211 @@
+/*
+ * Copyright (c) 2010 Tama Communications Corporation
+ *
+ * This file is part of GNU GLOBAL.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+#include <stdio.h>
+#ifdef STDC_HEADERS
+#include <stdlib.h>
+#endif
+#ifdef HAVE_STRING_H
+#include <string.h>
+#else
+#include <strings.h>
+#endif
+#include "global.h"
+#include "htags.h"
+#include "pack.h"
+
+/*
+ * Packed storage of the tag lists (--pack).
+ *
+ * The tag lists of a directory (D/, R/ or Y/) are written into a pack file
+ * instead of a file per tag. The page 'D/<number>.html' is stored in
+ * 'HTML/D.pack' and located by the index file 'HTML/D.idx'.
+ *
+ * The index has a fixed length record for each page number, so the record
+ * of page <number> is at the offset <number> * PACK_RECLEN.
+ *
+ *	+--------------------------------+
+ *	|<offset(10)> <length(10)>'\n'   |	page 0 (not used)
+ *	|<offset(10)> <length(10)>'\n'   |	page 1
+ *	|...                             |
+ *	+--------------------------------+
+ *
+ * The length of a missing page is 0.
+ * Global.cgi (or htags --server) serves the page using the parameter
+ * 'page=D/<number>'.
+ * The links in the page are relative to 'HTML/cgi-bin/', so they are
+ * resolved as if the page were in 'HTML/D/'.
+ */
+struct page {
+	int number;
+	long offset;
+	long length;
+};
+
+/* compare routine for qsort(3) */
+static int
+cmp(const void *s1, const void *s2)
+{
+	return ((struct page *)s1)->number - ((struct page *)s2)->number;
+}
+/*
+ * pack_open: open pack file.
+ *
+ *	i)	dir	DEFS, REFS or SYMS
+ *	r)		PACK structure
+ */
+PACK *
+pack_open(const char *dir)
+{
+	PACK *pack = check_calloc(sizeof(PACK), 1);
+	char path[MAXPATHLEN];
+
+	strlimcpy(pack->dir, dir, sizeof(pack->dir));
+	strlimcpy(path, makepath(distpath, dir, "pack"), sizeof(path));
+	pack->fileop = open_output_file(path, 0);
+	pack->op = get_descripter(pack->fileop);
+	pack->pages = varray_open(sizeof(struct page), 1000);
+	return pack;
+}
+/*
+ * pack_begin: begin a page.
+ *
+ *	i)	pack	PACK structure
+ *	i)	number	page number
+ *	r)		file pointer to write the page
+ */
+FILE *
+pack_begin(PACK *pack, int number)
+{
+	pack->number = number;
+	pack->offset = ftell(pack->op);
+	if (pack->offset < 0)
+		die("cannot get the position of the pack file.");
+	return pack->op;
+}
+/*
+ * pack_end: end the page.
+ *
+ *	i)	pack	PACK structure
+ */
+void
+pack_end(PACK *pack)
+{
+	struct page *page = varray_append(pack->pages);
+
+	page->number = pack->number;
+	page->offset = pack->offset;
+	page->length = ftell(pack->op) - pack->offset;
+}
+/*
+ * pack_close: close pack file and write the index.
+ *
+ *	i)	pack	PACK structure
+ */
+void
+pack_close(PACK *pack)
+{
+	struct page *pages = varray_assign(pack->pages, 0, 0);
+	int count = pack->pages->length;
+	char path[MAXPATHLEN];
+	FILEOP *fileop;
+	FILE *op;
+	int i, number;
+
+	close_file(pack->fileop);
+	strlimcpy(path, makepath(distpath, pack->dir, "idx"), sizeof(path));
+	fileop = open_output_file(path, 0);
+	op = get_descripter(fileop);
+	if (count > 0)
+		qsort(pages, count, sizeof(struct page), cmp);
+	for (i = 0, number = 0; i < count; i++) {
+		for (; number < pages[i].number; number++)
+			fprintf(op, "%010ld %010ld\n", 0L, 0L);
+		fprintf(op, "%010ld %010ld\n", pages[i].offset, pages[i].length);
+		number++;
+	}
+	close_file(fileop);
+	varray_close(pack->pages);
+	free(pack);
+}
+/*
+ * pack_url: make the URL of a page in the pack file.
+ *
+ *	i)	dir	DEFS, REFS or SYMS
+ *	i)	number	page number
+ *	r)		URL (relative to the top of the hypertext)
+ */
+const char *
+pack_url(const char *dir, const char *number)
+{
+	STATIC_STRBUF(sb);
+
+	strbuf_clear(sb);
+	strbuf_sprintf(sb, "%s?page=%s/%s", action, dir, number);
+	return strbuf_value(sb);
+}
+/*
+ * pack_read: read a page from the pack file.
+ *
+ *	i)	dir	DEFS, REFS or SYMS
+ *	i)	number	page number
+ *	o)	sb	page
+ *	r)		0: normal, -1: page not found
+ */
+int
+pack_read(const char *dir, int number, STRBUF *sb)
+{
+	char path[MAXPATHLEN], record[PACK_RECLEN + 1];
+	long offset, length;
+	FILE *ip;
+	int status = -1;
+
+	strlimcpy(path, makepath(distpath, dir, "idx"), sizeof(path));
+	if ((ip = fopen(path, "rb")) == NULL)
+		return -1;
+	if (number > 0 && fseek(ip, (long)number * PACK_RECLEN, SEEK_SET) == 0
+	    && fread(record, 1, PACK_RECLEN, ip) == PACK_RECLEN) {
+		record[PACK_RECLEN] = '\0';
+		offset = atol(record);
+		length = atol(record + 11);
+	} else {
+		length = 0;
+	}
+	fclose(ip);
+	if (length <= 0)
+		return -1;
+	strlimcpy(path, makepath(distpath, dir, "pack"), sizeof(path));
+	if ((ip = fopen(path, "rb")) == NULL)
+		return -1;
+	if (fseek(ip, offset, SEEK_SET) == 0) {
+		char buf[8192];
+		size_t n;
+
+		while (length > 0 && (n = fread(buf, 1, length < (long)sizeof(buf) ? length : (long)sizeof(buf), ip)) > 0) {
+			strbuf_nputs(sb, buf, n);
+			length -= n;
+		}
+		if (length == 0)
+			status = 0;
+	}
+	fclose(ip);
+	return status;
+}
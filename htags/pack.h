@@ -0,0 +1,48 @@
+/*
+ * Copyright (c) 2010 Tama Communications Corporation
+ *
+ * This file is part of GNU GLOBAL.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef _PACK_H_
+#define _PACK_H_
+
+#include <stdio.h>
+#include "fileop.h"
+#include "strbuf.h"
+#include "varray.h"
+
+/*
+ * Length of an index record: "<offset> <length>\n"
+ */
+#define PACK_RECLEN	22
+
+typedef struct {
+	FILEOP *fileop;			/* <dir>.pack */
+	FILE *op;
+	char dir[32];			/* D, R or Y */
+	VARRAY *pages;			/* written pages */
+	int number;			/* number of the current page */
+	long offset;			/* offset of the current page */
+} PACK;
+
+PACK *pack_open(const char *);
+FILE *pack_begin(PACK *, int);
+void pack_end(PACK *);
+void pack_close(PACK *);
+const char *pack_url(const char *, const char *);
+int pack_read(const char *, int, STRBUF *);
+
+#endif /* ! _PACK_H_ */
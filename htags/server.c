@@ -0,0 +1,1088 @@
+/*
+ * Copyright (c) 2010 Tama Communications Corporation
+ *
+ * This file is part of GNU GLOBAL.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+#include <ctype.h>
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#ifdef STDC_HEADERS
+#include <stdlib.h>
+#endif
+#ifdef HAVE_STRING_H
+#include <string.h>
+#else
+#include <strings.h>
+#endif
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+#include <sys/types.h>
+#if !defined(_WIN32) || defined(__CYGWIN__)
+#include <sys/wait.h>
+#endif
+#if defined(HAVE_SYS_SOCKET_H) && defined(HAVE_NETINET_IN_H)
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#define USE_SERVER 1
+#endif
+
+#include "regex.h"
+#include "global.h"
+#include "common.h"
+#include "htags.h"
+#include "pack.h"
+#include "server.h"
+
+/*
+ * Built-in HTTP server (--server).
+ *
+ * It serves the hypertext made by the previous run, and answers the
+ * requests to 'cgi-bin/global.cgi' and 'cgi-bin/completion.cgi' by itself.
+ * A request doesn't cost a perl and a global(1) process as the CGI
+ * scripts do.
+ *
+ *	request				answer
+ *	-----------------------------------------------------------
+ *	.../global.cgi?pattern=...	search (same as global.cgi)
+ *	.../global.cgi?page=D/<n>	page in the pack file (--pack)
+ *	.../completion.cgi?q=...	completion (same as completion.cgi)
+ *	other				file in the HTML directory
+ *
+ * The output is the same as the CGI scripts generated from
+ * 'global.cgi.tmpl' and 'completion.cgi.tmpl'. Since they are made
+ * in 'HTML/cgi-bin/', relative links begin with '..'.
+ * Only the grep and idutils searches invoke global(1).
+ *
+ * Each connection is served by a child process, so that a slow client
+ * doesn't keep the others waiting. The child opens the tag files by itself:
+ * descriptors inherited from the parent would share the file offset with
+ * the other children, and would not see the updates by 'gtags -i' or
+ * 'global -u'.
+ */
+const char *get_image(const char *, const char *, int);
+void close_source(void);
+
+#define MAXREQUEST	65536		/* maximum size of a request header */
+#define TIMEOUT		30		/* seconds to wait for a client */
+
+static GTOP *gtop[GTAGLIM];		/* tag files */
+static STRHASH *form;			/* parameters of the request */
+static const char *basedir = "..";	/* top of the hypertext from cgi-bin */
+static const char *suffix;		/* suffix of the source pages */
+static const char *page_begin;
+static const char *page_end;
+
+/*
+ * decode: decode URL encoded string.
+ *
+ *	io)	s	string
+ */
+static void
+decode(char *s)
+{
+	char *p = s;
+
+	for (; *s; s++) {
+		if (*s == '+') {
+			*p++ = ' ';
+		} else if (*s == '%' && isxdigit((unsigned char)s[1]) && isxdigit((unsigned char)s[2])) {
+			char hex[3];
+
+			hex[0] = s[1];
+			hex[1] = s[2];
+			hex[2] = '\0';
+			*p++ = (char)strtol(hex, NULL, 16);
+			s += 2;
+		} else {
+			*p++ = *s;
+		}
+	}
+	*p = '\0';
+}
+/*
+ * parse_query: load the parameters of the request.
+ *
+ *	io)	query	query string (destroyed)
+ */
+static void
+parse_query(char *query)
+{
+	char *pair, *next;
+
+	if (form)
+		strhash_reset(form);
+	else
+		form = strhash_open(16);
+	for (pair = query; pair && *pair; pair = next) {
+		struct sh_entry *entry;
+		char *value;
+
+		if ((next = strchr(pair, '&')) != NULL)
+			*next++ = '\0';
+		if ((value = strchr(pair, '=')) != NULL)
+			*value++ = '\0';
+		else
+			value = "";
+		decode(pair);
+		decode(value);
+		entry = strhash_assign(form, pair, 1);
+		entry->value = strhash_strdup(form, value, 0);
+	}
+}
+/*
+ * param: get a parameter of the request.
+ *
+ *	i)	name	parameter name
+ *	r)		value ("" if not specified)
+ */
+static const char *
+param(const char *name)
+{
+	struct sh_entry *entry = strhash_assign(form, name, 0);
+
+	return entry ? (const char *)entry->value : "";
+}
+/*
+ * put_escaped: put string with escaping HTML special characters.
+ *
+ *	o)	sb	output
+ *	i)	s	string
+ */
+static void
+put_escaped(STRBUF *sb, const char *s)
+{
+	for (; *s; s++) {
+		if (*s == '&')
+			strbuf_puts(sb, "&amp;");
+		else if (*s == '<')
+			strbuf_puts(sb, "&lt;");
+		else if (*s == '>')
+			strbuf_puts(sb, "&gt;");
+		else
+			strbuf_putc(sb, *s);
+	}
+}
+/*
+ * The following functions make the same output as global.cgi.
+ */
+static void
+put_header(STRBUF *out)
+{
+	strbuf_puts(out, "Content-type: text/html\n\n");
+	strbuf_puts_nl(out, page_begin);
+	strbuf_puts_nl(out, body_begin);
+}
+static void
+put_tailer(STRBUF *out)
+{
+	strbuf_puts_nl(out, body_end);
+	strbuf_puts_nl(out, page_end);
+}
+static void
+error_page(STRBUF *out, const char *msg)
+{
+	strbuf_reset(out);
+	put_header(out);
+	strbuf_puts(out, error_begin);
+	strbuf_puts(out, "Error");
+	strbuf_puts_nl(out, error_end);
+	strbuf_puts(out, message_begin);
+	strbuf_sprintf(out, "%s<a href='%s/mains.%s'>[return]</a>", msg, basedir, normal_suffix);
+	strbuf_puts_nl(out, message_end);
+	put_tailer(out);
+}
+/*
+ * Arguments for put_compact().
+ */
+struct compact_record {
+	STRBUF *result;
+	const char *tag;
+	const char *path;
+	const char *fid;
+};
+/*
+ * put_line: put a line of ctags-xid format.
+ *
+ * fid tag lno filename image
+ * -------------------------------------------------
+ * 110 main             227 src/main.c       main()
+ */
+static void
+put_line(STRBUF *result, const char *fid, const char *tag, int lineno, const char *path, const char *image)
+{
+	/* skip './' because end-user doesn't see it. */
+	if (*path == '.' && *(path + 1) == '/')
+		path += 2;
+	strbuf_sprintf(result, "%s %-16s %4d %-16s %s\n", fid, tag, lineno, path, image);
+}
+/*
+ * put_compact: put an entry of compact format (callback of gtags_unfold()).
+ */
+static void
+put_compact(int lineno, void *arg)
+{
+	struct compact_record *rec = arg;
+
+	put_line(rec->result, rec->fid, rec->tag, lineno, rec->path,
+		get_image(rec->path, rec->fid, lineno));
+}
+/*
+ * tag_search: search the tag file.
+ *
+ *	i)	db	GTAGS, GRTAGS or GSYMS
+ *	i)	pattern	pattern
+ *	i)	icase	ignore case
+ *	o)	result	lines of ctags-xid format
+ *
+ * This is the same as 'global --result=ctags-xid -e pattern'.
+ */
+static void
+tag_search(int db, const char *pattern, int icase, STRBUF *result)
+{
+	STRBUF *sb = NULL;
+	GTP *gtp;
+	int flags = 0;
+
+	if (icase) {
+		if (!isregex(pattern)) {
+			sb = strbuf_open(0);
+			strbuf_putc(sb, '^');
+			strbuf_puts(sb, pattern);
+			strbuf_putc(sb, '$');
+			pattern = strbuf_value(sb);
+		}
+		flags |= GTOP_IGNORECASE;
+	}
+	gtop[db]->limit = 0;
+	for (gtp = gtags_first(gtop[db], pattern, flags); gtp; gtp = gtags_next(gtop[db])) {
+		char fid[MAXFIDLEN], tag[IDENTLEN];
+		const char *p = gtp->tagline;
+		int n;
+
+		/*
+		 * tagline = <file id> <tag name> <line no> <line image>	(standard)
+		 * tagline = <file id> <tag name> <line no>,...		(compact)
+		 */
+		for (n = 0; *p && *p != ' '; p++)
+			if (n < (int)sizeof(fid) - 1)
+				fid[n++] = *p;
+		fid[n] = '\0';
+		for (p++, n = 0; *p && *p != ' '; p++)
+			if (n < (int)sizeof(tag) - 1)
+				tag[n++] = *p;
+		tag[n] = '\0';
+		if (*p++ != ' ')
+			continue;
+		if (gtop[db]->format & GTAGS_COMPNAME)
+			strlimcpy(tag, uncompress(tag, gtp->tag), sizeof(tag));
+		if (gtop[db]->format & GTAGS_COMPACT) {
+			struct compact_record rec;
+
+			rec.result = result;
+			rec.tag = tag;
+			rec.path = gtp->path;
+			rec.fid = fid;
+			gtags_unfold(gtop[db], p, put_compact, &rec);
+		} else {
+			const char *image = locatestring(p, " ", MATCH_FIRST);
+
+			image = image ? image + 1 : "";
+			if (gtop[db]->format & GTAGS_COMPRESS)
+				image = uncompress(image, gtp->tag);
+			put_line(result, fid, tag, gtp->lineno, gtp->path, image);
+		}
+	}
+	/* The source file may be changed before the next request. */
+	close_source();
+	if (sb)
+		strbuf_close(sb);
+}
+/*
+ * path_search: search path names.
+ *
+ *	i)	pattern	pattern
+ *	i)	icase	ignore case
+ *	i)	other	other files are also searched
+ *	o)	result	lines of ctags-xid format
+ *
+ * This is the same as 'global --result=ctags-xid -P pattern'.
+ */
+static void
+path_search(const char *pattern, int icase, int other, STRBUF *result)
+{
+	GFIND *gp;
+	regex_t preg;
+	const char *path;
+	char edit[IDENTLEN];
+	int flags = REG_EXTENDED;
+
+	if (icase)
+		flags |= REG_ICASE;
+	/*
+	 * We assume '^aaa' as '^/aaa'.
+	 */
+	if (*pattern == '^' && *(pattern + 1) != '/') {
+		snprintf(edit, sizeof(edit), "^/%s", pattern + 1);
+		pattern = edit;
+	}
+	if (regcomp(&preg, pattern, flags) != 0)
+		return;
+	gp = gfind_open(dbpath, "./", other ? GPATH_BOTH : GPATH_SOURCE);
+	while ((path = gfind_read(gp)) != NULL) {
+		if (regexec(&preg, path + 1, 0, 0, 0) == 0)
+			put_line(result, gp->dbop->lastdat, "path", 1, path, " ");
+	}
+	gfind_close(gp);
+	regfree(&preg);
+}
+/*
+ * exec_global: execute global(1) and read the output.
+ *
+ *	i)	argv	arguments
+ *	o)	result	output
+ *	r)		0: normal, -1: cannot execute global(1)
+ */
+static int
+exec_global(char *const *argv, STRBUF *result)
+{
+#if !defined(_WIN32) || defined(__CYGWIN__)
+	char buf[8192];
+	int fd[2], n, status;
+	pid_t pid;
+
+	if (!test("x", global_path) || pipe(fd) < 0)
+		return -1;
+	if ((pid = fork()) < 0) {
+		close(fd[0]);
+		close(fd[1]);
+		return -1;
+	}
+	if (pid == 0) {
+		dup2(fd[1], 1);
+		close(fd[0]);
+		close(fd[1]);
+		execv(global_path, argv);
+		_exit(127);
+	}
+	close(fd[1]);
+	while ((n = read(fd[0], buf, sizeof(buf))) > 0)
+		strbuf_nputs(result, buf, n);
+	close(fd[0]);
+	while (waitpid(pid, &status, 0) < 0 && errno == EINTR)
+		;
+	return 0;
+#else
+	return -1;
+#endif
+}
+/*
+ * get_position: get the file id and the line number from a line.
+ *
+ *	i)	line	line of ctags-xid format
+ *	o)	fid	file id
+ *	o)	lno	line number
+ */
+static void
+get_position(const char *line, char *fid, char *lno)
+{
+	const char *p = line;
+	int n;
+
+	for (n = 0; *p && !isspace((unsigned char)*p); p++)
+		if (n < MAXFIDLEN - 1)
+			fid[n++] = *p;
+	fid[n] = '\0';
+	/* skip the tag name */
+	while (*p && isspace((unsigned char)*p))
+		p++;
+	while (*p && !isspace((unsigned char)*p))
+		p++;
+	while (*p && isspace((unsigned char)*p))
+		p++;
+	for (n = 0; isdigit((unsigned char)*p); p++)
+		if (n < 31)
+			lno[n++] = *p;
+	lno[n] = '\0';
+}
+/*
+ * do_search: answer the request to global.cgi.
+ *
+ *	o)	out	output of CGI format
+ */
+static void
+do_search(STRBUF *out)
+{
+	STRBUF *result = strbuf_open(0);
+	const char *pattern = param("pattern");
+	const char *type = param("type");
+	const char *words = "definitions";
+	const char *missed = NULL;
+	char fid[MAXFIDLEN], lno[32];
+	char *line, *next;
+	char flag = 0;
+	int icase = *param("icase") != '\0';
+	int other = *param("other") != '\0';
+	int count;
+
+	/*
+	 * Packed page (htags --pack).
+	 */
+	if (*param("page")) {
+		const char *page = param("page");
+		const char *p;
+
+		for (p = page + 2; isdigit((unsigned char)*p); p++)
+			;
+		if (!strchr("DRY", *page) || *(page + 1) != '/' || p == page + 2 || *p) {
+			error_page(out, "Illegal page.");
+		} else {
+			char dir[2];
+
+			dir[0] = *page;
+			dir[1] = '\0';
+			strbuf_puts(result, "Content-type: text/html\n\n");
+			if (pack_read(dir, atoi(page + 2), result) < 0)
+				error_page(out, "Page not found.");
+			else
+				strbuf_puts(out, strbuf_value(result));
+		}
+		strbuf_close(result);
+		return;
+	}
+	if (*pattern == '\0') {
+		error_page(out, "Pattern not specified.");
+		strbuf_close(result);
+		return;
+	}
+	if (!strcmp(type, "reference")) {
+		flag = 'r';
+		words = "references";
+	} else if (!strcmp(type, "symbol")) {
+		flag = 's';
+		words = "symbols";
+	} else if (!strcmp(type, "path")) {
+		flag = 'P';
+		words = "paths";
+	} else if (!strcmp(type, "grep")) {
+		flag = 'g';
+		words = "patterns";
+	} else if (!strcmp(type, "idutils")) {
+		flag = 'I';
+		words = "patterns";
+	}
+	/*
+	 * Sanity check
+	 * GTAGS and GPATH is indispensable file.
+	 */
+	if (!test("f", makepath(dbpath, "GTAGS", NULL)))
+		missed = "GTAGS";
+	else if (!test("f", makepath(dbpath, "GPATH", NULL)))
+		missed = "GPATH";
+	else if (flag == 'r' && !test("f", makepath(dbpath, "GRTAGS", NULL)))
+		missed = "GRTAGS";
+	else if (flag == 'I' && !test("f", makepath(dbpath, "ID", NULL)))
+		missed = "ID";
+	if (missed) {
+		STATIC_STRBUF(sb);
+
+		strbuf_clear(sb);
+		strbuf_sprintf(sb, "Tag file (%s) not found.", missed);
+		error_page(out, strbuf_value(sb));
+		strbuf_close(result);
+		return;
+	}
+	switch (flag) {
+	case 0:
+		tag_search(GTAGS, pattern, icase, result);
+		break;
+	case 'r':
+		tag_search(GRTAGS, pattern, icase, result);
+		break;
+	case 's':
+		tag_search(GSYMS, pattern, icase, result);
+		break;
+	case 'P':
+		path_search(pattern, icase, other, result);
+		break;
+	default:
+		{
+			char flags[8], *p = flags;
+			char *argv[6];
+
+			*p++ = '-';
+			*p++ = flag;
+			if (icase)
+				*p++ = 'i';
+			if (other && flag == 'g')
+				*p++ = 'o';
+			*p = '\0';
+			argv[0] = global_path;
+			argv[1] = "--result=ctags-xid";
+			argv[2] = flags;
+			argv[3] = "-e";
+			argv[4] = (char *)pattern;
+			argv[5] = NULL;
+			if (exec_global(argv, result) < 0) {
+				error_page(out, "Cannot execute global.");
+				strbuf_close(result);
+				return;
+			}
+		}
+		break;
+	}
+	line = strbuf_value(result);
+	if (*line == '\0') {
+		/* not found */
+		put_header(out);
+		strbuf_puts(out, title_begin);
+		put_escaped(out, pattern);
+		strbuf_puts_nl(out, title_end);
+		strbuf_puts(out, message_begin);
+		strbuf_sprintf(out, "Pattern not found. <a href='%s/mains.%s'>[return]</a>", basedir, normal_suffix);
+		strbuf_puts_nl(out, message_end);
+		put_tailer(out);
+		strbuf_close(result);
+		return;
+	}
+	/*
+	 * Input format:
+	 *
+	 * fid tag   lno filename
+	 * ---------------------------------------------
+	 * 100 main  32 ./main.c main(argc, argv)
+	 */
+	next = strchr(line, '\n');
+	if (next == NULL || *(next + 1) == '\0') {
+		/* direct jump */
+		get_position(line, fid, lno);
+		strbuf_sprintf(out, "Location: %s/%s/%s.%s#L%s\n\n", basedir, SRCS, fid, suffix, lno);
+		strbuf_close(result);
+		return;
+	}
+	put_header(out);
+	strbuf_puts(out, "<h1 class='title'>");
+	put_escaped(out, pattern);
+	strbuf_puts_nl(out, "</h1>");
+	strbuf_sprintf(out, "Following %s are matched to above pattern.%s\n", words, hr);
+	strbuf_puts_nl(out, verbatim_begin);
+	for (count = 0; *line; line = next) {
+		STATIC_STRBUF(sb);
+		const char *p;
+		char *q;
+
+		if ((next = strchr(line, '\n')) != NULL)
+			*next++ = '\0';
+		else
+			next = line + strlen(line);
+		count++;
+		get_position(line, fid, lno);
+		/*
+		 * Remove the file id, and make the tag name a link.
+		 */
+		for (p = line; isdigit((unsigned char)*p); p++)
+			;
+		while (*p == ' ' || *p == '\t')
+			p++;
+		strbuf_clear(sb);
+		put_escaped(sb, p);
+		for (q = strbuf_value(sb); *q && *q != ' ' && *q != '\t'; q++)
+			;
+		strbuf_puts(out, "<span class='curline'>");
+		strbuf_sprintf(out, "<a href='%s/%s/%s.%s#L%s'>", basedir, SRCS, fid, suffix, lno);
+		strbuf_nputs(out, strbuf_value(sb), q - strbuf_value(sb));
+		strbuf_puts(out, "</a>");
+		strbuf_puts(out, q);
+		strbuf_puts_nl(out, "</span>");
+	}
+	strbuf_puts_nl(out, verbatim_end);
+	strbuf_sprintf(out, "%s%d objects located.\n", hr, count);
+	put_tailer(out);
+	strbuf_close(result);
+}
+/*
+ * complete_tags: print completion list of tags.
+ *
+ *	i)	db	GTAGS or GSYMS
+ *	i)	prefix	prefix
+ *	i)	icase	ignore case
+ *	o)	result	tag names
+ *
+ * This is the same as 'global -c prefix'.
+ */
+static void
+complete_tags(int db, const char *prefix, int icase, STRBUF *result)
+{
+	int flags = GTOP_KEY | GTOP_NOREGEX | GTOP_PREFIX;
+	GTP *gtp;
+
+	gtop[db]->limit = 0;
+	if (isalpha((unsigned char)*prefix) && icase) {
+		/*
+		 * Connect two prefix reading as global(1) does.
+		 */
+		STRBUF *sb = strbuf_open(0);
+		regex_t	preg;
+		int i, firstchar[2];
+
+		strbuf_putc(sb, '^');
+		strbuf_puts(sb, prefix);
+		if (regcomp(&preg, strbuf_value(sb), REG_ICASE) != 0) {
+			strbuf_close(sb);
+			return;
+		}
+		firstchar[0] = firstchar[1] = *prefix;
+		if (isupper(firstchar[0]))
+			firstchar[1] = tolower(firstchar[0]);
+		else
+			firstchar[0] = toupper(firstchar[0]);
+		for (i = 0; i < 2; i++) {
+			strbuf_reset(sb);
+			strbuf_putc(sb, firstchar[i]);
+			for (gtp = gtags_first(gtop[db], strbuf_value(sb), flags); gtp; gtp = gtags_next(gtop[db]))
+				if (regexec(&preg, gtp->tag, 0, 0, 0) == 0)
+					strbuf_puts_nl(result, gtp->tag);
+		}
+		regfree(&preg);
+		strbuf_close(sb);
+	} else {
+		for (gtp = gtags_first(gtop[db], prefix, flags); gtp; gtp = gtags_next(gtop[db]))
+			strbuf_puts_nl(result, gtp->tag);
+	}
+}
+/*
+ * complete_path: print completion list of path names.
+ *
+ *	i)	prefix	prefix
+ *	i)	icase	ignore case
+ *	i)	other	other files are also completed
+ *	o)	result	path names
+ *
+ * This is the same as 'global -cP prefix'.
+ */
+static void
+complete_path(const char *prefix, int icase, int other, STRBUF *result)
+{
+	GFIND *gp;
+	DBOP *dbop;
+	const char *path;
+	int length = strlen(prefix);
+	int flags = MATCH_FIRST;
+
+	if (icase)
+		flags |= IGNORE_CASE;
+	dbop = dbop_open(NULL, 1, 0600, DBOP_RAW);
+	if (dbop == NULL)
+		return;
+	gp = gfind_open(dbpath, "./", other ? GPATH_BOTH : GPATH_SOURCE);
+	while ((path = gfind_read(gp)) != NULL) {
+		const char *p = path + 1;		/* skip '.' */
+
+		while ((p = locatestring(p, prefix, flags)) != NULL) {
+			dbop_put(dbop, p, "");
+			p += length;
+		}
+	}
+	gfind_close(gp);
+	for (path = dbop_first(dbop, NULL, NULL, DBOP_KEY); path != NULL; path = dbop_next(dbop))
+		strbuf_puts_nl(result, path);
+	dbop_close(dbop);
+}
+/*
+ * do_completion: answer the request to completion.cgi.
+ *
+ *	o)	out	output of CGI format
+ */
+static void
+do_completion(STRBUF *out)
+{
+	STRBUF *result = strbuf_open(0);
+	const char *q = param("q");
+	const char *type = param("type");
+	const char *line, *next;
+	int icase = *param("icase") != '\0';
+	int other = *param("other") != '\0';
+	int limit = atoi(param("limit"));
+	int limited = (limit > 0);
+
+	if (*q == '\0') {
+		warning("completion.cgi: request value is null.");
+		strbuf_puts(out, "Status: 500 Internal Server Error\n\n");
+		strbuf_close(result);
+		return;
+	}
+	if (!strcmp(type, "definition") || !strcmp(type, "reference")) {
+		complete_tags(GTAGS, q, icase, result);
+	} else if (!strcmp(type, "symbol")) {
+		complete_tags(GSYMS, q, icase, result);
+	} else if (!strcmp(type, "path")) {
+		complete_path(q, icase, other, result);
+	} else if (!strcmp(type, "idutils")) {
+		char flags[8], *p = flags;
+		char *argv[5];
+
+		*p++ = '-';
+		*p++ = 'c';
+		*p++ = 'I';
+		if (icase)
+			*p++ = 'i';
+		*p = '\0';
+		argv[0] = global_path;
+		argv[1] = flags;
+		argv[2] = "-e";
+		argv[3] = (char *)q;
+		argv[4] = NULL;
+		(void)exec_global(argv, result);
+	} else if (!strcmp(type, "grep")) {
+		;	/* Ignored because completion for grep is groundless. */
+	} else {
+		warning("completion.cgi: invalid type name.");
+		strbuf_puts(out, "Status: 500 Internal Server Error\n\n");
+		strbuf_close(result);
+		return;
+	}
+	strbuf_puts(out, "Content-Type: text/html\n\n");
+	for (line = strbuf_value(result); *line; line = next) {
+		if ((next = strchr(line, '\n')) != NULL)
+			next++;
+		else
+			next = line + strlen(line);
+		if (limited && limit-- <= 0)
+			break;
+		strbuf_nputs(out, line, next - line);
+	}
+	strbuf_close(result);
+}
+#ifdef USE_SERVER
+/*
+ * write_all: write data to the socket.
+ */
+static int
+write_all(int fd, const char *s, int len)
+{
+	while (len > 0) {
+		int n = write(fd, s, len);
+
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+		s += n;
+		len -= n;
+	}
+	return 0;
+}
+/*
+ * send_cgi: send the output of CGI format as a HTTP response.
+ *
+ *	i)	fd	socket
+ *	i)	out	output of CGI format (header lines, empty line and body)
+ *	i)	head	1: HEAD request
+ */
+static void
+send_cgi(int fd, STRBUF *out, int head)
+{
+	STRBUF *sb = strbuf_open(0);
+	STRBUF *header = strbuf_open(0);
+	const char *status = "200 OK";
+	char *p = strbuf_value(out);
+	const char *body;
+
+	/*
+	 * Header lines.
+	 */
+	while (*p && *p != '\n') {
+		char *nl = strchr(p, '\n');
+
+		if (nl == NULL)
+			nl = p + strlen(p);
+		else
+			*nl++ = '\0';
+		if (!strncmp(p, "Status: ", 8)) {
+			status = p + 8;
+		} else {
+			if (!strncmp(p, "Location: ", 10))
+				status = "302 Found";
+			strbuf_puts(header, p);
+			strbuf_puts(header, "\r\n");
+		}
+		p = nl;
+	}
+	body = (*p == '\n') ? p + 1 : p;
+	strbuf_sprintf(sb, "HTTP/1.0 %s\r\n", status);
+	strbuf_puts(sb, strbuf_value(header));
+	strbuf_sprintf(sb, "Content-Length: %d\r\n", (int)strlen(body));
+	strbuf_puts(sb, "Connection: close\r\n\r\n");
+	if (!head)
+		strbuf_puts(sb, body);
+	(void)write_all(fd, strbuf_value(sb), strbuf_getlen(sb));
+	strbuf_close(header);
+	strbuf_close(sb);
+}
+/*
+ * send_file: send a file in the HTML directory.
+ *
+ *	i)	fd	socket
+ *	i)	path	path name relative to the HTML directory
+ *	i)	head	1: HEAD request
+ */
+static void
+send_file(int fd, const char *path, int head)
+{
+	STATIC_STRBUF(sb);
+	const char *type = "application/octet-stream";
+	const char *encoding = NULL;
+	const char *ext;
+	char buf[8192];
+	FILE *ip;
+	long size;
+	int n;
+
+	strbuf_clear(sb);
+	strbuf_puts(sb, distpath);
+	strbuf_puts(sb, path);
+	if (test("d", strbuf_value(sb)))
+		strbuf_puts(sb, "/index.html");
+	/*
+	 * Don't go out of the HTML directory.
+	 */
+	if (locatestring(path, "/../", MATCH_FIRST) || locatestring(path, "/..", MATCH_AT_LAST)
+	    || !test("fr", strbuf_value(sb)) || (ip = fopen(strbuf_value(sb), "rb")) == NULL) {
+		static const char *msg = "HTTP/1.0 404 Not Found\r\nContent-Type: text/plain\r\n"
+			"Content-Length: 10\r\nConnection: close\r\n\r\nNot Found\n";
+		(void)write_all(fd, msg, strlen(msg));
+		return;
+	}
+	if ((ext = locatestring(strbuf_value(sb), ".", MATCH_LAST)) != NULL) {
+		ext++;
+		if (!strcmp(ext, normal_suffix) || !strcmp(ext, "html"))
+			type = "text/html";
+		else if (!strcmp(ext, gzipped_suffix)) {
+			type = "text/html";
+			encoding = "gzip";
+		} else if (!strcmp(ext, "css"))
+			type = "text/css";
+		else if (!strcmp(ext, "js"))
+			type = "application/javascript";
+		else if (!strcmp(ext, "png"))
+			type = "image/png";
+		else if (!strcmp(ext, "gif"))
+			type = "image/gif";
+		else if (!strcmp(ext, "jpg"))
+			type = "image/jpeg";
+		else if (!strcmp(ext, "txt"))
+			type = "text/plain";
+	}
+	fseek(ip, 0L, SEEK_END);
+	size = ftell(ip);
+	rewind(ip);
+	strbuf_clear(sb);
+	strbuf_puts(sb, "HTTP/1.0 200 OK\r\n");
+	strbuf_sprintf(sb, "Content-Type: %s\r\n", type);
+	if (encoding)
+		strbuf_sprintf(sb, "Content-Encoding: %s\r\n", encoding);
+	strbuf_sprintf(sb, "Content-Length: %d\r\n", (int)size);
+	strbuf_puts(sb, "Connection: close\r\n\r\n");
+	if (write_all(fd, strbuf_value(sb), strbuf_getlen(sb)) == 0 && !head) {
+		while ((n = fread(buf, 1, sizeof(buf), ip)) > 0)
+			if (write_all(fd, buf, n) < 0)
+				break;
+	}
+	fclose(ip);
+}
+/*
+ * open_tags: open the tag files. GSYMS is made from GRTAGS.
+ */
+static void
+open_tags(void)
+{
+	int db;
+
+	for (db = GTAGS; db < GTAGLIM; db++)
+		gtop[db] = gtags_open(dbpath, cwdpath, db, GTAGS_READ, 0);
+}
+/*
+ * close_tags: close the tag files.
+ */
+static void
+close_tags(void)
+{
+	int db;
+
+	for (db = GTAGS; db < GTAGLIM; db++) {
+		gtags_close(gtop[db]);
+		gtop[db] = NULL;
+	}
+}
+/*
+ * serve: answer a request.
+ *
+ *	i)	fd	socket
+ */
+static void
+serve(int fd)
+{
+	STRBUF *sb = strbuf_open(0);
+	char buf[8192], *method, *target, *query, *p;
+	const char *script;
+	int n, head;
+
+	/*
+	 * Read the request header.
+	 */
+	while (!locatestring(strbuf_value(sb), "\n\r\n", MATCH_FIRST)
+	    && !locatestring(strbuf_value(sb), "\n\n", MATCH_FIRST)) {
+		if (strbuf_getlen(sb) > MAXREQUEST)
+			goto end;
+		n = read(fd, buf, sizeof(buf));
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n < 0)			/* timed out */
+			goto end;
+		if (n == 0)
+			break;
+		strbuf_nputs(sb, buf, n);
+	}
+	/*
+	 * Request line: <method> <target> HTTP/1.x
+	 */
+	method = strbuf_value(sb);
+	if ((p = strchr(method, ' ')) == NULL)
+		goto end;
+	*p++ = '\0';
+	target = p;
+	for (; *p && *p != ' ' && *p != '\r' && *p != '\n'; p++)
+		;
+	*p = '\0';
+	if (!strcmp(method, "GET"))
+		head = 0;
+	else if (!strcmp(method, "HEAD"))
+		head = 1;
+	else {
+		static const char *msg = "HTTP/1.0 501 Not Implemented\r\nConnection: close\r\n\r\n";
+		(void)write_all(fd, msg, strlen(msg));
+		goto end;
+	}
+	if (vflag)
+		fprintf(stderr, " %s %s\n", method, target);
+	if ((query = strchr(target, '?')) != NULL)
+		*query++ = '\0';
+	decode(target);
+	if (*target != '/')
+		goto end;
+	script = locatestring(target, "/", MATCH_LAST) + 1;
+	if (!strcmp(script, "global.cgi") || !strcmp(script, "completion.cgi")) {
+		STRBUF *out = strbuf_open(0);
+
+		parse_query(query);
+		open_tags();
+		if (!strcmp(script, "global.cgi"))
+			do_search(out);
+		else
+			do_completion(out);
+		close_tags();
+		send_cgi(fd, out, head);
+		strbuf_close(out);
+	} else {
+		send_file(fd, target, head);
+	}
+end:
+	strbuf_close(sb);
+}
+#endif /* USE_SERVER */
+/*
+ * server_run: serve the hypertext.
+ *
+ *	i)	port	port number
+ *
+ * This function never returns.
+ */
+void
+server_run(int port)
+{
+#ifdef USE_SERVER
+	struct sockaddr_in addr;
+	int sock, on = 1;
+
+	if (!test("d", distpath) || !test("f", makepath(distpath, "index.html", NULL)))
+		die("hypertext not found in '%s'. Please execute htags without the --server option at first.", distpath);
+	suffix = test("s", makepath(distpath, "compress", NULL)) ? gzipped_suffix : normal_suffix;
+	/*
+	 * Pages are made in 'HTML/cgi-bin/' virtually.
+	 */
+	page_begin = check_strdup(gen_page_begin("Result", SUBDIR));
+	page_end = check_strdup(gen_page_end());
+	/*
+	 * Check that the tag files can be opened before serving.
+	 */
+	open_tags();
+	close_tags();
+	if ((sock = socket(AF_INET, SOCK_STREAM, 0)) < 0)
+		die("cannot make socket.");
+	(void)setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, (void *)&on, sizeof(on));
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	addr.sin_port = htons(port);
+	if (bind(sock, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+		die("cannot bind port %d (errno = %d).", port, errno);
+	if (listen(sock, 16) < 0)
+		die("cannot listen port %d.", port);
+	signal(SIGPIPE, SIG_IGN);
+	signal(SIGCHLD, SIG_IGN);		/* children are not waited */
+	if (!qflag)
+		fprintf(stderr, "Serving '%s' at http://localhost:%d/\n", distpath, port);
+	for (;;) {
+		struct timeval tv;
+		int fd = accept(sock, NULL, NULL);
+		pid_t pid;
+
+		if (fd < 0) {
+			if (errno == EINTR || errno == ECONNABORTED)
+				continue;
+			die("cannot accept connection (errno = %d).", errno);
+		}
+		/*
+		 * A client which sends or reads nothing is disconnected.
+		 */
+		tv.tv_sec = TIMEOUT;
+		tv.tv_usec = 0;
+		(void)setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, (void *)&tv, sizeof(tv));
+		(void)setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, (void *)&tv, sizeof(tv));
+		/*
+		 * If a child cannot be made, the request is served by this process.
+		 */
+		if ((pid = fork()) == 0) {
+			close(sock);
+			signal(SIGCHLD, SIG_DFL);
+			serve(fd);
+			close(fd);
+			_exit(0);
+		}
+		if (pid < 0)
+			serve(fd);
+		close(fd);
+	}
+#else
+	die("The --server option is not supported on this platform.");
+#endif
+}
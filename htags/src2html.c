@@ -33,6 +33,7 @@
 #include "cache.h"
 #include "common.h"
 #include "incop.h"
+#include "pack.h"
 #include "path2url.h"
 #include "htags.h"
 
@@ -448,6 +449,14 @@ put_anchor(char *name, int type, int lineno)
 					strbuf_puts(sb, "symbol");
 				file = strbuf_value(sb);
 				dir = (*action == '/') ? NULL : "..";
+			} else if (packed) {
+				if (type == 'R')
+					file = pack_url(DEFS, fid);
+				else if (type == 'Y')
+					file = pack_url(SYMS, fid);
+				else	/* 'D', 'M' or 'T' */
+					file = pack_url(REFS, fid);
+				dir = "..";
 			} else {
 				if (type == 'R')
 					dir = upperdir(DEFS);
@@ -954,7 +963,10 @@ src2html(const char *src, const char *html, int notsource)
 			ent = get_lang_entry(lang);
 			/*
 			 * Initialize parser.
+			 * The parser reads the source file from the line table.
 			 */
+			if (linetable_open(src) < 0)
+				die("cannot open file '%s'.", src);
 			ent->init_proc(in);
 			/*
 			 * Execute parser.
@@ -962,6 +974,7 @@ src2html(const char *src, const char *html, int notsource)
 			 */
 			while (ent->exec_proc())
 				;
+			linetable_close();
 		}
 		fputs_nl(verbatim_end, out);
 	}
@@ -0,0 +1,295 @@
+/*
+ * Copyright (c) 2010 Tama Communications Corporation
+ *
+ * This file is part of GNU GLOBAL.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+#include <sys/types.h>
+#include <stdio.h>
+#ifdef STDC_HEADERS
+#include <stdlib.h>
+#endif
+#ifdef HAVE_STRING_H
+#include <string.h>
+#else
+#include <strings.h>
+#endif
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+#ifdef HAVE_DIRENT_H
+#include <dirent.h>
+#endif
+#include "global.h"
+#include "common.h"
+#include "htags.h"
+
+/*
+ * Suggest index (--auto-completion).
+ *
+ * The completion of the input form is done in the browser using
+ * the following files instead of the completion CGI.
+ *
+ *	HTML/suggest/D/<key>.txt	tag names in GTAGS
+ *	HTML/suggest/Y/<key>.txt	tag names in GSYMS
+ *
+ * <key> is the first two characters of the name in lower case.
+ * The characters other than [a-z0-9] are encoded to '_' and two
+ * hexadecimal digits. Each file has the names which have the key,
+ * one name per line. So, the browser reads only a few KB for each
+ * input even if the project has a lot of tags.
+ *
+ * If a file becomes larger than SHARD_SIZE, its first line is ' split'
+ * and the names are moved to the files of one more character key
+ * ('abc.txt', 'abd.txt', ...), which are listed in the file as
+ * ' child <key>'. To show the candidates until more characters are
+ * typed, the split file keeps the first PREVIEW names in byte order
+ * for each case of the key ('ab', 'Ab', 'AB', ...). They include the
+ * names which are just the key. If the candidates are not limited to
+ * PREVIEW, the browser reads the child files.
+ *
+ * The names of one character are not written, since the completion
+ * starts from two characters.
+ */
+#define SHARD_SIZE	8192
+#define PREVIEW		100
+
+static const char *dirs[] = {NULL, "D", NULL, "Y"};
+
+static STRHASH *written;		/* files written in this run */
+
+/*
+ * lower: lower case character (only ASCII)
+ */
+static int
+lower(int c)
+{
+	c &= 0xff;
+	return (c >= 'A' && c <= 'Z') ? c - 'A' + 'a' : c;
+}
+/*
+ * put_key: put a character of the key.
+ *
+ *	o)	sb	key
+ *	i)	c	character
+ */
+static void
+put_key(STRBUF *sb, int c)
+{
+	c = lower(c);
+	if ((c >= 'a' && c <= 'z') || (c >= '0' && c <= '9'))
+		strbuf_putc(sb, c);
+	else
+		strbuf_sprintf(sb, "_%02x", c);
+}
+/*
+ * compare_name: compare function for sorting names.
+ *
+ * Names are sorted in lower case, so that all names of a key are adjacent.
+ */
+static int
+compare_name(const void *s1, const void *s2)
+{
+	const unsigned char *p = *(const unsigned char **)s1;
+	const unsigned char *q = *(const unsigned char **)s2;
+	int i;
+
+	for (i = 0; p[i] && lower(p[i]) == lower(q[i]); i++)
+		;
+	if (lower(p[i]) != lower(q[i]))
+		return lower(p[i]) - lower(q[i]);
+	return strcmp((const char *)p, (const char *)q);
+}
+/*
+ * compare_byte: compare function for sorting names in byte order.
+ */
+static int
+compare_byte(const void *s1, const void *s2)
+{
+	return strcmp(*(const char **)s1, *(const char **)s2);
+}
+/*
+ * write_shard: write a file of the suggest index.
+ *
+ *	i)	dir	directory
+ *	i)	key	key
+ *	i)	names	sorted names which have the key
+ *	i)	count	number of names
+ *	i)	depth	length of the key (not encoded)
+ */
+static void
+write_shard(const char *dir, const char *key, char **names, int count, int depth)
+{
+	char path[MAXPATHLEN];
+	STRBUF *sb;
+	FILEOP *fileop;
+	FILE *op;
+	int i, j, size = 0, split;
+
+	for (i = 0; i < count; i++)
+		size += strlen(names[i]) + 1;
+	split = (size > SHARD_SIZE);
+	strlimcpy(path, makepath(dir, key, "txt"), sizeof(path));
+	fileop = open_output_file(path, 0);
+	op = get_descripter(fileop);
+	if (split) {
+		STRHASH *cases = strhash_open(16);
+		struct sh_entry *entry;
+		char **sorted = check_malloc(sizeof(char *) * count);
+
+		fprintf(op, " split %d\n", PREVIEW);
+		/*
+		 * The first PREVIEW names of each case in byte order.
+		 */
+		memcpy(sorted, names, sizeof(char *) * count);
+		qsort(sorted, count, sizeof(char *), compare_byte);
+		sb = strbuf_open(0);
+		for (i = 0; i < count; i++) {
+			strbuf_reset(sb);
+			strbuf_nputs(sb, sorted[i], depth);
+			entry = strhash_assign(cases, strbuf_value(sb), 1);
+			if (entry->value == NULL) {
+				entry->value = pool_malloc(cases->pool, sizeof(int));
+				*(int *)entry->value = 0;
+			}
+			if ((*(int *)entry->value)++ < PREVIEW)
+				fputs_nl(sorted[i], op);
+		}
+		strbuf_close(sb);
+		strhash_close(cases);
+		free(sorted);
+	} else {
+		for (i = 0; i < count; i++)
+			fputs_nl(names[i], op);
+	}
+	strhash_assign(written, makepath(NULL, key, "txt"), 1);
+	if (!split) {
+		close_file(fileop);
+		return;
+	}
+	/*
+	 * The names which are just the key come first.
+	 * The rest are written to the child files, which are listed
+	 * in this file as ' child <key>'.
+	 */
+	for (i = 0; i < count && strlen(names[i]) == depth; i++)
+		;
+	sb = strbuf_open(0);
+	for (; i < count; i = j) {
+		int c = lower(names[i][depth]);
+
+		for (j = i + 1; j < count && lower(names[j][depth]) == c; j++)
+			;
+		strbuf_reset(sb);
+		strbuf_puts(sb, key);
+		put_key(sb, c);
+		fprintf(op, " child %s\n", strbuf_value(sb));
+		write_shard(dir, strbuf_value(sb), names + i, j - i, depth + 1);
+	}
+	strbuf_close(sb);
+	close_file(fileop);
+}
+/*
+ * remove_obsolete: remove the files which were not written in this run.
+ *
+ *	i)	dir	directory
+ */
+static void
+remove_obsolete(const char *dir)
+{
+	struct dirent *dp;
+	DIR *dirp;
+
+	if ((dirp = opendir(dir)) == NULL)
+		return;
+	while ((dp = readdir(dirp)) != NULL) {
+		const char *p = locatestring(dp->d_name, ".txt", MATCH_AT_LAST);
+
+		if (p && strhash_assign(written, dp->d_name, 0) == NULL)
+			(void)unlink(makepath(dir, dp->d_name, NULL));
+	}
+	closedir(dirp);
+}
+/*
+ * makesuggestindex: make suggest index.
+ *
+ *	r)		number of names
+ */
+int
+makesuggestindex(void)
+{
+	int total = 0;
+	int db;
+
+	written = strhash_open(1024);
+	for (db = GTAGS; db < GTAGLIM; db++) {
+		char dir[MAXPATHLEN];
+		VARRAY *vb;
+		POOL *pool;
+		GTOP *gtop;
+		GTP *gtp;
+		STRBUF *sb;
+		char **names;
+		int count, i, j;
+
+		if (dirs[db] == NULL || gtags_exist[db] == 0)
+			continue;
+		strlimcpy(dir, makepath(distpath, "suggest", NULL), sizeof(dir));
+		strlimcpy(dir, makepath(dir, dirs[db], NULL), sizeof(dir));
+		vb = varray_open(sizeof(char *), 1000);
+		pool = pool_open();
+		gtop = gtags_open(dbpath, cwdpath, db, GTAGS_READ, 0);
+		for (gtp = gtags_first(gtop, NULL, GTOP_KEY); gtp; gtp = gtags_next(gtop)) {
+			if (gtp->tag[0] == '\0' || gtp->tag[1] == '\0')
+				continue;
+			names = varray_append(vb);
+			*names = pool_strdup(pool, gtp->tag, 0);
+		}
+		gtags_close(gtop);
+		count = vb->length;
+		names = varray_assign(vb, 0, 0);
+		if (count > 0)
+			qsort(names, count, sizeof(char *), compare_name);
+		/*
+		 * Remove duplicate names.
+		 */
+		for (i = j = 0; i < count; i++)
+			if (j == 0 || strcmp(names[j - 1], names[i]))
+				names[j++] = names[i];
+		count = j;
+		strhash_reset(written);
+		sb = strbuf_open(0);
+		for (i = 0; i < count; i = j) {
+			int c0 = lower(names[i][0]), c1 = lower(names[i][1]);
+
+			for (j = i + 1; j < count && lower(names[j][0]) == c0 && lower(names[j][1]) == c1; j++)
+				;
+			strbuf_reset(sb);
+			put_key(sb, c0);
+			put_key(sb, c1);
+			write_shard(dir, strbuf_value(sb), names + i, j - i, 2);
+		}
+		strbuf_close(sb);
+		remove_obsolete(dir);
+		total += count;
+		pool_close(pool);
+		varray_close(vb);
+	}
+	strhash_close(written);
+	return total;
+}
@@ -10,7 +10,8 @@
  *
  *	jquery.suggest 1.1+ - 2010-07-08
  *
- *	A little code for extraParams was added by Tama Communications Corporation.
+ *	A little code for extraParams and the function source was added by
+ *	Tama Communications Corporation.
  *	Since it was put on the public domain, you can use and distribute this file
  *	according to the original license.
  */
@@ -135,7 +136,7 @@
 					
 				} else {
 				
-					$.get(options.source, params, function(txt) {
+					var receive = function(txt) {
 
 						$results.hide();
 						
@@ -144,7 +145,13 @@
 						displayItems(items);
 						addToCache(cachekey, items, txt.length);
 						
-					});
+					};
+
+					// source may be a function which calls back with the text
+					if (jQuery.isFunction(options.source))
+						options.source(params, receive);
+					else
+						$.get(options.source, params, receive);
 					
 				}
 				
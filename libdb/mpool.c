@@ -64,6 +64,8 @@ static BKT *mpool_bkt(MPOOL *);
 static BKT *mpool_look(MPOOL *, pgno_t);
 static int  mpool_write(MPOOL *, BKT *);
 
+MPOOL_COUNTER mpool_counter;
+
 /*
  * mpool_open --
  *	Initialize a memory pool.
@@ -176,6 +178,7 @@ mpool_get(mp, pgno, flags)
 		return (NULL);
 	}
 
+	++mp->counter.pageget;
 #ifdef STATISTICS
 	++mp->pageget;
 #endif
@@ -209,6 +212,7 @@ mpool_get(mp, pgno, flags)
 		return (NULL);
 
 	/* Read in the contents. */
+	++mp->counter.pageread;
 #ifdef STATISTICS
 	++mp->pageread;
 #endif
@@ -292,6 +296,13 @@ mpool_close(mp)
 		free(bp);
 	}
 
+	/* Add the page counters to the total. */
+	mpool_counter.pageget += mp->counter.pageget;
+	mpool_counter.cachehit += mp->counter.cachehit;
+	mpool_counter.cachemiss += mp->counter.cachemiss;
+	mpool_counter.pageread += mp->counter.pageread;
+	mpool_counter.pagewrite += mp->counter.pagewrite;
+
 	/* Free the MPOOL cookie. */
 	free(mp);
 	return (RET_SUCCESS);
@@ -387,6 +398,7 @@ mpool_write(mp, bp)
 {
 	off_t off;
 
+	++mp->counter.pagewrite;
 #ifdef STATISTICS
 	++mp->pagewrite;
 #endif
@@ -425,11 +437,13 @@ mpool_look(mp, pgno)
 	head = &mp->hqh[HASHKEY(pgno)];
 	for (bp = head->cqh_first; bp != (void *)head; bp = bp->hq.cqe_next)
 		if (bp->pgno == pgno) {
+			++mp->counter.cachehit;
 #ifdef STATISTICS
 			++mp->cachehit;
 #endif
 			return (bp);
 		}
+	++mp->counter.cachemiss;
 #ifdef STATISTICS
 	++mp->cachemiss;
 #endif
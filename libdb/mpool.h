@@ -53,6 +53,22 @@ typedef struct _bkt {
 	u_int8_t flags;			/* flags */
 } BKT;
 
+/*
+ * Page counters.
+ * Unlike the STATISTICS counters, these are always maintained so that
+ * applications can report page cache behaviour at run time.
+ * Each MPOOL counts its own pages, so that pools used by different
+ * threads don't share a counter. They are added to mpool_counter
+ * when the pool is closed.
+ */
+typedef struct {
+	u_long	pageget;		/* mpool_get() calls */
+	u_long	cachehit;		/* pages found in the cache */
+	u_long	cachemiss;		/* pages not found in the cache */
+	u_long	pageread;		/* pages read from the file */
+	u_long	pagewrite;		/* pages written to the file */
+} MPOOL_COUNTER;
+
 typedef struct MPOOL {
 	CIRCLEQ_HEAD(_lqh, _bkt) lqh;	/* lru queue head */
 					/* hash queue array */
@@ -67,6 +83,7 @@ typedef struct MPOOL {
 					/* page out conversion routine */
 	void    (*pgout)(void *, pgno_t, void *);
 	void	*pgcookie;		/* cookie for page in/out routines */
+	MPOOL_COUNTER counter;		/* page counters of this pool */
 #ifdef STATISTICS
 	u_long	cachehit;
 	u_long	cachemiss;
@@ -80,6 +97,9 @@ typedef struct MPOOL {
 #endif
 } MPOOL;
 
+
+extern MPOOL_COUNTER mpool_counter;	/* sum of the closed pools */
+
 MPOOL	*mpool_open(void *, int, pgno_t, pgno_t);
 void	 mpool_filter(MPOOL *, void (*)(void *, pgno_t, void *),
 	    void (*)(void *, pgno_t, void *), void *);
@@ -47,8 +47,12 @@
 #include "env.h"
 #include "locatestring.h"
 #include "strbuf.h"
+#include "statistics.h"
 #include "strlimcpy.h"
 #include "test.h"
+#ifndef USE_DB185_COMPAT
+#include "mpool.h"
+#endif
 
 /*
  * Though the prefix of the key of meta record is currently only a ' ',
@@ -56,6 +60,14 @@
  */
 #define ismeta(p)	(*((char *)(p)) <= ' ')
 
+/*
+ * Access counters reported by dbop_statistics().
+ * Each DBOP counts its own access and the counters are added here
+ * when it is closed, since DBOPs may be used by different threads.
+ */
+static unsigned long count_lookup;	/* dbop_get() and indexed dbop_first() */
+static unsigned long count_record;	/* records returned by dbop_first/next */
+
 /*
  * Stuff for DBOP_SORTED_WRITE
  */
@@ -332,6 +344,7 @@ dbop_get(DBOP *dbop, const char *name)
 	key.data = (char *)name;
 	key.size = strlen(name)+1;
 
+	dbop->count_lookup++;
 	status = (*db->get)(db, &key, &dat, 0);
 	dbop->lastdat = (char *)dat.data;
 	dbop->lastsize = dat.size;
@@ -492,6 +505,7 @@ dbop_first(DBOP *dbop, const char *name, regex_t *preg, int flags)
 		if (!(flags & DBOP_PREFIX))
 			key.size++;
 		dbop->keylen = key.size;
+		dbop->count_lookup++;
 		for (status = (*db->seq)(db, &key, &dat, R_CURSOR);
 			status == RET_SUCCESS;
 			status = (*db->seq)(db, &key, &dat, R_NEXT)) {
@@ -532,6 +546,7 @@ dbop_first(DBOP *dbop, const char *name, regex_t *preg, int flags)
 		return (NULL);
 	}
 	dbop->ioflags = flags;
+	dbop->count_record++;
 	if (flags & DBOP_KEY) {
 		strlimcpy(dbop->prev, (char *)key.data, sizeof(dbop->prev));
 		return (char *)key.data;
@@ -587,6 +602,7 @@ dbop_next(DBOP *dbop)
 		}
 		if (dbop->preg && regexec(dbop->preg, (char *)key.data, 0, 0, 0) != 0)
 			continue;
+		dbop->count_record++;
 		return (flags & DBOP_KEY) ? (char *)key.data : (char *)dat.data;
 	}
 	if (status == RET_ERROR)
@@ -748,5 +764,26 @@ dbop_close(DBOP *dbop)
 		if (dbop->perm && chmod(dbop->dbname, dbop->perm) < 0)
 			die("chmod(2) failed.");
 	}
+	count_lookup += dbop->count_lookup;
+	count_record += dbop->count_record;
 	(void)free(dbop);
 }
+/*
+ * dbop_statistics: report access counters of the closed tag files.
+ *
+ * The counters are passed to statistics_count(); nothing is printed
+ * unless init_statistics() was called.
+ */
+void
+dbop_statistics(void)
+{
+	statistics_count("Tag file lookups", count_lookup);
+	statistics_count("Tag file records read", count_record);
+#ifndef USE_DB185_COMPAT
+	statistics_count("B-tree page requests", mpool_counter.pageget);
+	statistics_count("B-tree page cache hits", mpool_counter.cachehit);
+	statistics_count("B-tree page cache misses", mpool_counter.cachemiss);
+	statistics_count("B-tree pages read", mpool_counter.pageread);
+	statistics_count("B-tree pages written", mpool_counter.pagewrite);
+#endif
+}
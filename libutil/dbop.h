@@ -51,6 +51,8 @@ typedef	struct {
 	regex_t	*preg;			/* compiled regular expression */
 	int unread;			/* leave record to read again */
 	const char *put_errmsg;		/* error message for put_xxx() */
+	unsigned long count_lookup;	/* number of lookups */
+	unsigned long count_record;	/* number of records read */
 	/*
 	 * (2) DB185 PART
 	 */
@@ -100,5 +102,6 @@ void dbop_putoption(DBOP *, const char *, const char *);
 int dbop_getversion(DBOP *);
 void dbop_putversion(DBOP *, int);
 void dbop_close(DBOP *);
+void dbop_statistics(void);
 
 #endif /* _DBOP_H_ */
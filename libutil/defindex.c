@@ -0,0 +1,201 @@
+/*
+ * Copyright (c) 2012 Tama Communications Corporation
+ *
+ * This file is part of GNU GLOBAL.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+#ifdef STDC_HEADERS
+#include <stdlib.h>
+#endif
+#ifdef HAVE_STRING_H
+#include <string.h>
+#else
+#include <strings.h>
+#endif
+
+#include "defindex.h"
+#include "gpathop.h"
+#include "strbuf.h"
+#include "strhash.h"
+#include "varray.h"
+
+/*
+ * Definition index: positions of definitions in a source file.
+ *
+ * To decide the type of a tag at a position (global --from-here),
+ * global(1) has to know whether the tag is defined at the position.
+ * Without the definition index, it reads all definition records of
+ * the tag in GTAGS. It takes long time for a popular name like 'init'.
+ * With the definition index, it reads one record of the file and
+ * looks up the line by binary search.
+ *
+ * The definition index is made by gtags(1) and is stored in GPATH
+ * with the file id of the source file. (See gpathop.c)
+ *
+ *	<count>\0<entry 1><entry 2>...<entry count><name 1>\0<name 2>\0...
+ *
+ * Each entry is a pair of a line number and the offset of a tag name
+ * from the start of the names, both are 4 bytes integer in network byte
+ * order. Entries are sorted by line number. Each tag name appears
+ * only once in the names.
+ */
+struct def_entry {
+	int lineno;
+	int name;			/* offset in the names */
+};
+static VARRAY *entries;
+static STRHASH *names;
+static STRBUF *namebuf;
+
+static int compare_entry(const void *, const void *);
+static void put_int(STRBUF *, int);
+static int get_int(const unsigned char *);
+
+/*
+ * defindex_add: add a definition of the current file.
+ *
+ *	i)	tag	tag name (key of GTAGS)
+ *	i)	lineno	line number
+ */
+void
+defindex_add(const char *tag, int lineno)
+{
+	struct sh_entry *sh;
+	struct def_entry *entry;
+
+	if (entries == NULL) {
+		entries = varray_open(sizeof(struct def_entry), 100);
+		names = strhash_open(256);
+		namebuf = strbuf_open(0);
+	}
+	sh = strhash_assign(names, tag, 1);
+	if (sh->value == NULL) {
+		sh->value = (void *)((long)strbuf_getlen(namebuf) + 1);
+		strbuf_puts0(namebuf, tag);
+	}
+	entry = varray_append(entries);
+	entry->lineno = lineno;
+	entry->name = (int)((long)sh->value - 1);
+}
+/*
+ * defindex_put: put the definition index of the current file to GPATH.
+ *
+ *	i)	fid	file id of the current file
+ *
+ * GPATH should be opened with writing mode.
+ * The index is written even if the file has no definition, so that
+ * global(1) can trust it. Definitions added so far are cleared.
+ */
+void
+defindex_put(const char *fid)
+{
+	STATIC_STRBUF(sb);
+	struct def_entry *entry;
+	int i, count = entries ? entries->length : 0;
+
+	strbuf_clear(sb);
+	strbuf_putn(sb, count);
+	strbuf_putc(sb, '\0');
+	if (count > 0) {
+		entry = varray_assign(entries, 0, 0);
+		qsort(entry, count, sizeof(struct def_entry), compare_entry);
+		for (i = 0; i < count; i++) {
+			put_int(sb, entry[i].lineno);
+			put_int(sb, entry[i].name);
+		}
+		strbuf_nputs(sb, strbuf_value(namebuf), strbuf_getlen(namebuf));
+		varray_reset(entries);
+		strhash_reset(names);
+		strbuf_reset(namebuf);
+	}
+	gpath_putdefs(fid, strbuf_value(sb), strbuf_getlen(sb));
+}
+/*
+ * defindex_lookup: examine whether a tag is defined at a line.
+ *
+ *	i)	fid	file id
+ *	i)	tag	tag name
+ *	i)	lineno	line number
+ *	r)		1: defined, 0: not defined
+ *			-1: the definition index is not available
+ *
+ * GPATH should be opened.
+ */
+int
+defindex_lookup(const char *fid, const char *tag, int lineno)
+{
+	const unsigned char *table, *pool;
+	const char *dat;
+	int size, count, lo, hi, mid;
+
+	if ((dat = gpath_getdefs(fid, &size)) == NULL)
+		return -1;
+	count = atoi(dat);
+	table = (const unsigned char *)dat + strlen(dat) + 1;
+	pool = table + count * 8;
+	if (count < 0 || pool > (const unsigned char *)dat + size)
+		return -1;
+	/*
+	 * Find the first entry of the line.
+	 */
+	lo = 0;
+	hi = count;
+	while (lo < hi) {
+		mid = (lo + hi) / 2;
+		if (get_int(table + mid * 8) < lineno)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	for (; lo < count && get_int(table + lo * 8) == lineno; lo++)
+		if (!strcmp((const char *)pool + get_int(table + lo * 8 + 4), tag))
+			return 1;
+	return 0;
+}
+/*
+ * compare_entry: compare entries by line number.
+ */
+static int
+compare_entry(const void *v1, const void *v2)
+{
+	const struct def_entry *e1 = v1, *e2 = v2;
+
+	if (e1->lineno != e2->lineno)
+		return e1->lineno - e2->lineno;
+	return e1->name - e2->name;
+}
+/*
+ * put_int: put 4 bytes integer in network byte order.
+ */
+static void
+put_int(STRBUF *sb, int n)
+{
+	strbuf_putc(sb, (n >> 24) & 0xff);
+	strbuf_putc(sb, (n >> 16) & 0xff);
+	strbuf_putc(sb, (n >> 8) & 0xff);
+	strbuf_putc(sb, n & 0xff);
+}
+/*
+ * get_int: get 4 bytes integer in network byte order.
+ */
+static int
+get_int(const unsigned char *p)
+{
+	return (p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+}
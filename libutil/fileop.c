@@ -25,6 +25,17 @@
 #ifdef STDC_HEADERS
 #include <stdlib.h>
 #endif
+#ifdef HAVE_STRING_H
+#include <string.h>
+#else
+#include <strings.h>
+#endif
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+#ifdef HAVE_LIBZ
+#include <zlib.h>
+#endif
 
 #include "checkalloc.h"
 #include "die.h"
@@ -54,6 +65,98 @@ File operation: usage
 	...
 	close_file(fileop);
 */
+static int update_only;		/* 1: don't rewrite unchanged files */
+static int compress_level = 6;	/* compression level (1-9) */
+
+/*
+ * set_update_only: rewrite output files only when they are changed.
+ *
+ *	i)	onoff	1: on, 0: off
+ *
+ * While it is on, open_output_file() writes into a temporary file,
+ * and close_file() replaces the file with it only when they differ.
+ * So, unchanged files keep their time stamps.
+ */
+void
+set_update_only(int onoff)
+{
+	update_only = onoff;
+}
+/*
+ * set_compress_level: set the compression level of compressed files.
+ *
+ *	i)	level	1 (fastest) - 9 (best)
+ */
+void
+set_compress_level(int level)
+{
+	compress_level = level;
+}
+#ifdef HAVE_LIBZ
+/*
+ * compress_to: compress the contents of a stream into a file.
+ *
+ *	i)	ip	stream
+ *	i)	path	path name of the compressed file
+ *
+ * The file is in the gzip format, same as that of 'gzip -c'.
+ */
+static void
+compress_to(FILE *ip, const char *path)
+{
+	char buf[BUFSIZ];
+	char mode[8];
+	size_t n;
+	gzFile gz;
+
+	snprintf(mode, sizeof(mode), "wb%d", compress_level);
+	if ((gz = gzopen(path, mode)) == NULL)
+		die("cannot create file '%s'.", path);
+	rewind(ip);
+	while ((n = fread(buf, 1, sizeof(buf), ip)) > 0)
+		if (gzwrite(gz, buf, n) != (int)n)
+			die("cannot write to file '%s'.", path);
+	if (ferror(ip))
+		die("cannot read temporary file.");
+	if (gzclose(gz) != Z_OK)
+		die("cannot write to file '%s'.", path);
+}
+#endif
+/*
+ * same_file: compare the contents of two files.
+ *
+ *	i)	path1	path name
+ *	i)	path2	path name
+ *	r)		1: same, 0: different or not readable
+ */
+static int
+same_file(const char *path1, const char *path2)
+{
+	char buf1[BUFSIZ], buf2[BUFSIZ];
+	FILE *fp1, *fp2;
+	size_t n1, n2;
+	int same = 0;
+
+	if ((fp1 = fopen(path1, "rb")) == NULL)
+		return 0;
+	if ((fp2 = fopen(path2, "rb")) == NULL) {
+		fclose(fp1);
+		return 0;
+	}
+	for (;;) {
+		n1 = fread(buf1, 1, sizeof(buf1), fp1);
+		n2 = fread(buf2, 1, sizeof(buf2), fp2);
+		if (n1 != n2 || memcmp(buf1, buf2, n1) != 0)
+			break;
+		if (n1 == 0) {
+			same = 1;
+			break;
+		}
+	}
+	fclose(fp1);
+	fclose(fp2);
+	return same;
+}
 /*
  * open input file.
  *
@@ -87,22 +190,45 @@ open_output_file(const char *path, int compress)
 	FILEOP *fileop;
 	FILE *fp;
 	char command[MAXFILLEN];
+	char tmppath[MAXPATHLEN];
+	const char *output;
 
+	/*
+	 * The path may be the static area of makepath(), which is
+	 * overwritten below; save it first.
+	 */
+	fileop = check_calloc(sizeof(FILEOP), 1);
+	strlimcpy(fileop->path, path, sizeof(fileop->path));
+	output = fileop->path;
+	if (update_only) {
+		strlimcpy(tmppath, makepath(NULL, fileop->path, "tmp"), sizeof(tmppath));
+		output = tmppath;
+	}
 	if (compress) {
-		snprintf(command, sizeof(command), "gzip -c >\"%s\"", path);
+#ifdef HAVE_LIBZ
+		/*
+		 * The contents are compressed in close_file().
+		 */
+		command[0] = '\0';
+		fp = tmpfile();
+		if (fp == NULL)
+			die("cannot make temporary file.");
+#else
+		snprintf(command, sizeof(command), "gzip -%d -c >\"%s\"", compress_level, output);
 		fp = popen(command, "w");
 		if (fp == NULL)
 			die("cannot create pipe.");
+#endif
 	} else {
-		fp = fopen(path, "w");
+		fp = fopen(output, "w");
 		if (fp == NULL)
-			die("cannot create file '%s'.", path);
+			die("cannot create file '%s'.", output);
 	}
-	fileop = check_calloc(sizeof(FILEOP), 1);
-	strlimcpy(fileop->path, path, sizeof(fileop->path));
+	if (update_only)
+		fileop->type |= FILEOP_UPDATE;
 	if (compress)
 		strlimcpy(fileop->command, command, sizeof(fileop->command));
-	fileop->type = FILEOP_OUTPUT;
+	fileop->type |= FILEOP_OUTPUT;
 	if (compress)
 		fileop->type |= FILEOP_COMPRESS;
 	fileop->fp = fp;
@@ -124,10 +250,29 @@ get_descripter(FILEOP *fileop)
 void
 close_file(FILEOP *fileop)
 {
+	char tmppath[MAXPATHLEN];
+
+	strlimcpy(tmppath, makepath(NULL, fileop->path, "tmp"), sizeof(tmppath));
 	if (fileop->type & FILEOP_COMPRESS) {
+#ifdef HAVE_LIBZ
+		compress_to(fileop->fp, (fileop->type & FILEOP_UPDATE) ? tmppath : fileop->path);
+		fclose(fileop->fp);
+#else
 		if (pclose(fileop->fp) != 0)
 			die("terminated abnormally. '%s'", fileop->command);
+#endif
 	} else
 		fclose(fileop->fp);
+	if (fileop->type & FILEOP_UPDATE) {
+		if (same_file(tmppath, fileop->path)) {
+			unlink(tmppath);
+		} else {
+#if defined(_WIN32) && !defined(__CYGWIN__)
+			unlink(fileop->path);
+#endif
+			if (rename(tmppath, fileop->path) < 0)
+				die("cannot rename file '%s'.", tmppath);
+		}
+	}
 	free(fileop);
 }
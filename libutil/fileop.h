@@ -30,6 +30,7 @@
 #define FILEOP_INPUT	1
 #define FILEOP_OUTPUT	2
 #define FILEOP_COMPRESS	4
+#define FILEOP_UPDATE	8
 
 typedef struct {
 	int type;
@@ -38,6 +39,8 @@ typedef struct {
 	char path[MAXPATHLEN];
 } FILEOP;
 
+void set_update_only(int);
+void set_compress_level(int);
 FILEOP *open_input_file(const char *);
 FILEOP *open_output_file(const char *, int);
 FILE *get_descripter(FILEOP *);
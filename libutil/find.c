@@ -260,6 +260,9 @@ prepare_skip(void)
 	strbuf_puts(reg, "/GRTAGS$|");
 	strbuf_puts(reg, "/GSYMS$|");
 	strbuf_puts(reg, "/GPATH$|");
+	strbuf_puts(reg, "/GTRIGRAM$|");
+	strbuf_puts(reg, "/GKEYS$|");
+	strbuf_puts(reg, "/GCACHE/|");
 	for (p = skiplist; p; ) {
 		char *skipf = p;
 		if ((p = locatestring(p, ",", MATCH_FIRST)) != NULL)
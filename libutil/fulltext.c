@@ -0,0 +1,380 @@
+/*
+ * Copyright (c) 2012 Tama Communications Corporation
+ *
+ * This file is part of GNU GLOBAL.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <assert.h>
+#include <stdio.h>
+#ifdef STDC_HEADERS
+#include <stdlib.h>
+#endif
+#ifdef HAVE_STRING_H
+#include <string.h>
+#else
+#include <strings.h>
+#endif
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+#ifdef HAVE_FCNTL_H
+#include <fcntl.h>
+#else
+#include <sys/file.h>
+#endif
+
+#include "checkalloc.h"
+#include "dbop.h"
+#include "die.h"
+#include "fulltext.h"
+#include "gtagsop.h"
+#include "makepath.h"
+#include "strbuf.h"
+#include "test.h"
+#include "varray.h"
+
+#ifndef O_BINARY
+#define O_BINARY 0
+#endif
+
+/*
+ * Full-text index (GTRIGRAM)
+ *
+ * The full-text index is a trigram index of the source files made by
+ * 'gtags --fulltext'. It is used by 'global -g' to select the files
+ * which may have the pattern. The index is case insensitive: each
+ * trigram is folded to lower case.
+ *
+ *	key		data
+ *	----------------------------------------
+ *	"746865"\0	"11,2,35,..."\0
+ *
+ * The key is a trigram in hexadecimal notation. The data is a posting
+ * list: the ascending file ids of the files which have the trigram.
+ * Each file id except for the head is expressed as the difference from
+ * the previous one. A trigram may have two or more records, since
+ * records are added by each flush and by incremental updating.
+ * A file id never appears twice for a trigram.
+ *
+ * Trigrams including '\n' or '\0' are not recorded, since the pattern
+ * of 'global -g' matches within a line.
+ *
+ * The index is maintained by 'gtags -i' if it exists. The index which is
+ * older than GTAGS is ignored, since it may have been left by older gtags.
+ */
+#define TRIGRAM(a, b, c)	(((a) << 16) | ((b) << 8) | (c))
+/*
+ * Only ASCII characters are folded, so that the index doesn't depend on locale.
+ */
+#define FOLD(c)			(((c) >= 'A' && (c) <= 'Z') ? (c) - 'A' + 'a' : (c))
+#define FULLTEXT_BUFSIZE	65536
+#define FULLTEXT_CHUNK		4000000	/* max number of postings in memory */
+
+struct posting {
+	unsigned int trigram;
+	unsigned int fid;
+};
+static DBOP *dbop;
+static VARRAY *postings;		/* postings which are not written yet */
+static unsigned char *seen;		/* bitmap of trigrams in a file */
+static VARRAY *trigrams;		/* trigrams in a file */
+
+static void flush_postings(void);
+static void make_key(char *, unsigned int);
+
+/*
+ * fulltext_usable: whether or not the full-text index is usable.
+ *
+ *	i)	dbpath	dbpath directory
+ *	r)		1: usable, 0: not usable
+ */
+int
+fulltext_usable(const char *dbpath)
+{
+	struct stat index, tags;
+
+	if (stat(makepath(dbpath, FULLTEXT_NAME, NULL), &index) < 0)
+		return 0;
+	if (stat(makepath(dbpath, dbname(GTAGS), NULL), &tags) < 0)
+		return 0;
+	return index.st_mtime >= tags.st_mtime;
+}
+/*
+ * fulltext_open: open the full-text index.
+ *
+ *	i)	dbpath	dbpath directory
+ *	i)	mode	0: read only, 1: create, 2: modify
+ *	r)		0: normal, -1: error
+ */
+int
+fulltext_open(const char *dbpath, int mode)
+{
+	assert(dbop == NULL);
+	dbop = dbop_open(makepath(dbpath, FULLTEXT_NAME, NULL), mode, 0644, DBOP_DUP);
+	if (dbop == NULL)
+		return -1;
+	if (mode != 0) {
+		postings = varray_open(sizeof(struct posting), 100000);
+		trigrams = varray_open(sizeof(unsigned int), 10000);
+		seen = (unsigned char *)check_calloc(1, (1 << 24) / 8);
+	}
+	return 0;
+}
+/*
+ * fulltext_put: add trigrams of a file to the index.
+ *
+ *	i)	path	path name
+ *	i)	fid	file id
+ */
+void
+fulltext_put(const char *path, const char *fid)
+{
+	unsigned char *buf = check_malloc(FULLTEXT_BUFSIZE);
+	unsigned int *t;
+	int a = '\n', b = '\n';		/* last two characters */
+	int fd, n, i;
+
+	if ((fd = open(path, O_RDONLY|O_BINARY)) < 0) {
+		warning("cannot open '%s'.", path);
+		free(buf);
+		return;
+	}
+	varray_reset(trigrams);
+	while ((n = read(fd, buf, FULLTEXT_BUFSIZE)) > 0) {
+		for (i = 0; i < n; i++) {
+			int c = FOLD(buf[i]);
+
+			if (c != '\n' && c != '\0' && a != '\n' && a != '\0' && b != '\n' && b != '\0') {
+				unsigned int tri = TRIGRAM(a, b, c);
+
+				if (!(seen[tri >> 3] & (1 << (tri & 7)))) {
+					seen[tri >> 3] |= 1 << (tri & 7);
+					*(unsigned int *)varray_append(trigrams) = tri;
+				}
+			}
+			a = b;
+			b = c;
+		}
+	}
+	close(fd);
+	free(buf);
+	/*
+	 * Move the trigrams of the file to the postings.
+	 */
+	t = varray_assign(trigrams, 0, 0);
+	for (i = 0; i < trigrams->length; i++) {
+		struct posting *p = varray_append(postings);
+
+		p->trigram = t[i];
+		p->fid = atoi(fid);
+		seen[t[i] >> 3] &= ~(1 << (t[i] & 7));
+	}
+	if (postings->length >= FULLTEXT_CHUNK)
+		flush_postings();
+}
+/*
+ * fulltext_delete: delete file ids from the index.
+ *
+ *	i)	deleteset	set of file ids
+ */
+void
+fulltext_delete(IDSET *deleteset)
+{
+	STRBUF *rest = strbuf_open(0);
+	STRBUF *sb = strbuf_open(0);
+	const char *dat, *p, *end;
+
+	for (dat = dbop_first(dbop, NULL, NULL, 0); dat; dat = dbop_next(dbop)) {
+		unsigned int id = 0, last = 0;
+		int changed = 0;
+
+		strbuf_reset(sb);
+		for (p = dat; *p; ) {
+			id += atoi(p);
+			if (idset_contains(deleteset, id)) {
+				changed = 1;
+			} else {
+				if (strbuf_getlen(sb) > 0)
+					strbuf_putc(sb, ',');
+				strbuf_putn(sb, id - last);
+				last = id;
+			}
+			while (*p && *p != ',')
+				p++;
+			if (*p == ',')
+				p++;
+		}
+		if (!changed)
+			continue;
+		/*
+		 * The rest of the list is put again after the scan.
+		 */
+		if (strbuf_getlen(sb) > 0) {
+			strbuf_puts0(rest, dbop->lastkey);
+			strbuf_puts0(rest, strbuf_value(sb));
+		}
+		dbop_delete(dbop, NULL);
+	}
+	p = strbuf_value(rest);
+	end = p + strbuf_getlen(rest);
+	while (p < end) {
+		const char *key = p;
+		const char *list = key + strlen(key) + 1;
+
+		dbop_put(dbop, key, list);
+		p = list + strlen(list) + 1;
+	}
+	strbuf_close(sb);
+	strbuf_close(rest);
+}
+/*
+ * fulltext_candidates: select files which may have a literal string.
+ *
+ *	i)	literal	literal string
+ *	i)	icase	1: ignore case
+ *	i)	size	upper bound of file id
+ *	r)		set of file ids
+ *			NULL: the index cannot be applied to the literal
+ *
+ * A file is a candidate if it has all the trigrams of the literal.
+ */
+IDSET *
+fulltext_candidates(const char *literal, int icase, unsigned int size)
+{
+	const unsigned char *s = (const unsigned char *)literal;
+	unsigned int *count;
+	IDSET *result;
+	char key[8];
+	int ntrigrams = 0, i, j, len = strlen(literal);
+
+	if (len < 3)
+		return NULL;
+	/*
+	 * Case folding of non-ASCII characters depends on locale.
+	 */
+	if (icase)
+		for (i = 0; i < len; i++)
+			if (s[i] >= 0x80)
+				return NULL;
+	count = (unsigned int *)check_calloc(sizeof(unsigned int), size);
+	for (i = 0; i + 2 < len; i++) {
+		unsigned int tri = TRIGRAM(FOLD(s[i]), FOLD(s[i + 1]), FOLD(s[i + 2]));
+		const char *dat;
+
+		/*
+		 * Skip duplicated trigrams in the literal.
+		 */
+		for (j = 0; j < i; j++)
+			if (TRIGRAM(FOLD(s[j]), FOLD(s[j + 1]), FOLD(s[j + 2])) == tri)
+				break;
+		if (j < i)
+			continue;
+		ntrigrams++;
+		make_key(key, tri);
+		for (dat = dbop_first(dbop, key, NULL, 0); dat; dat = dbop_next(dbop)) {
+			const char *p;
+			unsigned int id = 0;
+
+			for (p = dat; *p; ) {
+				id += atoi(p);
+				if (id < size && count[id] == ntrigrams - 1)
+					count[id]++;
+				while (*p && *p != ',')
+					p++;
+				if (*p == ',')
+					p++;
+			}
+		}
+	}
+	result = idset_open(size);
+	for (i = 0; i < size; i++)
+		if (count[i] == ntrigrams)
+			idset_add(result, i);
+	free(count);
+	return result;
+}
+/*
+ * fulltext_close: close the full-text index.
+ */
+void
+fulltext_close(void)
+{
+	if (postings) {
+		flush_postings();
+		varray_close(postings);
+		varray_close(trigrams);
+		free(seen);
+		postings = trigrams = NULL;
+		seen = NULL;
+	}
+	dbop_close(dbop);
+	dbop = NULL;
+}
+/*
+ * compare_posting: compare function for sorting postings.
+ */
+static int
+compare_posting(const void *v1, const void *v2)
+{
+	const struct posting *p1 = v1, *p2 = v2;
+
+	if (p1->trigram != p2->trigram)
+		return p1->trigram < p2->trigram ? -1 : 1;
+	if (p1->fid != p2->fid)
+		return p1->fid < p2->fid ? -1 : 1;
+	return 0;
+}
+/*
+ * flush_postings: write postings in memory to the index.
+ */
+static void
+flush_postings(void)
+{
+	STRBUF *sb = strbuf_open(0);
+	struct posting *p = varray_assign(postings, 0, 0);
+	char key[8];
+	int i, n = postings->length;
+
+	qsort(p, n, sizeof(struct posting), compare_posting);
+	for (i = 0; i < n; ) {
+		unsigned int tri = p[i].trigram, last = 0;
+
+		strbuf_reset(sb);
+		for (; i < n && p[i].trigram == tri; i++) {
+			if (strbuf_getlen(sb) > 0)
+				strbuf_putc(sb, ',');
+			strbuf_putn(sb, p[i].fid - last);
+			last = p[i].fid;
+		}
+		make_key(key, tri);
+		dbop_put(dbop, key, strbuf_value(sb));
+	}
+	varray_reset(postings);
+	strbuf_close(sb);
+}
+/*
+ * make_key: make key of a trigram.
+ */
+static void
+make_key(char *key, unsigned int tri)
+{
+	snprintf(key, 8, "%06x", tri);
+}
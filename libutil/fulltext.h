@@ -0,0 +1,34 @@
+/*
+ * Copyright (c) 2012 Tama Communications Corporation
+ *
+ * This file is part of GNU GLOBAL.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _FULLTEXT_H
+#define _FULLTEXT_H
+
+#include "idset.h"
+
+#define FULLTEXT_NAME	"GTRIGRAM"
+
+int fulltext_usable(const char *);
+int fulltext_open(const char *, int);
+void fulltext_put(const char *, const char *);
+void fulltext_delete(IDSET *);
+IDSET *fulltext_candidates(const char *, int, unsigned int);
+void fulltext_close(void);
+
+#endif /* ! _FULLTEXT_H */
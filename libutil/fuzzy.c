@@ -0,0 +1,196 @@
+/*
+ * Copyright (c) 2012 Tama Communications Corporation
+ *
+ * This file is part of GNU GLOBAL.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+#ifdef STDC_HEADERS
+#include <stdlib.h>
+#endif
+#ifdef HAVE_STRING_H
+#include <string.h>
+#else
+#include <strings.h>
+#endif
+
+#include "checkalloc.h"
+#include "fuzzy.h"
+
+/*
+ * Fuzzy matching: the pattern matches a name if the characters of the
+ * pattern appear in the name in the same order, ignoring case.
+ *
+ *	pattern 'wdgtshw' matches 'gtk_widget_show'
+ *	             ^ ^^ ^  ^^ ^
+ *
+ * A matched name is scored so that the best one comes first.
+ * Each matched character earns a point, and more if it is the head of
+ * the name or of a word ('_' separated or camel case), if it follows
+ * the previous matched character, or if the case is also the same.
+ * Skipped characters between matched ones cost a point each.
+ *
+ * Character set mask:
+ * Each bit of a mask represents a class of characters. If a name doesn't
+ * have all classes of the pattern, it cannot match. It is used to
+ * skip names without scanning. (See keydict.c)
+ */
+#define FOLD(c)		(((c) >= 'A' && (c) <= 'Z') ? (c) - 'A' + 'a' : (c))
+#define ISUPPER(c)	((c) >= 'A' && (c) <= 'Z')
+#define ISLOWER(c)	((c) >= 'a' && (c) <= 'z')
+#define ISDIGIT(c)	((c) >= '0' && (c) <= '9')
+#define ISALNUM(c)	(ISUPPER(c) || ISLOWER(c) || ISDIGIT(c))
+
+#define SCORE_MATCH		16
+#define SCORE_CASE		1
+#define BONUS_HEAD		10
+#define BONUS_WORD		8
+#define BONUS_CAMEL		7
+#define BONUS_CONSECUTIVE	4
+#define PENALTY_GAP		1
+
+/*
+ * charclass: class of a character (bit number of mask)
+ *
+ *	'a' - 'z'	0 - 25	(case insensitive)
+ *	'0' - '9'	26 - 30
+ *	others		31
+ */
+static int
+charclass(int c)
+{
+	c = FOLD(c);
+	if (ISLOWER(c))
+		return c - 'a';
+	if (ISDIGIT(c))
+		return 26 + (c - '0') % 5;
+	return 31;
+}
+/*
+ * fuzzy_mask: character set mask of a string.
+ *
+ *	i)	s	string
+ *	r)		mask
+ */
+unsigned int
+fuzzy_mask(const char *s)
+{
+	unsigned int mask = 0;
+
+	for (; *s; s++)
+		mask |= 1U << charclass((unsigned char)*s);
+	return mask;
+}
+/*
+ * fuzzy_open: compile a fuzzy pattern.
+ *
+ *	i)	pattern	pattern
+ *	r)		FUZZY structure
+ */
+FUZZY *
+fuzzy_open(const char *pattern)
+{
+	FUZZY *fz = (FUZZY *)check_malloc(sizeof(FUZZY));
+	int i;
+
+	fz->length = strlen(pattern);
+	fz->original = (unsigned char *)check_strdup(pattern);
+	fz->pattern = (unsigned char *)check_strdup(pattern);
+	for (i = 0; i < fz->length; i++)
+		fz->pattern[i] = FOLD(fz->pattern[i]);
+	fz->mask = fuzzy_mask(pattern);
+	return fz;
+}
+/*
+ * fuzzy_match: match a name with the pattern.
+ *
+ *	i)	fz	FUZZY structure
+ *	i)	name	name
+ *	r)		score (>= 0)
+ *			-1: not matched
+ *
+ * At first, the first occurrence is found from the left. Then it is
+ * tightened from its end to the left, so that a short match is scored.
+ */
+int
+fuzzy_match(const FUZZY *fz, const char *name)
+{
+	const unsigned char *s = (const unsigned char *)name;
+	const unsigned char *pat = fz->pattern;
+	int i, j, start, end, last, score;
+
+	if (fz->length == 0)
+		return 0;
+	/*
+	 * Find the first occurrence.
+	 */
+	for (i = j = 0; s[i]; i++) {
+		if (FOLD(s[i]) == pat[j] && ++j == fz->length)
+			break;
+	}
+	if (j < fz->length)
+		return -1;
+	end = i;
+	/*
+	 * Tighten it from the end.
+	 */
+	for (j = fz->length - 1; i >= 0; i--) {
+		if (FOLD(s[i]) == pat[j] && --j < 0)
+			break;
+	}
+	start = i;
+	/*
+	 * Score the match.
+	 */
+	score = 0;
+	last = -1;
+	for (i = start, j = 0; i <= end && j < fz->length; i++) {
+		if (FOLD(s[i]) != pat[j])
+			continue;
+		score += SCORE_MATCH;
+		if (s[i] == fz->original[j])
+			score += SCORE_CASE;
+		if (i == 0)
+			score += BONUS_HEAD;
+		else if (!ISALNUM(s[i - 1]) && ISALNUM(s[i]))
+			score += BONUS_WORD;
+		else if (ISLOWER(s[i - 1]) && ISUPPER(s[i]))
+			score += BONUS_CAMEL;
+		if (last >= 0) {
+			if (i == last + 1)
+				score += BONUS_CONSECUTIVE;
+			else
+				score -= (i - last - 1) * PENALTY_GAP;
+		}
+		last = i;
+		j++;
+	}
+	return score < 0 ? 0 : score;
+}
+/*
+ * fuzzy_close: close FUZZY structure.
+ *
+ *	i)	fz	FUZZY structure
+ */
+void
+fuzzy_close(FUZZY *fz)
+{
+	free(fz->pattern);
+	free(fz->original);
+	free(fz);
+}
@@ -0,0 +1,35 @@
+/*
+ * Copyright (c) 2012 Tama Communications Corporation
+ *
+ * This file is part of GNU GLOBAL.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _FUZZY_H
+#define _FUZZY_H
+
+typedef struct {
+	unsigned char *pattern;		/* pattern (folded to lower case) */
+	unsigned char *original;	/* pattern as is */
+	int length;			/* length of pattern */
+	unsigned int mask;		/* character set of pattern */
+} FUZZY;
+
+unsigned int fuzzy_mask(const char *);
+FUZZY *fuzzy_open(const char *);
+int fuzzy_match(const FUZZY *, const char *);
+void fuzzy_close(FUZZY *);
+
+#endif /* ! _FUZZY_H */
@@ -30,25 +30,33 @@
 #include "conf.h"
 #include "date.h"
 #include "dbop.h"
+#include "defindex.h"
 #include "defined.h"
 #include "die.h"
 #include "env.h"
 #include "fileop.h"
 #include "find.h"
 #include "format.h"
+#include "fulltext.h"
+#include "fuzzy.h"
 #include "getdbpath.h"
 #include "gpathop.h"
 #include "gtagsop.h"
 #include "idset.h"
 #include "is_unixy.h"
+#include "keydict.h"
 #include "langmap.h"
+#include "libpath.h"
+#include "lineindex.h"
 #include "linetable.h"
+#include "literal.h"
 #include "locatestring.h"
 #include "logging.h"
 #include "makepath.h"
 #include "path.h"
 #include "pathconvert.h"
 #include "pool.h"
+#include "querycache.h"
 #include "split.h"
 #include "statistics.h"
 #include "strbuf.h"
@@ -42,5 +42,16 @@
  */
 #define GTAGSCACHE	50000000	/* default cache size 50MB	*/
 #define GTAGSMINCACHE	500000		/* minimum cache size 500KB	*/
+/*
+ * A tag segment larger than GTAGSSORTCHUNK records is sorted
+ * in chunks and merged, to keep memory usage flat.
+ */
+#define GTAGSSORTCHUNK	100000		/* default records sorted at once */
+#define GTAGSMINSORTCHUNK	1000		/* minimum records sorted at once */
+/*
+ * The tag cache of htags is kept in memory up to HTAGSCACHE bytes.
+ * The rest is written to temporary files.
+ */
+#define HTAGSCACHE	200000000	/* default tag cache size 200MB	*/
 
 #endif /* ! _GPARAM_H_ */
@@ -45,6 +45,15 @@ static int _nextkey;
 static int _mode;
 static int opened;
 static int created;
+static int modified;
+static int newgeneration;
+static int *rank_table;
+static int rank_count;
+static int rank_loaded;
+
+static void gpath_putrank(void);
+static void gpath_loadrank(void);
+static const char *fidkey(const char *, const char *);
 
 /*
  * GPATH format version
@@ -80,6 +89,48 @@ static int created;
  *      --------------------
  *      ./aaa.c\0       11\0
  *      ./README\0      12\0o\0         <=== 'o' means other files.
+ *
+ * In addition, GPATH has a path-order rank table as a META record.
+ * The rank of a file is the position of the path name in the sorted
+ * path list. Since the rank is an integer, tag records can be sorted
+ * by (rank, line number) without comparing path names.
+ *
+ *      key             data
+ *      --------------------
+ *       __.PATHRANK\0  13\0<rank of fid 0><rank of fid 1>...<rank of fid 12>
+ *
+ * The number at the head is the value of NEXTKEY when the table was made.
+ * Each rank is a 4 bytes integer in network byte order.
+ * The table is rebuilt whenever GPATH is modified. If the number doesn't
+ * match to NEXTKEY (for instance, GPATH was updated by older gtags),
+ * the table is ignored and path names are compared instead.
+ * Since older global doesn't know this record, we need not change
+ * the format version.
+ *
+ * GPATH also has the line index of each source file as a META record.
+ * (See lineindex.c for the format of data.)
+ *
+ *      key             data
+ *      --------------------
+ *       __.LINES 11\0  <line index of ./aaa.c>
+ *
+ * And the definition index of each source file. (See defindex.c)
+ *
+ *      key             data
+ *      --------------------
+ *       __.DEFS 11\0   <definition index of ./aaa.c>
+ *
+ * Older global doesn't know this record either.
+ *
+ * The generation number of the tag files is also a META record.
+ * It is set to 1 when GPATH is created and incremented whenever
+ * GPATH or the other tag files are modified. (See gpath_newgeneration())
+ * The query cache of global(1) uses it to know whether a cached result
+ * is still valid. (See querycache.c)
+ *
+ *      key             data
+ *      --------------------
+ *       __.GENERATION\0 3\0
  */
 static int support_version = 2;	/* acceptable format version   */
 static int create_version = 2;	/* format version of newly created tag file */
@@ -111,10 +162,12 @@ gpath_open(const char *dbpath, int mode)
 	dbop = dbop_open(makepath(dbpath, dbname(GPATH), NULL), mode, 0644, 0);
 	if (dbop == NULL)
 		return -1;
+	modified = 0;
 	if (mode == 1) {
 		dbop_putversion(dbop, create_version);
 		_nextkey = 1;
-		
+		modified = 1;
+
 	} else {
 		int format_version;
 		const char *path = dbop_get(dbop, NEXTKEY);
@@ -170,6 +223,7 @@ gpath_put(const char *path, int type)
 	if (type == GPATH_OTHER)
 		strbuf_puts0(sb, "o");
 	dbop_put_withlen(dbop, fid, strbuf_value(sb), strbuf_getlen(sb));
+	modified = 1;
 }
 /*
  * gpath_path2fid: convert path into id
@@ -220,16 +274,205 @@ gpath_fid2path(const char *fid, int *type)
 void
 gpath_delete(const char *path)
 {
-	const char *fid;
+	char fid[MAXFIDLEN];
+	const char *p;
 
 	assert(opened > 0);
 	assert(_mode == 2);
 	assert(path[0] == '.' && path[1] == '/');
-	fid = dbop_get(dbop, path);
-	if (fid == NULL)
+	p = dbop_get(dbop, path);
+	if (p == NULL)
 		return;
+	strlimcpy(fid, p, sizeof(fid));
 	dbop_delete(dbop, fid);
 	dbop_delete(dbop, path);
+	dbop_delete(dbop, fidkey(LINESKEY, fid));
+	dbop_delete(dbop, fidkey(DEFSKEY, fid));
+	modified = 1;
+}
+/*
+ * fidkey: make key of a META record of a source file
+ *
+ *	i)	name	name of the record
+ *	i)	fid	file id
+ *	r)		key
+ */
+static const char *
+fidkey(const char *name, const char *fid)
+{
+	STATIC_STRBUF(sb);
+
+	strbuf_clear(sb);
+	strbuf_puts(sb, name);
+	strbuf_putc(sb, ' ');
+	strbuf_puts(sb, fid);
+	return strbuf_value(sb);
+}
+/*
+ * gpath_putlines: put line index of a source file
+ *
+ *	i)	fid	file id
+ *	i)	data	line index
+ *	i)	size	size of data
+ */
+void
+gpath_putlines(const char *fid, const char *data, int size)
+{
+	assert(opened > 0);
+	if (_mode == 1 && created)
+		return;
+	dbop_put_withlen(dbop, fidkey(LINESKEY, fid), data, size);
+}
+/*
+ * gpath_getlines: get line index of a source file
+ *
+ *	i)	fid	file id
+ *	o)	size	size of line index
+ *	r)		line index
+ *			NULL: not found
+ */
+const char *
+gpath_getlines(const char *fid, int *size)
+{
+	const char *data;
+
+	assert(opened > 0);
+	data = dbop_get(dbop, fidkey(LINESKEY, fid));
+	if (data != NULL && size)
+		*size = dbop->lastsize;
+	return data;
+}
+/*
+ * gpath_putdefs: put definition index of a source file
+ *
+ *	i)	fid	file id
+ *	i)	data	definition index
+ *	i)	size	size of data
+ */
+void
+gpath_putdefs(const char *fid, const char *data, int size)
+{
+	assert(opened > 0);
+	if (_mode == 1 && created)
+		return;
+	dbop_put_withlen(dbop, fidkey(DEFSKEY, fid), data, size);
+}
+/*
+ * gpath_getdefs: get definition index of a source file
+ *
+ *	i)	fid	file id
+ *	o)	size	size of definition index
+ *	r)		definition index
+ *			NULL: not found
+ */
+const char *
+gpath_getdefs(const char *fid, int *size)
+{
+	const char *data;
+
+	assert(opened > 0);
+	data = dbop_get(dbop, fidkey(DEFSKEY, fid));
+	if (data != NULL && size)
+		*size = dbop->lastsize;
+	return data;
+}
+/*
+ * gpath_fid2rank: convert id into path-order rank
+ *
+ *	i)	fid	file id
+ *	r)		rank
+ *			-1: rank table is not available
+ *
+ * If rank(a) < rank(b) then strcmp(path(a), path(b)) < 0.
+ */
+int
+gpath_fid2rank(int fid)
+{
+	assert(opened > 0);
+	if (!rank_loaded)
+		gpath_loadrank();
+	if (rank_table == NULL || fid <= 0 || fid >= rank_count)
+		return -1;
+	return rank_table[fid];
+}
+/*
+ * gpath_loadrank: load path-order rank table.
+ */
+static void
+gpath_loadrank(void)
+{
+	const unsigned char *p;
+	const char *dat;
+	int size, count, i;
+
+	rank_loaded = 1;
+	if ((dat = dbop_get(dbop, PATHRANKKEY)) == NULL)
+		return;
+	size = dbop->lastsize;
+	count = atoi(dat);
+	/*
+	 * The table is valid only when no file was added after making it.
+	 */
+	if (count != _nextkey)
+		return;
+	p = (const unsigned char *)dat + strlen(dat) + 1;
+	if (size != (p - (const unsigned char *)dat) + count * 4)
+		return;
+	rank_table = (int *)check_malloc(count * sizeof(int));
+	for (i = 0; i < count; i++, p += 4)
+		rank_table[i] = (p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+	rank_count = count;
+}
+/*
+ * gpath_putrank: make path-order rank table and put it into GPATH.
+ *
+ * Since the key of B-tree is sorted, we can get the rank of each path
+ * just by reading path names sequentially.
+ */
+static void
+gpath_putrank(void)
+{
+	STRBUF *sb = strbuf_open(0);
+	unsigned char *table;
+	const char *path;
+	int rank = 0;
+	int offset, fid;
+
+	strbuf_putn(sb, _nextkey);
+	strbuf_putc(sb, '\0');
+	offset = strbuf_getlen(sb);
+	/*
+	 * Holes of GPATH have rank 0.
+	 */
+	strbuf_nputc(sb, 0, _nextkey * 4);
+	table = (unsigned char *)strbuf_value(sb) + offset;
+	for (path = dbop_first(dbop, "./", NULL, DBOP_KEY | DBOP_PREFIX); path; path = dbop_next(dbop)) {
+		unsigned char *p;
+
+		fid = atoi(dbop_lastdat(dbop, NULL));
+		if (fid <= 0 || fid >= _nextkey)
+			die("GPATH is corrupted.(file id '%d' out of range)", fid);
+		rank++;
+		p = table + fid * 4;
+		p[0] = (rank >> 24) & 0xff;
+		p[1] = (rank >> 16) & 0xff;
+		p[2] = (rank >> 8) & 0xff;
+		p[3] = rank & 0xff;
+	}
+	dbop_put_withlen(dbop, PATHRANKKEY, strbuf_value(sb), strbuf_getlen(sb));
+	strbuf_close(sb);
+}
+/*
+ * gpath_newgeneration: increment the generation number at close.
+ *
+ * Tag files may be modified without modifying the path names in GPATH.
+ */
+void
+gpath_newgeneration(void)
+{
+	assert(opened > 0);
+	assert(_mode == 2);
+	newgeneration = 1;
 }
 /*
  * gpath_nextkey: return next key
@@ -260,7 +503,22 @@ gpath_close(void)
 	if (_mode == 1 || _mode == 2) {
 		snprintf(fid, sizeof(fid), "%d", _nextkey);
 		dbop_update(dbop, NEXTKEY, fid);
+		if (modified || newgeneration) {
+			const char *p = (_mode == 2) ? dbop_get(dbop, GENERATIONKEY) : NULL;
+
+			snprintf(fid, sizeof(fid), "%d", p ? atoi(p) + 1 : 1);
+			dbop_update(dbop, GENERATIONKEY, fid);
+			if (modified)
+				gpath_putrank();
+		}
+	}
+	if (rank_table) {
+		free(rank_table);
+		rank_table = NULL;
 	}
+	rank_count = 0;
+	rank_loaded = 0;
+	newgeneration = 0;
 	dbop_close(dbop);
 	if (_mode == 1)
 		created = 1;
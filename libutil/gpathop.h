@@ -26,6 +26,10 @@
 #include "dbop.h"
 
 #define NEXTKEY		" __.NEXTKEY"
+#define PATHRANKKEY	" __.PATHRANK"
+#define LINESKEY	" __.LINES"
+#define DEFSKEY		" __.DEFS"
+#define GENERATIONKEY	" __.GENERATION"
 
 /*
  * File type
@@ -51,8 +55,14 @@ typedef struct {
 int gpath_open(const char *, int);
 const char *gpath_path2fid(const char *, int *);
 const char *gpath_fid2path(const char *, int *);
+int gpath_fid2rank(int);
+void gpath_putlines(const char *, const char *, int);
+const char *gpath_getlines(const char *, int *);
+void gpath_putdefs(const char *, const char *, int);
+const char *gpath_getdefs(const char *, int *);
 void gpath_put(const char *, int);
 void gpath_delete(const char *);
+void gpath_newgeneration(void);
 void gpath_close(void);
 int gpath_nextkey(void);
 GFIND *gfind_open(const char *, const char *, int);
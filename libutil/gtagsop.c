@@ -59,12 +59,28 @@
 #define HASHBUCKETS	2048
 
 static int compare_path(const void *, const void *);
+static int compare_path_rank(const void *, const void *);
 static int compare_lineno(const void *, const void *);
 static int compare_tags(const void *, const void *);
+static int compare_tags_rank(const void *, const void *);
+static void sort_tags_rank(GTP *, int);
 static const char *seekto(const char *, int);
 static int is_defined_in_GTAGS(GTOP *, const char *);
+static const char *tag_first(GTOP *, const char *, regex_t *, int);
+static const char *tag_lookup(GTOP *, const char *);
+static const char *tag_next(GTOP *);
 static void flush_pool(GTOP *, const char *);
-static void segment_read(GTOP *);
+static int segment_read(GTOP *);
+static int segment_read_chunk(GTOP *);
+static int compare_segment(GTOP *, const GTP *, const GTP *);
+static void select_heap_fix(GTOP *, int);
+static void segment_sort(GTOP *);
+static GTP *segment_next(GTOP *);
+static void run_write(GTOP *);
+static int run_read(struct segment_run *);
+static void run_merge_start(GTOP *);
+static GTP *run_merge_next(GTOP *);
+static void run_close(GTOP *);
 
 /*
  * compare_path: compare function for sorting path names.
@@ -74,6 +90,18 @@ compare_path(const void *s1, const void *s2)
 {
 	return strcmp(*(char **)s1, *(char **)s2);
 }
+/*
+ * compare_path_rank: compare function for sorting path names by the rank.
+ */
+struct path_rank {
+	int rank;
+	char *path;
+};
+static int
+compare_path_rank(const void *v1, const void *v2)
+{
+	return ((const struct path_rank *)v1)->rank - ((const struct path_rank *)v2)->rank;
+}
 /*
  * compare_lineno: compare function for sorting line number.
  */
@@ -95,6 +123,71 @@ compare_tags(const void *v1, const void *v2)
 		return ret;
 	return e1->lineno - e2->lineno;
 }
+/*
+ * compare_tags_rank: compare function for sorting tags by the path-order rank.
+ */
+static int
+compare_tags_rank(const void *v1, const void *v2)
+{
+	const GTP *e1 = v1, *e2 = v2;
+
+	if (e1->rank != e2->rank)
+		return e1->rank - e2->rank;
+	return e1->lineno - e2->lineno;
+}
+/*
+ * sort_tags_rank: sort tags by (rank, line number) using radix sort.
+ *
+ *	i)	array	array of GTP
+ *	i)	count	number of entries
+ *
+ * This is a LSD radix sort with 8 bits digit. The line number is used
+ * for the lower 4 digits and the rank for the upper 4 digits.
+ * A pass in which all entries have the same digit is skipped,
+ * so usually only 2 or 3 passes are done for each key.
+ * Small arrays are sorted by qsort(3) with integer comparison.
+ */
+#define RADIX_THRESHOLD	64
+#define RADIX_DIGIT(e, pass) \
+	((((pass) < 4 ? (unsigned int)(e)->lineno : (unsigned int)(e)->rank) >> (((pass) % 4) * 8)) & 0xff)
+static void
+sort_tags_rank(GTP *array, int count)
+{
+	GTP *work, *from, *to, *tmp;
+	int bucket[256];
+	int pass, i, sum, n;
+
+	if (count < RADIX_THRESHOLD) {
+		qsort(array, count, sizeof(GTP), compare_tags_rank);
+		return;
+	}
+	work = (GTP *)check_malloc(count * sizeof(GTP));
+	from = array;
+	to = work;
+	for (pass = 0; pass < 8; pass++) {
+		memset(bucket, 0, sizeof(bucket));
+		for (i = 0; i < count; i++)
+			bucket[RADIX_DIGIT(&from[i], pass)]++;
+		/*
+		 * All entries have the same digit.
+		 */
+		if (bucket[RADIX_DIGIT(&from[0], pass)] == count)
+			continue;
+		for (sum = 0, i = 0; i < 256; i++) {
+			n = bucket[i];
+			bucket[i] = sum;
+			sum += n;
+		}
+		for (i = 0; i < count; i++)
+			to[bucket[RADIX_DIGIT(&from[i], pass)]++] = from[i];
+		tmp = from;
+		from = to;
+		to = tmp;
+	}
+	if (from != array)
+		memcpy(array, from, count * sizeof(GTP));
+	free(work);
+}
 /*
  * seekto: seek to the specified item of tag record.
  *
@@ -241,9 +334,15 @@ static const char *const tagslist[] = {"GPATH", "GTAGS", "GRTAGS", "GSYMS"};
  * GRTAGS ============> GRTAGS + GSYMS
  *            +=======> GRTAGS	tags which is defined in GTAGS
  *            +=======> GSYMS	tags which is not defined in GTAGS
+ *
+ * The split is materialized in the key dictionary (GKEYS) by gtags(1).
+ * If it is available, the keys of the virtual tag file are read from the
+ * dictionary and the records are read from GRTAGS by key (See tag_first()).
+ * So, only the records to be returned are read. Otherwise, each key of
+ * GRTAGS is looked up in GTAGS while reading.
  */
 #define VIRTUAL_GRTAGS_GSYMS_PROCESSING(gtop) 						\
-	if (gtop->db == GRTAGS || gtop->db == GSYMS) {					\
+	if (gtop->keys == NULL && (gtop->db == GRTAGS || gtop->db == GSYMS)) {		\
 		int defined = is_defined_in_GTAGS(gtop, gtop->dbop->lastkey);		\
 		if ((gtop->db == GRTAGS && !defined) || (gtop->db == GSYMS && defined))	\
 			continue;							\
@@ -268,6 +367,83 @@ is_defined_in_GTAGS(GTOP *gtop, const char *name)
 	strlimcpy(prev_name, name, sizeof(prev_name));
 	return prev_result = dbop_get(gtop->gtags, prev_name) ? 1 : 0;
 }
+/*
+ * tag_first: get the first record of the virtual tag file.
+ *
+ *	i)	gtop	GTOP structure
+ *	i)	key	key or prefix (NULL: all keys)
+ *	i)	preg	compiled regular expression if any
+ *	i)	dbflags	flags value of dbop_first()
+ *	r)		record (key if DBOP_KEY)
+ *
+ * Without the key dictionary, this is dbop_first().
+ */
+static const char *
+tag_first(GTOP *gtop, const char *key, regex_t *preg, int dbflags)
+{
+	const char *name;
+
+	if (gtop->keys == NULL)
+		return dbop_first(gtop->dbop, key, preg, dbflags);
+	gtop->key_preg = preg;
+	gtop->key_flags = dbflags;
+	gtop->key_single = 0;
+	if (key == NULL) {
+		name = keydict_first(gtop->keys, NULL);
+	} else {
+		strlimcpy(gtop->key_prefix, key, sizeof(gtop->key_prefix));
+		name = keydict_first(gtop->keys, gtop->key_prefix);
+		if (!(dbflags & DBOP_PREFIX)) {
+			if (name && strcmp(name, key) != 0)
+				name = NULL;
+			gtop->key_single = 1;
+		}
+	}
+	return tag_lookup(gtop, name);
+}
+/*
+ * tag_lookup: read the records of the key or the following keys.
+ *
+ *	i)	gtop	GTOP structure
+ *	i)	name	key read from the key dictionary
+ *	r)		record (key if DBOP_KEY)
+ */
+static const char *
+tag_lookup(GTOP *gtop, const char *name)
+{
+	const char *tagline;
+
+	for (; name; name = gtop->key_single ? NULL : keydict_next(gtop->keys)) {
+		if (gtop->key_preg && regexec(gtop->key_preg, name, 0, 0, 0) != 0)
+			continue;
+		if (gtop->key_flags & DBOP_KEY)
+			return name;
+		if ((tagline = dbop_first(gtop->dbop, name, NULL, 0)) != NULL)
+			return tagline;
+	}
+	return NULL;
+}
+/*
+ * tag_next: get the next record of the virtual tag file.
+ *
+ *	i)	gtop	GTOP structure
+ *	r)		record (key if DBOP_KEY)
+ *
+ * Without the key dictionary, this is dbop_next().
+ */
+static const char *
+tag_next(GTOP *gtop)
+{
+	const char *tagline;
+
+	if (gtop->keys == NULL)
+		return dbop_next(gtop->dbop);
+	if (!(gtop->key_flags & DBOP_KEY) && (tagline = dbop_next(gtop->dbop)) != NULL)
+		return tagline;
+	if (gtop->key_single)
+		return NULL;
+	return tag_lookup(gtop, keydict_next(gtop->keys));
+}
 /*
  * dbname: return db name
  *
@@ -337,13 +513,20 @@ gtags_open(const char *dbpath, const char *root, int db, int mode, int flags)
 			die("cannot make %s.", dbname(db));
 		die("%s not found.", dbname(db));
 	}
+	if (gtop->mode == GTAGS_READ && (db == GRTAGS || db == GSYMS))
+		gtop->keys = keydict_open(dbpath, db);
 	if (gtop->mode == GTAGS_READ && db != GTAGS) {
 		const char *gtags = makepath(dbpath, dbname(GTAGS), NULL);
 		int format_version;
 
-		gtop->gtags = dbop_open(gtags, 0, 0, 0);
-		if (gtop->gtags == NULL)
-			die("GTAGS not found.");
+		/*
+		 * GTAGS is needed only to split GRTAGS without the key dictionary.
+		 */
+		if (gtop->keys == NULL) {
+			gtop->gtags = dbop_open(gtags, 0, 0, 0);
+			if (gtop->gtags == NULL)
+				die("GTAGS not found.");
+		}
 		format_version = dbop_getversion(gtop->dbop);
 		if (format_version > upper_bound_version)
 			die("%s seems new format. Please install the latest GLOBAL.", gtags);
@@ -415,6 +598,15 @@ gtags_open(const char *dbpath, const char *root, int db, int mode, int flags)
 	}
 	if (gtop->mode != GTAGS_READ)
 		gtop->sb = strbuf_open(0);	/* This buffer is used for working area. */
+	/*
+	 * Decide the max number of records sorted in memory at once.
+	 * See libutil/gparam.h for the details.
+	 */
+	gtop->segment_limit = GTAGSSORTCHUNK;
+	if (getenv("GTAGSSORTCHUNK") != NULL)
+		gtop->segment_limit = atoi(getenv("GTAGSSORTCHUNK"));
+	if (gtop->segment_limit < GTAGSMINSORTCHUNK)
+		gtop->segment_limit = GTAGSMINSORTCHUNK;
 	/*
 	 * Stuff for compact format.
 	 */
@@ -426,6 +618,35 @@ gtags_open(const char *dbpath, const char *root, int db, int mode, int flags)
 	}
 	return gtop;
 }
+/*
+ * gtags_tagkey: key of a tag record
+ *
+ *	i)	gtop	descripter of GTOP
+ *	i)	tag	tag name
+ *	r)		key
+ *
+ * extract method when class method definition.
+ *
+ * Ex: Class::method(...)
+ *
+ * key	= 'method'
+ * data = 'Class::method  103 ./class.cpp ...'
+ *
+ * The compact format doesn't extract method.
+ */
+const char *
+gtags_tagkey(GTOP *gtop, const char *tag)
+{
+	const char *key;
+
+	if ((gtop->format & GTAGS_COMPACT) || !(gtop->flags & GTAGS_EXTRACTMETHOD))
+		return tag;
+	if ((key = locatestring(tag, ".", MATCH_LAST)) != NULL)
+		return key + 1;
+	if ((key = locatestring(tag, "::", MATCH_LAST)) != NULL)
+		return key + 2;
+	return tag;
+}
 /*
  * gtags_put_using: put tag record with packing.
  *
@@ -440,6 +661,8 @@ gtags_put_using(GTOP *gtop, const char *tag, int lno, const char *fid, const cha
 {
 	const char *key;
 
+	if (gtop->touched)
+		strhash_assign(gtop->touched, gtags_tagkey(gtop, tag), 1);
 	if (gtop->format & GTAGS_COMPACT) {
 		struct sh_entry *entry;
 
@@ -460,24 +683,7 @@ gtags_put_using(GTOP *gtop, const char *tag, int lno, const char *fid, const cha
 		*(int *)varray_append((VARRAY *)entry->value) = lno;
 		return;
 	}
-	/*
-	 * extract method when class method definition.
-	 *
-	 * Ex: Class::method(...)
-	 *
-	 * key	= 'method'
-	 * data = 'Class::method  103 ./class.cpp ...'
-	 */
-	if (gtop->flags & GTAGS_EXTRACTMETHOD) {
-		if ((key = locatestring(tag, ".", MATCH_LAST)) != NULL)
-			key++;
-		else if ((key = locatestring(tag, "::", MATCH_LAST)) != NULL)
-			key += 2;
-		else
-			key = tag;
-	} else {
-		key = tag;
-	}
+	key = gtags_tagkey(gtop, tag);
 	strbuf_reset(gtop->sb);
 	strbuf_puts(gtop->sb, fid);
 	strbuf_putc(gtop->sb, ' ');
@@ -522,8 +728,11 @@ gtags_delete(GTOP *gtop, IDSET *deleteset)
 		/*
 		 * If the file id exists in the deleteset, delete the tagline.
 		 */
-		if (idset_contains(deleteset, fid))
+		if (idset_contains(deleteset, fid)) {
+			if (gtop->touched)
+				strhash_assign(gtop->touched, gtop->dbop->lastkey, 1);
 			dbop_delete(gtop->dbop, NULL);
+		}
 	}
 }
 /*
@@ -541,6 +750,10 @@ gtags_delete(GTOP *gtop, IDSET *deleteset)
  *			GTOP_BASICREGEX	use basic regular expression.
  *			GTOP_NOSORT	don't sort
  *	r)		record
+ *
+ * If gtop->limit is set to positive number, at most gtop->limit records
+ * are returned. In sorted read, they are the first gtop->limit records
+ * in the sorted order.
  */
 GTP *
 gtags_first(GTOP *gtop, const char *pattern, int flags)
@@ -549,11 +762,16 @@ gtags_first(GTOP *gtop, const char *pattern, int flags)
 	int regflags = 0;
 	char prefix[IDENTLEN];
 	static regex_t reg;
+	static int reg_compiled;
 	regex_t *preg = &reg;
 	const char *key = NULL;
 	const char *tagline;
 
 	/* Settlement for last time if any */
+	if (reg_compiled) {
+		regfree(&reg);
+		reg_compiled = 0;
+	}
 	if (gtop->path_hash) {
 		strhash_close(gtop->path_hash);
 		gtop->path_hash = NULL;
@@ -564,6 +782,7 @@ gtags_first(GTOP *gtop, const char *pattern, int flags)
 	}
 
 	gtop->flags = flags;
+	gtop->count = 0;
 	if (flags & GTOP_PREFIX && pattern != NULL)
 		dbflags |= DBOP_PREFIX;
 	if (flags & GTOP_KEY)
@@ -588,6 +807,8 @@ gtags_first(GTOP *gtop, const char *pattern, int flags)
 		preg = NULL;
 	} else if (isregex(pattern) && regcomp(preg, pattern, regflags) == 0) {
 		const char *p;
+
+		reg_compiled = 1;
 		/*
 		 * If the pattern include '^' + some non regular expression
 		 * characters like '^aaa[0-9]', we take prefix read method
@@ -628,9 +849,9 @@ gtags_first(GTOP *gtop, const char *pattern, int flags)
 		 * |105		./aaa/b.c
 		 *  ...
 		 */
-		for (tagline = dbop_first(gtop->dbop, key, preg, dbflags);
+		for (tagline = tag_first(gtop, key, preg, dbflags);
 		     tagline != NULL;
-		     tagline = dbop_next(gtop->dbop))
+		     tagline = tag_next(gtop))
 		{
 			VIRTUAL_GRTAGS_GSYMS_PROCESSING(gtop);
 			/* extract file id */
@@ -645,6 +866,11 @@ gtags_first(GTOP *gtop, const char *pattern, int flags)
 				if (cp == NULL)
 					die("GPATH is corrupted.(file id '%s' not found)", tagline);
 				entry->value = strhash_strdup(gtop->path_hash, cp, 0);
+				/*
+				 * Without sorting, we need not read the rest.
+				 */
+				if ((gtop->flags & GTOP_NOSORT) && GTOP_LIMIT_REACHED(gtop, gtop->path_hash->entries))
+					break;
 			}
 		}
 		/*
@@ -662,9 +888,32 @@ gtags_first(GTOP *gtop, const char *pattern, int flags)
 			gtop->path_array[i++] = entry->value;
 		if (i != gtop->path_hash->entries)
 			die("Something is wrong. 'i = %lu, entries = %lu'" , i, gtop->path_hash->entries);
-		if (!(gtop->flags & GTOP_NOSORT))
-			qsort(gtop->path_array, gtop->path_hash->entries, sizeof(char *), compare_path);
+		if (!(gtop->flags & GTOP_NOSORT)) {
+			/*
+			 * If the path-order rank is available, we sort path names
+			 * by the rank instead of comparing path names.
+			 */
+			struct path_rank *rank_array = (struct path_rank *)
+				check_malloc(gtop->path_hash->entries * sizeof(struct path_rank));
+
+			i = 0;
+			for (entry = strhash_first(gtop->path_hash); entry != NULL; entry = strhash_next(gtop->path_hash)) {
+				if ((rank_array[i].rank = gpath_fid2rank(atoi(entry->name))) < 0)
+					break;
+				rank_array[i++].path = entry->value;
+			}
+			if (i == gtop->path_hash->entries) {
+				qsort(rank_array, i, sizeof(struct path_rank), compare_path_rank);
+				for (i = 0; i < gtop->path_hash->entries; i++)
+					gtop->path_array[i] = rank_array[i].path;
+			} else {
+				qsort(gtop->path_array, gtop->path_hash->entries, sizeof(char *), compare_path);
+			}
+			free(rank_array);
+		}
 		gtop->path_count = gtop->path_hash->entries;
+		if (GTOP_LIMIT_REACHED(gtop, gtop->path_count))
+			gtop->path_count = gtop->limit;
 		gtop->path_index = 0;
 
 		if (gtop->path_index >= gtop->path_count)
@@ -672,14 +921,17 @@ gtags_first(GTOP *gtop, const char *pattern, int flags)
 		gtop->gtp.path = gtop->path_array[gtop->path_index++];
 		return &gtop->gtp;
 	} else if (gtop->flags & GTOP_KEY) {
-		for (gtop->gtp.tag = dbop_first(gtop->dbop, key, preg, dbflags);
+		for (gtop->gtp.tag = tag_first(gtop, key, preg, dbflags);
 		     gtop->gtp.tag != NULL;
-		     gtop->gtp.tag = dbop_next(gtop->dbop))
+		     gtop->gtp.tag = tag_next(gtop))
 		{
 			VIRTUAL_GRTAGS_GSYMS_PROCESSING(gtop);
 			break;
 		}
-		return gtop->gtp.tag ? &gtop->gtp : NULL;
+		if (gtop->gtp.tag == NULL)
+			return NULL;
+		gtop->count++;
+		return &gtop->gtp;
 	} else {
 		if (gtop->vb == NULL)
 			gtop->vb = varray_open(sizeof(GTP), 200);
@@ -693,7 +945,11 @@ gtags_first(GTOP *gtop, const char *pattern, int flags)
 			gtop->path_hash = strhash_open(HASHBUCKETS);
 		else
 			strhash_reset(gtop->path_hash);
-		tagline = dbop_first(gtop->dbop, key, preg, dbflags);
+		if (gtop->run_count > 0)
+			run_close(gtop);
+		gtop->gtp_count = gtop->gtp_index = 0;
+		gtop->segment_rest = 0;
+		tagline = tag_first(gtop, key, preg, dbflags);
 		if (tagline == NULL)
 			return NULL;
 		/*
@@ -703,8 +959,7 @@ gtags_first(GTOP *gtop, const char *pattern, int flags)
 		/*
 		 * Read a tag segment with sorting.
 		 */
-		segment_read(gtop);
-		return  &gtop->gtp_array[gtop->gtp_index++];
+		return segment_next(gtop);
 	}
 }
 /*
@@ -723,28 +978,21 @@ gtags_next(GTOP *gtop)
 		gtop->gtp.path = gtop->path_array[gtop->path_index++];
 		return &gtop->gtp;
 	} else if (gtop->flags & GTOP_KEY) {
-		for (gtop->gtp.tag = dbop_next(gtop->dbop);
+		if (GTOP_LIMIT_REACHED(gtop, gtop->count))
+			return NULL;
+		for (gtop->gtp.tag = tag_next(gtop);
 		     gtop->gtp.tag != NULL;
-		     gtop->gtp.tag = dbop_next(gtop->dbop))
+		     gtop->gtp.tag = tag_next(gtop))
 		{
 			VIRTUAL_GRTAGS_GSYMS_PROCESSING(gtop);
 			break;
 		}
-		return gtop->gtp.tag ? &gtop->gtp : NULL;
-	} else {
-		/*
-		 * End of segment.
-		 * Reset resources and read new segment again.
-		 */
-		if (gtop->gtp_index >= gtop->gtp_count) {
-			varray_reset(gtop->vb);
-			pool_reset(gtop->segment_pool);
-			/* strhash_reset(gtop->path_hash); */
-			segment_read(gtop);
-		}
-		if (gtop->gtp_index >= gtop->gtp_count)
+		if (gtop->gtp.tag == NULL)
 			return NULL;
-		return &gtop->gtp_array[gtop->gtp_index++];
+		gtop->count++;
+		return &gtop->gtp;
+	} else {
+		return segment_next(gtop);
 	}
 }
 /*
@@ -759,6 +1007,12 @@ gtags_close(GTOP *gtop)
 		abbrev_close();
 	if (gtop->format & GTAGS_COMPACT && gtop->cur_path[0])
 		flush_pool(gtop, NULL);
+	if (gtop->run_count > 0)
+		run_close(gtop);
+	if (gtop->runs)
+		free(gtop->runs);
+	if (gtop->run_heap)
+		free(gtop->run_heap);
 	if (gtop->segment_pool)
 		pool_close(gtop->segment_pool);
 	if (gtop->path_array)
@@ -773,6 +1027,8 @@ gtags_close(GTOP *gtop)
 	dbop_close(gtop->dbop);
 	if (gtop->gtags)
 		dbop_close(gtop->gtags);
+	if (gtop->keys)
+		keydict_close(gtop->keys);
 	free(gtop);
 }
 /*
@@ -904,6 +1160,99 @@ flush_pool(GTOP *gtop, const char *s_fid)
 		varray_close(vb);
 	}
 }
+/*
+ * gtags_unfold: unfold the line numbers of a compact format record.
+ *
+ *	i)	gtop	GTOP structure
+ *	i)	lines	line number part of the record (<line no>,...)
+ *	i)	put	function called with each line number
+ *	i)	arg	argument for the function
+ *	r)		number of line numbers
+ *
+ * Please see flush_pool() for the format.
+ */
+int
+gtags_unfold(GTOP *gtop, const char *lines, void (*put)(int, void *), void *arg)
+{
+	const char *p = lines;
+	int n, count = 0;
+
+	if (!isdigit((unsigned char)*p))
+		die("illegal compact format.");
+	if (gtop->format & GTAGS_COMPLINE) {
+		int last = 0, cont = 0;
+
+		while (*p || cont > 0) {
+			if (cont > 0) {
+				n = last + 1;
+				if (n > cont) {
+					cont = 0;
+					continue;
+				}
+			} else {
+				int c = isdigit((unsigned char)*p) ? 0 : *p++;
+
+				for (n = 0; isdigit((unsigned char)*p); p++)
+					n = n * 10 + *p - '0';
+				if (c == '-') {
+					cont = n + last;
+					n = last + 1;
+				} else if (c == ',') {
+					n += last;
+				}
+			}
+			(*put)(n, arg);
+			count++;
+			last = n;
+		}
+	} else {
+		while (*p) {
+			for (n = 0; isdigit((unsigned char)*p); p++)
+				n = n * 10 + *p - '0';
+			if (*p == ',')
+				p++;
+			(*put)(n, arg);
+			count++;
+		}
+	}
+	return count;
+}
+/*
+ * segment_next: return next record of segments.
+ *
+ *	i)	gtop	GTOP structure
+ *	r)		record
+ *			NULL end of tag
+ */
+static GTP *
+segment_next(GTOP *gtop)
+{
+	GTP *gtp;
+
+	if (GTOP_LIMIT_REACHED(gtop, gtop->count))
+		return NULL;
+	for (;;) {
+		if (gtop->run_count > 0) {
+			if ((gtp = run_merge_next(gtop)) != NULL) {
+				gtop->count++;
+				return gtp;
+			}
+			run_close(gtop);
+		} else if (gtop->gtp_index < gtop->gtp_count) {
+			gtop->count++;
+			return &gtop->gtp_array[gtop->gtp_index++];
+		}
+		/*
+		 * End of segment.
+		 * Reset resources and read new segment again.
+		 */
+		varray_reset(gtop->vb);
+		pool_reset(gtop->segment_pool);
+		/* strhash_reset(gtop->path_hash); */
+		if (segment_read(gtop) == 0)
+			return NULL;
+	}
+}
 /*
  * Read a tag segment with sorting.
  *
@@ -912,6 +1261,8 @@ flush_pool(GTOP *gtop, const char *s_fid)
  *	o)	gtop->gtp_count		segment table size
  *	o)	gtop->gtp_index		segment table index (initial value = 0)
  *	o)	gtop->cur_tagname	current tag name
+ *	o)	gtop->run_count		number of sorted runs (huge segment)
+ *	r)				number of records
  *
  * A segment is a set of tag records which have same tag name.
  * This function read a segment from tag file, sort it and put it on segment table.
@@ -922,19 +1273,79 @@ flush_pool(GTOP *gtop, const char *s_fid)
  *	2nd key: file name
  *	3rd key: line number
  * Since all records in a segment have same tag name, you need not think about 1st key.
+ * If GPATH has the path-order rank table, the rank of the file is used
+ * as the 2nd key instead of the file name.
+ *
+ * At most gtop->segment_limit records are read into the memory at once.
+ * If a segment is larger than it, then
+ *	o without sorting, the segment is returned chunk by chunk.
+ *	o with sorting, each chunk is sorted and written to a temporary file
+ *	  as a sorted run, and the runs are merged by gtags_next().
+ * So, memory usage doesn't depend on the size of the segment.
+ *
+ * If the number of records to be returned is limited (gtop->limit),
+ *	o without sorting, reading stops when the limit is reached.
+ *	o with sorting, only the first N records in the sorted order are
+ *	  kept in a heap while reading the segment (top-N selection).
  */
-void
+static int
 segment_read(GTOP *gtop)
+{
+	int total;
+
+	total = segment_read_chunk(gtop);
+	if (!gtop->segment_rest || (gtop->flags & GTOP_NOSORT)) {
+		segment_sort(gtop);
+		return total;
+	}
+	/*
+	 * Huge segment: make sorted runs and merge them.
+	 */
+	for (;;) {
+		segment_sort(gtop);
+		run_write(gtop);
+		varray_reset(gtop->vb);
+		pool_reset(gtop->segment_pool);
+		if (!gtop->segment_rest)
+			break;
+		total += segment_read_chunk(gtop);
+	}
+	gtop->gtp_count = gtop->gtp_index = 0;
+	run_merge_start(gtop);
+	return total;
+}
+/*
+ * segment_read_chunk: read a chunk of a tag segment.
+ *
+ *	i)	gtop	GTOP structure
+ *	o)	gtop->segment_rest	1: the segment continues
+ *	r)				number of records
+ */
+static int
+segment_read_chunk(GTOP *gtop)
 {
 	const char *tagline, *fid, *path, *lineno;
-	GTP *gtp;
+	GTP *gtp, key;
 	struct sh_entry *sh;
+	int rest = 0, select = 0;
 
+	/*
+	 * Number of records which can be returned.
+	 */
+	if (gtop->limit > 0) {
+		rest = gtop->limit - gtop->count;
+		if (!(gtop->flags & GTOP_NOSORT) && rest < gtop->segment_limit)
+			select = rest;
+	}
 	/*
 	 * Save tag lines.
 	 */
-	gtop->cur_tagname[0] = '\0';
-	while ((tagline = dbop_next(gtop->dbop)) != NULL) {
+	if (!gtop->segment_rest) {
+		gtop->cur_tagname[0] = '\0';
+		gtop->segment_rank = 1;
+	}
+	gtop->segment_rest = 0;
+	while ((tagline = tag_next(gtop)) != NULL) {
 		VIRTUAL_GRTAGS_GSYMS_PROCESSING(gtop);
 		/*
 		 * get tag name and line number.
@@ -949,30 +1360,309 @@ segment_read(GTOP *gtop)
 			 */
 			dbop_unread(gtop->dbop);
 			break;
+		} else if (!select && (gtop->vb->length >= gtop->segment_limit ||
+				(rest > 0 && gtop->vb->length >= rest))) {
+			/*
+			 * The rest of the segment will be read next time.
+			 */
+			dbop_unread(gtop->dbop);
+			gtop->segment_rest = 1;
+			break;
 		}
-		gtp = varray_append(gtop->vb);
-		gtp->tagline = pool_strdup(gtop->segment_pool, tagline, 0);
-		gtp->tag = (const char *)gtop->cur_tagname;
-		/*
-		 * convert fid into hashed path name to save memory.
-		 */
 		fid = (const char *)strmake(tagline, " ");
-		path = gpath_fid2path(fid, NULL);
-		if (path == NULL)
-			die("gtags_first: path not found. (fid=%s)", fid);
-		sh = strhash_assign(gtop->path_hash, path, 1);
-		gtp->path = sh->name;
-		lineno = seekto(gtp->tagline, SEEKTO_LINENO);
+		key.fid = atoi(fid);
+		if ((key.rank = gpath_fid2rank(key.fid)) < 0)
+			gtop->segment_rank = 0;
+		lineno = seekto(tagline, SEEKTO_LINENO);
 		if (lineno == NULL)
 			die("illegal tag record.\n%s", tagline);
-		gtp->lineno = atoi(lineno);
+		key.lineno = atoi(lineno);
+		key.path = key.tagline = NULL;
+		if (select && gtop->vb->length >= select) {
+			/*
+			 * The heap is full. Replace the largest record with
+			 * the new one only if the new one is smaller.
+			 */
+			gtp = varray_assign(gtop->vb, 0, 0);
+			if (!gtop->segment_rank) {
+				if ((path = gpath_fid2path(fid, NULL)) == NULL)
+					die("gtags_first: path not found. (fid=%s)", fid);
+				key.path = strhash_assign(gtop->path_hash, path, 1)->name;
+			}
+			if (compare_segment(gtop, &key, gtp) >= 0)
+				continue;
+			/*
+			 * Reuse the area of the dropped record if possible.
+			 */
+			if (strlen(tagline) <= strlen(gtp->tagline))
+				key.tagline = strcpy((char *)gtp->tagline, tagline);
+		} else {
+			gtp = varray_append(gtop->vb);
+		}
+		/*
+		 * convert fid into hashed path name to save memory.
+		 */
+		if (key.path == NULL) {
+			path = gpath_fid2path(fid, NULL);
+			if (path == NULL)
+				die("gtags_first: path not found. (fid=%s)", fid);
+			sh = strhash_assign(gtop->path_hash, path, 1);
+			key.path = sh->name;
+		}
+		if (key.tagline == NULL)
+			key.tagline = pool_strdup(gtop->segment_pool, tagline, 0);
+		key.tag = (const char *)gtop->cur_tagname;
+		*gtp = key;
+		if (select)
+			select_heap_fix(gtop, gtp - (GTP *)varray_assign(gtop->vb, 0, 0));
 	}
-	/*
-	 * Sort tag lines.
-	 */
 	gtop->gtp_array = varray_assign(gtop->vb, 0, 0);
 	gtop->gtp_count = gtop->vb->length;
 	gtop->gtp_index = 0;
-	if (!(gtop->flags & GTOP_NOSORT))
+	return gtop->gtp_count;
+}
+/*
+ * compare_segment: compare two records in a segment.
+ */
+static int
+compare_segment(GTOP *gtop, const GTP *e1, const GTP *e2)
+{
+	return gtop->segment_rank ? compare_tags_rank(e1, e2) : compare_tags(e1, e2);
+}
+/*
+ * select_heap_fix: restore the heap property of the top-N selection.
+ *
+ *	i)	gtop	GTOP structure
+ *	i)	i	index of the record which was appended or replaced
+ *
+ * The segment table is a max heap. The top is the largest record.
+ */
+static void
+select_heap_fix(GTOP *gtop, int i)
+{
+	GTP *heap = varray_assign(gtop->vb, 0, 0);
+	int n = gtop->vb->length;
+	GTP tmp;
+
+	/* up */
+	while (i > 0 && compare_segment(gtop, &heap[(i - 1) / 2], &heap[i]) < 0) {
+		tmp = heap[i];
+		heap[i] = heap[(i - 1) / 2];
+		heap[(i - 1) / 2] = tmp;
+		i = (i - 1) / 2;
+	}
+	/* down */
+	for (;;) {
+		int max = i, l = 2 * i + 1, r = 2 * i + 2;
+
+		if (l < n && compare_segment(gtop, &heap[l], &heap[max]) > 0)
+			max = l;
+		if (r < n && compare_segment(gtop, &heap[r], &heap[max]) > 0)
+			max = r;
+		if (max == i)
+			break;
+		tmp = heap[i];
+		heap[i] = heap[max];
+		heap[max] = tmp;
+		i = max;
+	}
+}
+/*
+ * segment_sort: sort tag lines in the segment table.
+ *
+ *	i)	gtop	GTOP structure
+ */
+static void
+segment_sort(GTOP *gtop)
+{
+	if (gtop->flags & GTOP_NOSORT)
+		return;
+	if (gtop->segment_rank)
+		sort_tags_rank(gtop->gtp_array, gtop->gtp_count);
+	else
 		qsort(gtop->gtp_array, gtop->gtp_count, sizeof(GTP), compare_tags);
 }
+/*
+ * Sorted run of a huge segment.
+ *
+ * Each record is written to a temporary file like follows:
+ *
+ *	<header><path>\0<tagline>\0
+ */
+struct run_header {
+	int rank;
+	int lineno;
+	int fid;
+	int pathlen;
+	int linelen;
+};
+struct segment_run {
+	FILE *fp;			/* temporary file */
+	STRBUF *sb;			/* current record */
+	GTP gtp;			/* current record */
+};
+/*
+ * run_write: write the sorted segment table as a sorted run.
+ *
+ *	i)	gtop	GTOP structure
+ */
+static void
+run_write(GTOP *gtop)
+{
+	struct segment_run *run;
+	struct run_header h;
+	int i;
+
+	if (gtop->gtp_count == 0)
+		return;
+	if (gtop->run_count >= gtop->run_alloced) {
+		gtop->run_alloced = gtop->run_alloced ? gtop->run_alloced * 2 : 16;
+		gtop->runs = (struct segment_run *)check_realloc(gtop->runs,
+				gtop->run_alloced * sizeof(struct segment_run));
+	}
+	run = &gtop->runs[gtop->run_count++];
+	run->fp = tmpfile();
+	if (run->fp == NULL)
+		die("cannot make temporary file.\nYou can specify the directory for the temporary file using environment variable 'TMPDIR'.");
+	run->sb = strbuf_open(0);
+	for (i = 0; i < gtop->gtp_count; i++) {
+		GTP *gtp = &gtop->gtp_array[i];
+
+		h.rank = gtp->rank;
+		h.lineno = gtp->lineno;
+		h.fid = gtp->fid;
+		h.pathlen = strlen(gtp->path) + 1;
+		h.linelen = strlen(gtp->tagline) + 1;
+		if (fwrite(&h, sizeof(h), 1, run->fp) != 1
+		    || fwrite(gtp->path, h.pathlen, 1, run->fp) != 1
+		    || fwrite(gtp->tagline, h.linelen, 1, run->fp) != 1)
+			die("cannot write to temporary file.");
+	}
+}
+/*
+ * run_read: read next record of the sorted run.
+ *
+ *	i)	run	sorted run
+ *	r)		0: end of run, 1: read
+ */
+static int
+run_read(struct segment_run *run)
+{
+	struct run_header h;
+	char *p;
+
+	if (fread(&h, sizeof(h), 1, run->fp) != 1)
+		return 0;
+	strbuf_reset(run->sb);
+	strbuf_nputc(run->sb, 0, h.pathlen + h.linelen);
+	p = strbuf_value(run->sb);
+	if (fread(p, h.pathlen + h.linelen, 1, run->fp) != 1)
+		die("cannot read from temporary file.");
+	run->gtp.rank = h.rank;
+	run->gtp.lineno = h.lineno;
+	run->gtp.fid = h.fid;
+	run->gtp.path = p;
+	run->gtp.tagline = p + h.pathlen;
+	return 1;
+}
+/*
+ * run_merge: compare function for the heap of runs.
+ */
+#define RUN_LESS(gtop, a, b) \
+	(compare_segment(gtop, &(gtop)->runs[a].gtp, &(gtop)->runs[b].gtp) < 0)
+static void
+run_heap_down(GTOP *gtop, int i)
+{
+	int *heap = gtop->run_heap;
+	int n = gtop->heap_size;
+
+	for (;;) {
+		int min = i, l = 2 * i + 1, r = 2 * i + 2, tmp;
+
+		if (l < n && RUN_LESS(gtop, heap[l], heap[min]))
+			min = l;
+		if (r < n && RUN_LESS(gtop, heap[r], heap[min]))
+			min = r;
+		if (min == i)
+			break;
+		tmp = heap[i];
+		heap[i] = heap[min];
+		heap[min] = tmp;
+		i = min;
+	}
+}
+/*
+ * run_merge_start: prepare for merging sorted runs.
+ *
+ *	i)	gtop	GTOP structure
+ */
+static void
+run_merge_start(GTOP *gtop)
+{
+	int i;
+
+	gtop->run_heap = (int *)check_realloc(gtop->run_heap, gtop->run_count * sizeof(int));
+	gtop->heap_size = 0;
+	for (i = 0; i < gtop->run_count; i++) {
+		struct segment_run *run = &gtop->runs[i];
+
+		rewind(run->fp);
+		if (run_read(run))
+			gtop->run_heap[gtop->heap_size++] = i;
+	}
+	for (i = gtop->heap_size / 2 - 1; i >= 0; i--)
+		run_heap_down(gtop, i);
+	/*
+	 * The record at the top of the heap is returned by run_merge_next()
+	 * next time. Mark it as not yet returned.
+	 */
+	gtop->gtp_index = -1;
+}
+/*
+ * run_merge_next: return next record of the merged runs.
+ *
+ *	i)	gtop	GTOP structure
+ *	r)		record
+ *			NULL end of runs
+ */
+static GTP *
+run_merge_next(GTOP *gtop)
+{
+	struct segment_run *run;
+
+	/*
+	 * Advance the run whose record was returned last time.
+	 */
+	if (gtop->gtp_index >= 0 && gtop->heap_size > 0) {
+		run = &gtop->runs[gtop->run_heap[0]];
+		if (!run_read(run))
+			gtop->run_heap[0] = gtop->run_heap[--gtop->heap_size];
+		run_heap_down(gtop, 0);
+	}
+	if (gtop->heap_size == 0)
+		return NULL;
+	gtop->gtp_index = 0;
+	run = &gtop->runs[gtop->run_heap[0]];
+	gtop->gtp = run->gtp;
+	gtop->gtp.tag = (const char *)gtop->cur_tagname;
+	gtop->gtp.path = strhash_assign(gtop->path_hash, run->gtp.path, 1)->name;
+	return &gtop->gtp;
+}
+/*
+ * run_close: remove sorted runs.
+ *
+ *	i)	gtop	GTOP structure
+ */
+static void
+run_close(GTOP *gtop)
+{
+	int i;
+
+	for (i = 0; i < gtop->run_count; i++) {
+		fclose(gtop->runs[i].fp);
+		strbuf_close(gtop->runs[i].sb);
+	}
+	gtop->run_count = 0;
+	gtop->heap_size = 0;
+	gtop->gtp_count = gtop->gtp_index = 0;
+}
@@ -26,6 +26,7 @@
 #include "gparam.h"
 #include "dbop.h"
 #include "idset.h"
+#include "keydict.h"
 #include "strbuf.h"
 #include "strhash.h"
 #include "varray.h"
@@ -62,6 +63,8 @@
 #define GTOP_BASICREGEX		32	/* use basic regular expression */
 #define GTOP_NOSORT		64	/* don't sort */
 
+#define GTOP_LIMIT_REACHED(gtop, n)	((gtop)->limit > 0 && (n) >= (gtop)->limit)
+
 /*
  * This entry corresponds to one raw record.
  */
@@ -70,8 +73,12 @@ typedef struct {
 	const char *path;
 	const char *tag;
 	int lineno;
+	int fid;			/* file id */
+	int rank;			/* path-order rank of the file */
 } GTP;
 
+struct segment_run;
+
 typedef struct {
 	DBOP *dbop;			/* descripter of DBOP */
 	DBOP *gtags;			/* descripter of GTAGS */
@@ -81,7 +88,17 @@ typedef struct {
 	int db;				/* 0:GTAGS, 1:GRTAGS, 2:GSYMS */
 	int openflags;			/* flags value of gtags_open() */
 	int flags;			/* flags */
+	int limit;			/* max records returned (0: unlimited) */
+	int count;			/* records returned */
 	char root[MAXPATHLEN];	/* root directory of source tree */
+	/*
+	 * Stuff for reading GRTAGS or GSYMS by key.
+	 */
+	KEYDICT *keys;			/* keys of the virtual tag file */
+	char key_prefix[IDENTLEN];	/* prefix of keys */
+	regex_t *key_preg;		/* regular expression for keys */
+	int key_flags;			/* flags value of dbop_first() */
+	int key_single;			/* 1: only one key is read */
 	/*
 	 * Stuff for GTOP_PATH.
 	 */
@@ -98,6 +115,17 @@ typedef struct {
 	POOL *segment_pool;
 	VARRAY *vb;
 	char cur_tagname[IDENTLEN];	/* current tag name */
+	int segment_limit;		/* max records read at once */
+	int segment_rest;		/* 1: current segment continues */
+	int segment_rank;		/* 1: sort by path-order rank */
+	/*
+	 * Stuff for merging sorted runs of a huge segment.
+	 */
+	struct segment_run *runs;	/* sorted runs in temporary files */
+	int run_count;
+	int run_alloced;
+	int *run_heap;			/* heap of run index */
+	int heap_size;
 	/*
 	 * Stuff for compact format
 	 */
@@ -105,15 +133,22 @@ typedef struct {
 	STRBUF *sb;			/* string buffer */
 	/* used for compact format and path name only read */
 	STRHASH *path_hash;
+	/*
+	 * Keys of the records put or deleted (NULL: not recorded).
+	 * Gtags(1) uses them to update the key dictionary.
+	 */
+	STRHASH *touched;
 } GTOP;
 
 const char *dbname(int);
 GTOP *gtags_open(const char *, const char *, int, int, int);
+const char *gtags_tagkey(GTOP *, const char *);
 void gtags_put_using(GTOP *, const char *, int, const char *, const char *);
 void gtags_flush(GTOP *, const char *);
 void gtags_delete(GTOP *, IDSET *);
 GTP *gtags_first(GTOP *, const char *, int);
 GTP *gtags_next(GTOP *);
+int gtags_unfold(GTOP *, const char *, void (*)(int, void *), void *);
 void gtags_close(GTOP *);
 
 #endif /* ! _GTOP_H_ */
@@ -0,0 +1,758 @@
+/*
+ * Copyright (c) 2012 Tama Communications Corporation
+ *
+ * This file is part of GNU GLOBAL.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <stdio.h>
+#ifdef STDC_HEADERS
+#include <stdlib.h>
+#endif
+#ifdef HAVE_STRING_H
+#include <string.h>
+#else
+#include <strings.h>
+#endif
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+#ifdef HAVE_FCNTL_H
+#include <fcntl.h>
+#else
+#include <sys/file.h>
+#endif
+#if defined(HAVE_SYS_MMAN_H) && defined(HAVE_MMAP)
+#include <sys/mman.h>
+#define USE_MMAP
+#endif
+
+#include "checkalloc.h"
+#include "dbop.h"
+#include "die.h"
+#include "fuzzy.h"
+#include "gpathop.h"
+#include "gtagsop.h"
+#include "keydict.h"
+#include "makepath.h"
+#include "strbuf.h"
+#include "strlimcpy.h"
+#include "test.h"
+
+#ifndef O_BINARY
+#define O_BINARY 0
+#endif
+
+/*
+ * Key dictionary (GKEYS)
+ *
+ * The key dictionary is a sorted list of the distinct keys of the tag files.
+ * It is made by gtags(1) and used by 'global -c', 'global -cP' and
+ * 'global --fuzzy'.
+ * Without it, completion reads every record of the tag file with the
+ * prefix, though most of them have the same key.
+ *
+ * The dictionary has the following sections. Each section is optional.
+ *
+ *	0: KEYDICT_SOURCE	path names of source files in GPATH
+ *	1: GTAGS		tag names in GTAGS
+ *	2: GRTAGS		tag names in GRTAGS which are defined in GTAGS
+ *	3: GSYMS		tag names in GRTAGS which are not defined in GTAGS
+ *	4: KEYDICT_OTHER	path names of other files in GPATH
+ *
+ * File format (each number is 4 bytes in big endian):
+ *
+ *	"GKEYS 3\n"
+ *	<generation number of the tag files>
+ *	<offset of section 0><size of section 0> ... (offset 0: not available)
+ *	<section 0> ...
+ *
+ * Section format (front coding):
+ *
+ *	<number of keys><number of blocks><offset of block 0>...
+ *	<mask of block 0>...
+ *	<block 0> ...
+ *
+ * A block has KEYDICT_BLOCK keys at most. The first key of a block is
+ * written as is, and each of the rest is written as the length of the
+ * common prefix with the previous key and the rest of the key.
+ * The offset of a block is relative to the start of the section.
+ * The mask of a block is the union of the character set masks of
+ * its keys (See fuzzy.c). A block can be skipped by the mask.
+ *
+ *	"strbuf_close\0" <7>"open\0" <7>"puts\0" ...
+ *
+ * A prefix is looked up by binary search of the first keys of the blocks.
+ * So, enumeration costs in proportion to the number of the results.
+ *
+ * The GRTAGS and GSYMS sections are the materialized split of the real
+ * GRTAGS file. Gtags_open() uses them to read GRTAGS by key instead of
+ * probing GTAGS for each key (See gtagsop.c). Since a wrong split would
+ * make wrong results, the dictionary is used only when its generation
+ * number is equal to that of the tag files (See gpathop.c).
+ */
+#define KEYDICT_MAGIC	"GKEYS 3\n"
+#define KEYDICT_HEADER	(sizeof(KEYDICT_MAGIC) - 1 + 4)
+#define KEYDICT_BLOCK	16
+
+/*
+ * Builder of a section.
+ */
+struct builder {
+	STRBUF *data;			/* blocks */
+	STRBUF *index;			/* offsets of blocks */
+	STRBUF *masks;			/* masks of blocks */
+	unsigned int mask;		/* mask of the current block */
+	STRBUF *prev;			/* previous key */
+	unsigned long count;		/* number of keys */
+};
+
+static void put_number(STRBUF *, unsigned long);
+static unsigned long get_number(const unsigned char *);
+static unsigned long generation(const char *);
+static void builder_open(struct builder *);
+static void builder_add(struct builder *, const char *);
+static void builder_close(struct builder *, STRBUF *);
+static KEYDICT *load(const char *, int);
+static const char *read_key(KEYDICT *);
+
+/*
+ * put_number: put 4 bytes number in big endian.
+ */
+static void
+put_number(STRBUF *sb, unsigned long n)
+{
+	strbuf_putc(sb, (n >> 24) & 0xff);
+	strbuf_putc(sb, (n >> 16) & 0xff);
+	strbuf_putc(sb, (n >> 8) & 0xff);
+	strbuf_putc(sb, n & 0xff);
+}
+/*
+ * get_number: get 4 bytes number in big endian.
+ */
+static unsigned long
+get_number(const unsigned char *p)
+{
+	return ((unsigned long)p[0] << 24) | ((unsigned long)p[1] << 16) | ((unsigned long)p[2] << 8) | p[3];
+}
+/*
+ * generation: get the generation number of the tag files.
+ *
+ *	i)	dbpath	dbpath directory
+ *	r)		generation number (0: not available)
+ */
+static unsigned long
+generation(const char *dbpath)
+{
+	DBOP *dbop = dbop_open(makepath(dbpath, dbname(GPATH), NULL), 0, 0, 0);
+	const char *p;
+	unsigned long n = 0;
+
+	if (dbop == NULL)
+		return 0;
+	if ((p = dbop_get(dbop, GENERATIONKEY)) != NULL)
+		n = strtoul(p, NULL, 10);
+	dbop_close(dbop);
+	return n;
+}
+static void
+builder_open(struct builder *b)
+{
+	b->data = strbuf_open(0);
+	b->index = strbuf_open(0);
+	b->masks = strbuf_open(0);
+	b->prev = strbuf_open(0);
+	b->mask = 0;
+	b->count = 0;
+}
+/*
+ * builder_add: add a key to a section.
+ *
+ * Keys should be added in ascending order without duplication.
+ */
+static void
+builder_add(struct builder *b, const char *key)
+{
+	if (b->count % KEYDICT_BLOCK == 0) {
+		if (b->count > 0)
+			put_number(b->masks, b->mask);
+		b->mask = 0;
+		put_number(b->index, strbuf_getlen(b->data));
+		strbuf_puts0(b->data, key);
+	} else {
+		const char *prev = strbuf_value(b->prev);
+		unsigned long shared = 0, n;
+
+		while (prev[shared] && prev[shared] == key[shared])
+			shared++;
+		/* variable length: 7 bits per byte, lower bits first */
+		for (n = shared; n >= 0x80; n >>= 7)
+			strbuf_putc(b->data, (n & 0x7f) | 0x80);
+		strbuf_putc(b->data, n);
+		strbuf_puts0(b->data, key + shared);
+	}
+	strbuf_reset(b->prev);
+	strbuf_puts(b->prev, key);
+	b->mask |= fuzzy_mask(key);
+	b->count++;
+}
+/*
+ * builder_close: append the section to a buffer and close the builder.
+ */
+static void
+builder_close(struct builder *b, STRBUF *sb)
+{
+	unsigned long nblocks = strbuf_getlen(b->index) / 4;
+	unsigned long head = 8 + nblocks * 8;
+	const unsigned char *p = (const unsigned char *)strbuf_value(b->index);
+	unsigned long i;
+
+	if (b->count > 0)
+		put_number(b->masks, b->mask);
+	put_number(sb, b->count);
+	put_number(sb, nblocks);
+	for (i = 0; i < nblocks; i++)
+		put_number(sb, head + get_number(p + i * 4));
+	strbuf_nputs(sb, strbuf_value(b->masks), strbuf_getlen(b->masks));
+	strbuf_nputs(sb, strbuf_value(b->data), strbuf_getlen(b->data));
+	strbuf_close(b->data);
+	strbuf_close(b->index);
+	strbuf_close(b->masks);
+	strbuf_close(b->prev);
+}
+/*
+ * make_paths: make the sections of path names.
+ *
+ *	i)	dbpath	dbpath directory
+ *	o)	sections	sections
+ */
+static void
+make_paths(const char *dbpath, STRBUF **sections)
+{
+	struct builder source, other;
+	GFIND *gp;
+	const char *key;
+
+	/*
+	 * GPATH is sorted by path name.
+	 */
+	builder_open(&source);
+	builder_open(&other);
+	gp = gfind_open(dbpath, NULL, GPATH_BOTH);
+	while ((key = gfind_read(gp)) != NULL)
+		builder_add(gp->type == GPATH_OTHER ? &other : &source, key);
+	gfind_close(gp);
+	sections[KEYDICT_SOURCE] = strbuf_open(0);
+	builder_close(&source, sections[KEYDICT_SOURCE]);
+	sections[KEYDICT_OTHER] = strbuf_open(0);
+	builder_close(&other, sections[KEYDICT_OTHER]);
+}
+/*
+ * write_dict: write the key dictionary and close the sections.
+ *
+ *	i)	dbpath	dbpath directory
+ *	i)	sections	sections (NULL: not available)
+ *
+ * The dictionary is written to a temporary file and renamed,
+ * so that global(1) never reads a half-written dictionary.
+ */
+static void
+write_dict(const char *dbpath, STRBUF **sections)
+{
+	STRBUF *sb = strbuf_open(0);
+	char path[MAXPATHLEN];
+	unsigned long offset;
+	FILE *op;
+	int i;
+
+	strbuf_puts(sb, KEYDICT_MAGIC);
+	put_number(sb, generation(dbpath));
+	offset = KEYDICT_HEADER + KEYDICT_SECTIONS * 8;
+	for (i = 0; i < KEYDICT_SECTIONS; i++) {
+		if (sections[i] == NULL) {
+			put_number(sb, 0);
+			put_number(sb, 0);
+		} else {
+			put_number(sb, offset);
+			put_number(sb, strbuf_getlen(sections[i]));
+			offset += strbuf_getlen(sections[i]);
+		}
+	}
+	snprintf(path, sizeof(path), "%s.%d", makepath(dbpath, KEYDICT_NAME, NULL), getpid());
+	if ((op = fopen(path, "wb")) == NULL)
+		die("cannot make '%s'.", KEYDICT_NAME);
+	fwrite(strbuf_value(sb), 1, strbuf_getlen(sb), op);
+	for (i = 0; i < KEYDICT_SECTIONS; i++) {
+		if (sections[i] != NULL) {
+			fwrite(strbuf_value(sections[i]), 1, strbuf_getlen(sections[i]), op);
+			strbuf_close(sections[i]);
+		}
+	}
+	if (fclose(op) != 0) {
+		unlink(path);
+		die("cannot write '%s'.", KEYDICT_NAME);
+	}
+	if (rename(path, makepath(dbpath, KEYDICT_NAME, NULL)) < 0) {
+		unlink(path);
+		die("cannot make '%s'.", KEYDICT_NAME);
+	}
+	strbuf_close(sb);
+}
+/*
+ * keydict_make: make the key dictionary from the tag files.
+ *
+ *	i)	dbpath	dbpath directory
+ *
+ * GTAGS and GPATH must exist. GRTAGS is optional.
+ */
+void
+keydict_make(const char *dbpath)
+{
+	struct builder b[KEYDICT_SECTIONS];
+	STRBUF *sections[KEYDICT_SECTIONS];
+	DBOP *gtags, *grtags;
+	const char *key;
+	int i;
+
+	for (i = 0; i < KEYDICT_SECTIONS; i++)
+		sections[i] = NULL;
+	make_paths(dbpath, sections);
+	/*
+	 * Tag names.
+	 */
+	gtags = dbop_open(makepath(dbpath, dbname(GTAGS), NULL), 0, 0, 0);
+	if (gtags == NULL)
+		die("cannot open '%s'.", dbname(GTAGS));
+	builder_open(&b[GTAGS]);
+	for (key = dbop_first(gtags, NULL, NULL, DBOP_KEY); key; key = dbop_next(gtags))
+		builder_add(&b[GTAGS], key);
+	grtags = dbop_open(makepath(dbpath, dbname(GRTAGS), NULL), 0, 0, 0);
+	if (grtags != NULL) {
+		builder_open(&b[GRTAGS]);
+		builder_open(&b[GSYMS]);
+		for (key = dbop_first(grtags, NULL, NULL, DBOP_KEY); key; key = dbop_next(grtags))
+			builder_add(&b[dbop_get(gtags, key) ? GRTAGS : GSYMS], key);
+		dbop_close(grtags);
+	}
+	dbop_close(gtags);
+	for (i = GTAGS; i <= GSYMS; i++) {
+		if (i == GRTAGS || i == GSYMS) {
+			if (grtags == NULL)
+				continue;
+		}
+		sections[i] = strbuf_open(0);
+		builder_close(&b[i], sections[i]);
+	}
+	write_dict(dbpath, sections);
+}
+/*
+ * keydict_current: check whether the dictionary is up to date.
+ *
+ *	i)	dbpath	dbpath directory
+ *	r)		1: made from the current generation of the tag files
+ *
+ * Keydict_update() can be used only if this returns 1 before the
+ * tag files are updated.
+ */
+int
+keydict_current(const char *dbpath)
+{
+	KEYDICT *kd;
+	int current;
+
+	if ((kd = keydict_open(dbpath, GTAGS)) == NULL)
+		return 0;
+	current = (get_number((const unsigned char *)kd->map + strlen(KEYDICT_MAGIC)) == generation(dbpath));
+	keydict_close(kd);
+	if (current && test("f", makepath(dbpath, dbname(GRTAGS), NULL))) {
+		if ((kd = keydict_open(dbpath, GSYMS)) == NULL)
+			return 0;
+		keydict_close(kd);
+	}
+	return current;
+}
+static int
+compare_key(const void *s1, const void *s2)
+{
+	return strcmp(*(const char **)s1, *(const char **)s2);
+}
+/*
+ * keydict_update: update the key dictionary after incremental updating.
+ *
+ *	i)	dbpath	dbpath directory
+ *	i)	keys	keys of the records which were deleted or added
+ *
+ * Only the given keys are looked up in the tag files. The other keys
+ * are taken from the old dictionary, and a section in which no key is
+ * added or removed is copied as is. So, the cost doesn't depend on the
+ * size of GTAGS and GRTAGS, unlike keydict_make().
+ * The old dictionary must have been current before updating.
+ * (See keydict_current())
+ */
+void
+keydict_update(const char *dbpath, STRHASH *keys)
+{
+	STRBUF *sections[KEYDICT_SECTIONS];
+	struct sh_entry *entry;
+	DBOP *gtags, *grtags;
+	char **names;
+	unsigned char *member;
+	unsigned long count, i;
+	int db;
+
+	for (db = 0; db < KEYDICT_SECTIONS; db++)
+		sections[db] = NULL;
+	/*
+	 * Look up the keys in the tag files.
+	 */
+	names = check_malloc(sizeof(char *) * (keys->entries + 1));
+	count = 0;
+	for (entry = strhash_first(keys); entry; entry = strhash_next(keys))
+		names[count++] = entry->name;
+	qsort(names, count, sizeof(char *), compare_key);
+	member = check_malloc(count + 1);
+	gtags = dbop_open(makepath(dbpath, dbname(GTAGS), NULL), 0, 0, 0);
+	if (gtags == NULL)
+		die("cannot open '%s'.", dbname(GTAGS));
+	grtags = dbop_open(makepath(dbpath, dbname(GRTAGS), NULL), 0, 0, 0);
+	for (i = 0; i < count; i++) {
+		int defined = dbop_get(gtags, names[i]) != NULL;
+
+		member[i] = defined ? (1 << GTAGS) : 0;
+		if (grtags && dbop_get(grtags, names[i]) != NULL)
+			member[i] |= defined ? (1 << GRTAGS) : (1 << GSYMS);
+	}
+	if (grtags)
+		dbop_close(grtags);
+	dbop_close(gtags);
+	/*
+	 * Merge the keys with the old sections.
+	 */
+	for (db = GTAGS; db <= GSYMS; db++) {
+		KEYDICT *kd;
+		struct builder b;
+		const char *key;
+		int changed = 0;
+
+		if ((db == GRTAGS || db == GSYMS) && grtags == NULL)
+			continue;
+		if ((kd = load(dbpath, db)) == NULL)
+			die("'%s' is broken.", KEYDICT_NAME);
+		for (i = 0; i < count && !changed; i++) {
+			key = keydict_first(kd, names[i]);
+			if ((key != NULL && !strcmp(key, names[i])) != ((member[i] & (1 << db)) != 0))
+				changed = 1;
+		}
+		sections[db] = strbuf_open(0);
+		if (!changed) {
+			strbuf_nputs(sections[db], (const char *)kd->section, kd->size);
+			keydict_close(kd);
+			continue;
+		}
+		builder_open(&b);
+		i = 0;
+		for (key = keydict_first(kd, NULL); key; key = keydict_next(kd)) {
+			int cmp = 1;
+
+			for (; i < count && (cmp = strcmp(names[i], key)) < 0; i++)
+				if (member[i] & (1 << db))
+					builder_add(&b, names[i]);
+			if (cmp == 0) {
+				if (member[i] & (1 << db))
+					builder_add(&b, names[i]);
+				i++;
+			} else
+				builder_add(&b, key);
+		}
+		for (; i < count; i++)
+			if (member[i] & (1 << db))
+				builder_add(&b, names[i]);
+		builder_close(&b, sections[db]);
+		keydict_close(kd);
+	}
+	free(member);
+	free(names);
+	make_paths(dbpath, sections);
+	write_dict(dbpath, sections);
+}
+/*
+ * load: load a section of the key dictionary.
+ *
+ *	i)	dbpath	dbpath directory
+ *	i)	section	section number
+ *	r)		KEYDICT structure
+ *			NULL: the section is not available
+ */
+static KEYDICT *
+load(const char *dbpath, int section)
+{
+	KEYDICT *kd;
+	struct stat st;
+	const unsigned char *table;
+	unsigned long offset, size;
+	int fd;
+
+	if ((fd = open(makepath(dbpath, KEYDICT_NAME, NULL), O_RDONLY|O_BINARY)) < 0)
+		return NULL;
+	if (fstat(fd, &st) < 0 || st.st_size < KEYDICT_HEADER + KEYDICT_SECTIONS * 8) {
+		close(fd);
+		return NULL;
+	}
+	kd = (KEYDICT *)check_calloc(sizeof(KEYDICT), 1);
+	kd->mapsize = st.st_size;
+#ifdef USE_MMAP
+	kd->map = mmap(NULL, kd->mapsize, PROT_READ, MAP_SHARED, fd, 0);
+	if (kd->map != MAP_FAILED)
+		kd->mapped = 1;
+	else
+#endif
+	{
+		kd->map = check_malloc(kd->mapsize);
+		if (read(fd, kd->map, kd->mapsize) != kd->mapsize) {
+			close(fd);
+			free(kd->map);
+			free(kd);
+			return NULL;
+		}
+	}
+	close(fd);
+	/*
+	 * The dictionary made by other version is not used.
+	 */
+	if (memcmp(kd->map, KEYDICT_MAGIC, strlen(KEYDICT_MAGIC))) {
+		keydict_close(kd);
+		return NULL;
+	}
+	table = (const unsigned char *)kd->map + KEYDICT_HEADER;
+	offset = get_number(table + section * 8);
+	size = get_number(table + section * 8 + 4);
+	if (offset == 0 || offset + size > kd->mapsize || size < 8) {
+		keydict_close(kd);
+		return NULL;
+	}
+	kd->section = (const unsigned char *)kd->map + offset;
+	kd->size = size;
+	kd->count = get_number(kd->section);
+	kd->nblocks = get_number(kd->section + 4);
+	kd->key = strbuf_open(0);
+	return kd;
+}
+/*
+ * keydict_open: open a section of the key dictionary.
+ *
+ *	i)	dbpath	dbpath directory
+ *	i)	section	KEYDICT_SOURCE, GTAGS, GRTAGS, GSYMS, KEYDICT_OTHER
+ *	r)		KEYDICT structure
+ *			NULL: the section is not available or out of date
+ *
+ * The dictionary which is older than the tag files is not used.
+ * The GRTAGS and GSYMS sections are not used either unless the dictionary
+ * was made from the current generation of the tag files.
+ */
+KEYDICT *
+keydict_open(const char *dbpath, int section)
+{
+	KEYDICT *kd;
+	struct stat st, tag;
+	int db;
+
+	if (section < 0 || section >= KEYDICT_SECTIONS)
+		return NULL;
+	if (stat(makepath(dbpath, KEYDICT_NAME, NULL), &st) < 0)
+		return NULL;
+	for (db = GPATH; db <= GRTAGS; db++) {
+		if (stat(makepath(dbpath, dbname(db), NULL), &tag) < 0) {
+			if (db == GRTAGS)
+				continue;
+			return NULL;
+		}
+		if (tag.st_mtime > st.st_mtime)
+			return NULL;
+	}
+	if ((kd = load(dbpath, section)) == NULL)
+		return NULL;
+	if ((section == GRTAGS || section == GSYMS) &&
+	    get_number((const unsigned char *)kd->map + strlen(KEYDICT_MAGIC)) != generation(dbpath)) {
+		keydict_close(kd);
+		return NULL;
+	}
+	return kd;
+}
+/*
+ * keydict_first: get the first key which has the prefix.
+ *
+ *	i)	kd	KEYDICT structure
+ *	i)	prefix	prefix (NULL: all keys)
+ *	r)		key
+ *			NULL: not found
+ */
+const char *
+keydict_first(KEYDICT *kd, const char *prefix)
+{
+	const char *key;
+	unsigned long lo, hi;
+
+	if (prefix && *prefix == '\0')
+		prefix = NULL;
+	kd->prefix = prefix;
+	kd->prefixlen = prefix ? strlen(prefix) : 0;
+	kd->single = 0;
+	kd->block = 0;
+	kd->rest = 0;
+	kd->p = NULL;
+	if (kd->nblocks == 0)
+		return NULL;
+	/*
+	 * Find the last block whose first key is less than the prefix.
+	 * The first key which has the prefix is in that block or the next.
+	 */
+	if (prefix) {
+		lo = 0;
+		hi = kd->nblocks;
+		while (hi - lo > 1) {
+			unsigned long mid = (lo + hi) / 2;
+			const char *head = (const char *)kd->section + get_number(kd->section + 8 + mid * 4);
+
+			if (strcmp(head, prefix) < 0)
+				lo = mid;
+			else
+				hi = mid;
+		}
+		kd->block = lo;
+	}
+	kd->p = kd->section + get_number(kd->section + 8 + kd->block * 4);
+	kd->rest = (kd->block == kd->nblocks - 1) ? kd->count - kd->block * KEYDICT_BLOCK : KEYDICT_BLOCK;
+	strbuf_reset(kd->key);
+	while ((key = read_key(kd)) != NULL) {
+		if (prefix == NULL || strcmp(key, prefix) >= 0)
+			break;
+	}
+	if (key && prefix && strncmp(key, prefix, kd->prefixlen))
+		key = NULL;
+	return key;
+}
+/*
+ * keydict_mask: get the mask of a block.
+ *
+ *	i)	kd	KEYDICT structure
+ *	i)	block	block number
+ *	r)		mask (See fuzzy.c)
+ */
+unsigned int
+keydict_mask(KEYDICT *kd, unsigned long block)
+{
+	return get_number(kd->section + 8 + kd->nblocks * 4 + block * 4);
+}
+/*
+ * keydict_block: get the first key of a block.
+ *
+ *	i)	kd	KEYDICT structure
+ *	i)	block	block number
+ *	r)		key
+ *			NULL: no such block
+ *
+ * The following keydict_next() returns the rest of the block.
+ */
+const char *
+keydict_block(KEYDICT *kd, unsigned long block)
+{
+	kd->prefix = NULL;
+	kd->prefixlen = 0;
+	kd->single = 1;
+	kd->rest = 0;
+	kd->p = NULL;
+	if (block >= kd->nblocks)
+		return NULL;
+	kd->block = block;
+	kd->p = kd->section + get_number(kd->section + 8 + block * 4);
+	kd->rest = (block == kd->nblocks - 1) ? kd->count - block * KEYDICT_BLOCK : KEYDICT_BLOCK;
+	strbuf_reset(kd->key);
+	return read_key(kd);
+}
+/*
+ * keydict_next: get the next key which has the prefix.
+ *
+ *	i)	kd	KEYDICT structure
+ *	r)		key
+ *			NULL: end of keys
+ */
+const char *
+keydict_next(KEYDICT *kd)
+{
+	const char *key = read_key(kd);
+
+	if (key && kd->prefix && strncmp(key, kd->prefix, kd->prefixlen))
+		key = NULL;
+	if (key == NULL) {
+		/* read no more */
+		kd->block = kd->nblocks;
+		kd->rest = 0;
+	}
+	return key;
+}
+/*
+ * read_key: read the next key.
+ */
+static const char *
+read_key(KEYDICT *kd)
+{
+	const unsigned char *p;
+
+	if (kd->rest == 0) {
+		if (kd->p == NULL || kd->single || ++kd->block >= kd->nblocks)
+			return NULL;
+		kd->p = kd->section + get_number(kd->section + 8 + kd->block * 4);
+		kd->rest = (kd->block == kd->nblocks - 1) ? kd->count - kd->block * KEYDICT_BLOCK : KEYDICT_BLOCK;
+		strbuf_reset(kd->key);
+	}
+	p = kd->p;
+	if (strbuf_getlen(kd->key) > 0) {
+		unsigned long shared = 0;
+		int shift = 0;
+
+		do {
+			shared |= (unsigned long)(*p & 0x7f) << shift;
+			shift += 7;
+		} while (*p++ & 0x80);
+		strbuf_setlen(kd->key, shared);
+	}
+	strbuf_puts(kd->key, (const char *)p);
+	kd->p = p + strlen((const char *)p) + 1;
+	kd->rest--;
+	return strbuf_value(kd->key);
+}
+/*
+ * keydict_close: close KEYDICT structure.
+ *
+ *	i)	kd	KEYDICT structure
+ */
+void
+keydict_close(KEYDICT *kd)
+{
+#ifdef USE_MMAP
+	if (kd->mapped)
+		munmap(kd->map, kd->mapsize);
+	else
+#endif
+		free(kd->map);
+	if (kd->key)
+		strbuf_close(kd->key);
+	free(kd);
+}
@@ -0,0 +1,64 @@
+/*
+ * Copyright (c) 2012 Tama Communications Corporation
+ *
+ * This file is part of GNU GLOBAL.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _KEYDICT_H
+#define _KEYDICT_H
+
+#include "strbuf.h"
+#include "strhash.h"
+
+#define KEYDICT_NAME	"GKEYS"
+
+/*
+ * Sections of the key dictionary.
+ * GTAGS, GRTAGS and GSYMS are also used as section numbers.
+ */
+#define KEYDICT_SOURCE		0	/* path names of source files */
+#define KEYDICT_OTHER		4	/* path names of other files */
+#define KEYDICT_SECTIONS	5
+
+typedef struct {
+	char *map;			/* image of the dictionary file */
+	unsigned long mapsize;		/* size of the image */
+	int mapped;			/* 1: mapped by mmap(2) */
+	const unsigned char *section;	/* start of the section */
+	unsigned long size;		/* size of the section */
+	unsigned long count;		/* number of keys */
+	unsigned long nblocks;		/* number of blocks */
+	/* cursor */
+	const unsigned char *p;		/* next key */
+	unsigned long block;		/* current block */
+	int rest;			/* rest of keys in the current block */
+	int single;			/* 1: read only the current block */
+	const char *prefix;		/* prefix (NULL: all keys) */
+	int prefixlen;			/* length of the prefix */
+	STRBUF *key;			/* current key */
+} KEYDICT;
+
+void keydict_make(const char *);
+int keydict_current(const char *);
+void keydict_update(const char *, STRHASH *);
+KEYDICT *keydict_open(const char *, int);
+const char *keydict_first(KEYDICT *, const char *);
+const char *keydict_next(KEYDICT *);
+unsigned int keydict_mask(KEYDICT *, unsigned long);
+const char *keydict_block(KEYDICT *, unsigned long);
+void keydict_close(KEYDICT *);
+
+#endif /* ! _KEYDICT_H */
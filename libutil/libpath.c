@@ -0,0 +1,236 @@
+/*
+ * Copyright (c) 2012 Tama Communications Corporation
+ *
+ * This file is part of GNU GLOBAL.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+#include <stdio.h>
+#ifdef STDC_HEADERS
+#include <stdlib.h>
+#endif
+#ifdef HAVE_STRING_H
+#include <string.h>
+#else
+#include <strings.h>
+#endif
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+#if defined(HAVE_PTHREAD_H) && defined(HAVE_PTHREAD)
+#include <pthread.h>
+#define USE_THREADS
+#endif
+
+#include "checkalloc.h"
+#include "die.h"
+#include "getdbpath.h"
+#include "gtagsop.h"
+#include "libpath.h"
+#include "locatestring.h"
+#include "makepath.h"
+#include "path.h"
+#include "strbuf.h"
+#include "strlimcpy.h"
+#include "varray.h"
+
+/*
+ * Library trees (GTAGSLIBPATH)
+ *
+ * The list of library trees is made at the first call and kept until
+ * libpath_close() is called.
+ *
+ * Before searching the library trees, the caller probes them with the key.
+ * Probing is done concurrently, and a tree which doesn't have the key
+ * need not be searched. The caller searches the rest in the order of
+ * GTAGSLIBPATH, so that the output is not changed by the concurrency.
+ * The GTAGS handles opened for probing are kept for the next probe,
+ * but the search opens the tag files of the tree again with gtags_open().
+ */
+#define LIBPATH_MAXJOBS	16		/* max number of worker threads */
+
+static VARRAY *vb;			/* array of LIBTREE */
+static char *current;			/* dbpath of the current project */
+static char *libpath;			/* value of GTAGSLIBPATH */
+static const char *probe_key;
+static int probe_prefix;
+
+static void probe(LIBTREE *);
+
+/*
+ * libpath_open: get the list of library trees.
+ *
+ *	i)	dbpath	dbpath of the current project
+ *	o)	trees	array of LIBTREE
+ *	r)		number of trees
+ *
+ * The current project is excluded from the list.
+ */
+int
+libpath_open(const char *dbpath, LIBTREE **trees)
+{
+	const char *env = getenv("GTAGSLIBPATH");
+
+	if (env == NULL)
+		env = "";
+	if (vb != NULL && (strcmp(current, dbpath) || strcmp(libpath, env)))
+		libpath_close();
+	if (vb == NULL) {
+		STRBUF *sb = strbuf_open(0);
+		char libdbpath[MAXPATHLEN];
+		char *libdir, *nextp = NULL;
+
+		vb = varray_open(sizeof(LIBTREE), 8);
+		current = check_strdup(dbpath);
+		libpath = check_strdup(env);
+		strbuf_puts(sb, env);
+		for (libdir = strbuf_value(sb); libdir; libdir = nextp) {
+			LIBTREE *t;
+
+			if ((nextp = locatestring(libdir, PATHSEP, MATCH_FIRST)) != NULL)
+				*nextp++ = 0;
+			if (!gtagsexist(libdir, libdbpath, sizeof(libdbpath), 0))
+				continue;
+			if (!strcmp(dbpath, libdbpath))
+				continue;
+			t = varray_append(vb);
+			strlimcpy(t->root, libdir, sizeof(t->root));
+			strlimcpy(t->dbpath, libdbpath, sizeof(t->dbpath));
+			strlimcpy(t->gtags, makepath(libdbpath, dbname(GTAGS), NULL), sizeof(t->gtags));
+			t->dbop = NULL;
+			t->failed = 0;
+			t->status = LIBPATH_UNKNOWN;
+		}
+		strbuf_close(sb);
+	}
+	*trees = varray_assign(vb, 0, 0);
+	return vb->length;
+}
+/*
+ * libpath_probe: probe library trees with a key.
+ *
+ *	i)	key	tag name
+ *			NULL: every tree should be searched
+ *	i)	prefix	1: the key is a prefix
+ *
+ * The status of each tree is set to LIBPATH_HIT, LIBPATH_MISS
+ * or LIBPATH_UNKNOWN.
+ */
+#ifdef USE_THREADS
+static void *
+probe_worker(void *arg)
+{
+	int i, jobs = (int)((long)arg >> 16), k = (int)((long)arg & 0xffff);
+	LIBTREE *trees = varray_assign(vb, 0, 0);
+
+	for (i = k; i < vb->length; i += jobs)
+		probe(&trees[i]);
+	return NULL;
+}
+#endif
+void
+libpath_probe(const char *key, int prefix)
+{
+	LIBTREE *trees;
+	int i;
+
+	if (vb == NULL || vb->length == 0)
+		return;
+	trees = varray_assign(vb, 0, 0);
+	if (key == NULL || *key == '\0') {
+		for (i = 0; i < vb->length; i++)
+			trees[i].status = LIBPATH_UNKNOWN;
+		return;
+	}
+	probe_key = key;
+	probe_prefix = prefix;
+#ifdef USE_THREADS
+	if (vb->length > 1) {
+		pthread_t threads[LIBPATH_MAXJOBS];
+		const char *p = getenv("GTAGSJOBS");
+		int jobs = vb->length;
+
+		if (p != NULL && atoi(p) > 0 && atoi(p) < jobs)
+			jobs = atoi(p);
+		if (jobs > LIBPATH_MAXJOBS)
+			jobs = LIBPATH_MAXJOBS;
+		/*
+		 * If a thread cannot be created, the rest is done by this thread.
+		 */
+		for (i = 0; i < jobs; i++)
+			if (pthread_create(&threads[i], NULL, probe_worker, (void *)(((long)jobs << 16) | i)) != 0)
+				break;
+		if (i < jobs) {
+			int created = i;
+
+			for (i = 0; i < vb->length; i++)
+				if (i % jobs >= created)
+					probe(&trees[i]);
+			jobs = created;
+		}
+		for (i = 0; i < jobs; i++)
+			pthread_join(threads[i], NULL);
+		return;
+	}
+#endif
+	for (i = 0; i < vb->length; i++)
+		probe(&trees[i]);
+}
+/*
+ * probe: probe a library tree.
+ *
+ * This may be called by worker threads. It must not touch static data
+ * other than the tree given. The access counters of dbop and mpool are
+ * kept in each handle, and are added to the totals by libpath_close().
+ */
+static void
+probe(LIBTREE *t)
+{
+	if (t->dbop == NULL && !t->failed) {
+		t->dbop = dbop_open(t->gtags, 0, 0, 0);
+		if (t->dbop == NULL)
+			t->failed = 1;
+	}
+	if (t->dbop == NULL)
+		t->status = LIBPATH_UNKNOWN;
+	else if (dbop_first(t->dbop, probe_key, NULL, probe_prefix ? DBOP_PREFIX : 0) != NULL)
+		t->status = LIBPATH_HIT;
+	else
+		t->status = LIBPATH_MISS;
+}
+/*
+ * libpath_close: close library trees.
+ */
+void
+libpath_close(void)
+{
+	LIBTREE *trees;
+	int i;
+
+	if (vb == NULL)
+		return;
+	trees = varray_assign(vb, 0, 0);
+	for (i = 0; i < vb->length; i++)
+		if (trees[i].dbop)
+			dbop_close(trees[i].dbop);
+	varray_close(vb);
+	free(current);
+	free(libpath);
+	vb = NULL;
+	current = libpath = NULL;
+}
@@ -0,0 +1,46 @@
+/*
+ * Copyright (c) 2012 Tama Communications Corporation
+ *
+ * This file is part of GNU GLOBAL.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _LIBPATH_H_
+#define _LIBPATH_H_
+
+#include "dbop.h"
+#include "gparam.h"
+
+/*
+ * Result of probing.
+ */
+#define LIBPATH_UNKNOWN	0		/* the tree should be searched */
+#define LIBPATH_HIT	1		/* the tree has the key */
+#define LIBPATH_MISS	2		/* the tree doesn't have the key */
+
+typedef struct {
+	char root[MAXPATHLEN];		/* root directory of the tree */
+	char dbpath[MAXPATHLEN];	/* dbpath directory of the tree */
+	char gtags[MAXPATHLEN];		/* path of GTAGS */
+	DBOP *dbop;			/* cached handle of GTAGS */
+	int failed;			/* 1: GTAGS cannot be opened */
+	int status;			/* result of the last probing */
+} LIBTREE;
+
+int libpath_open(const char *, LIBTREE **);
+void libpath_probe(const char *, int);
+void libpath_close(void);
+
+#endif /* ! _LIBPATH_H_ */
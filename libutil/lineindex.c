@@ -0,0 +1,228 @@
+/*
+ * Copyright (c) 2012 Tama Communications Corporation
+ *
+ * This file is part of GNU GLOBAL.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <stdio.h>
+#ifdef STDC_HEADERS
+#include <stdlib.h>
+#endif
+#ifdef HAVE_STRING_H
+#include <string.h>
+#else
+#include <strings.h>
+#endif
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+#ifdef HAVE_FCNTL_H
+#include <fcntl.h>
+#else
+#include <sys/file.h>
+#endif
+
+#include "checkalloc.h"
+#include "gpathop.h"
+#include "lineindex.h"
+#include "strbuf.h"
+
+#ifndef O_BINARY
+#define O_BINARY 0
+#endif
+
+/*
+ * Line index: offset table of lines of a source file.
+ *
+ * The compact format tag files (GRTAGS, and GTAGS made by 'gtags -c')
+ * don't have line images. So, global(1) has to pick up them from
+ * the source files. Without the line index, it reads a source file
+ * line by line until the line number is reached.
+ * With the line index, it reads only the required line using pread(2).
+ *
+ * The line index is made by gtags(1) and is stored in GPATH
+ * with the file id of the source file. (See gpathop.c)
+ *
+ *	<size> <mtime>\0<length of line 1><length of line 2>...
+ *
+ * <size> and <mtime> are the size and the modification time of the source
+ * file. They are used to detect modification after making the index.
+ * The length of each line includes the newline character, and is written
+ * in variable length format: 7 bits per byte, lower bits first,
+ * and the highest bit of a byte is set except for the last byte.
+ */
+#define LINEINDEX_BUFSIZE	65536
+
+static void put_length(STRBUF *, unsigned long);
+/*
+ * put_length: put length of a line in variable length format.
+ */
+static void
+put_length(STRBUF *sb, unsigned long length)
+{
+	while (length >= 0x80) {
+		strbuf_putc(sb, (length & 0x7f) | 0x80);
+		length >>= 7;
+	}
+	strbuf_putc(sb, length);
+}
+/*
+ * lineindex_put: make line index of a source file and put it to GPATH.
+ *
+ *	i)	path	path name of the source file
+ *	i)	fid	file id of the source file
+ *
+ * GPATH should be opened with writing mode.
+ * If the file cannot be read then the line index is not made.
+ */
+void
+lineindex_put(const char *path, const char *fid)
+{
+	STATIC_STRBUF(sb);
+	struct stat st;
+	char header[64], *buf;
+	unsigned long length = 0;
+	int fd, n;
+
+	if ((fd = open(path, O_RDONLY|O_BINARY)) < 0)
+		return;
+	if (fstat(fd, &st) < 0) {
+		close(fd);
+		return;
+	}
+	snprintf(header, sizeof(header), "%ld %ld", (long)st.st_size, (long)st.st_mtime);
+	strbuf_clear(sb);
+	strbuf_puts0(sb, header);
+	buf = check_malloc(LINEINDEX_BUFSIZE);
+	while ((n = read(fd, buf, LINEINDEX_BUFSIZE)) > 0) {
+		const char *p = buf, *end = buf + n, *nl;
+
+		while ((nl = memchr(p, '\n', end - p)) != NULL) {
+			put_length(sb, length + (nl - p) + 1);
+			length = 0;
+			p = nl + 1;
+		}
+		length += end - p;
+	}
+	if (length > 0)				/* last line without newline */
+		put_length(sb, length);
+	free(buf);
+	close(fd);
+	if (n == 0)
+		gpath_putlines(fid, strbuf_value(sb), strbuf_getlen(sb));
+}
+/*
+ * lineindex_open: open line index of a source file.
+ *
+ *	i)	path	path name of the source file
+ *	i)	fid	file id of the source file
+ *	r)		LINEINDEX structure
+ *			NULL: the line index is not available or out of date.
+ */
+LINEINDEX *
+lineindex_open(const char *path, const char *fid)
+{
+	LINEINDEX *li;
+	struct stat st;
+	const unsigned char *p, *end;
+	const char *dat;
+	long size, mtime;
+	off_t offset = 0;
+	int len, fd, count;
+
+	if ((dat = gpath_getlines(fid, &len)) == NULL)
+		return NULL;
+	if (sscanf(dat, "%ld %ld", &size, &mtime) != 2)
+		return NULL;
+	if ((fd = open(path, O_RDONLY|O_BINARY)) < 0)
+		return NULL;
+	if (fstat(fd, &st) < 0 || st.st_size != size || st.st_mtime != mtime) {
+		close(fd);
+		return NULL;
+	}
+	p = (const unsigned char *)dat + strlen(dat) + 1;
+	end = (const unsigned char *)dat + len;
+	li = (LINEINDEX *)check_malloc(sizeof(LINEINDEX));
+	/*
+	 * The length of each line needs one byte at least.
+	 */
+	li->offset = (off_t *)check_malloc((end - p + 1) * sizeof(off_t));
+	for (count = 0; p < end; count++) {
+		unsigned long length = 0;
+		int shift = 0;
+
+		li->offset[count] = offset;
+		do {
+			length |= (unsigned long)(*p & 0x7f) << shift;
+			shift += 7;
+		} while (*p++ & 0x80 && p < end);
+		offset += length;
+	}
+	li->offset[count] = offset;
+	li->count = count;
+	li->fd = fd;
+	li->ib = strbuf_open(0);
+	return li;
+}
+/*
+ * lineindex_read: read a line.
+ *
+ *	i)	li	LINEINDEX structure
+ *	i)	lineno	line number
+ *	r)		line image without newline
+ *			NULL: no such line
+ */
+const char *
+lineindex_read(LINEINDEX *li, int lineno)
+{
+	off_t start;
+	int length, n;
+	char *line;
+
+	if (lineno < 1 || lineno > li->count)
+		return NULL;
+	start = li->offset[lineno - 1];
+	length = li->offset[lineno] - start;
+	strbuf_reset(li->ib);
+	strbuf_nputc(li->ib, 0, length);
+	line = strbuf_value(li->ib);
+	if ((n = pread(li->fd, line, length, start)) < 0)
+		return NULL;
+	if (n > 0 && line[n - 1] == '\n')
+		n--;
+	if (n > 0 && line[n - 1] == '\r')
+		n--;
+	line[n] = '\0';
+	return line;
+}
+/*
+ * lineindex_close: close line index.
+ *
+ *	i)	li	LINEINDEX structure
+ */
+void
+lineindex_close(LINEINDEX *li)
+{
+	close(li->fd);
+	strbuf_close(li->ib);
+	free(li->offset);
+	free(li);
+}
@@ -0,0 +1,38 @@
+/*
+ * Copyright (c) 2012 Tama Communications Corporation
+ *
+ * This file is part of GNU GLOBAL.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _LINEINDEX_H
+#define _LINEINDEX_H
+
+#include <sys/types.h>
+#include "strbuf.h"
+
+typedef struct {
+	int fd;			/* file descriptor of the source file */
+	int count;		/* number of lines */
+	off_t *offset;		/* offset[n - 1]: start of line n */
+	STRBUF *ib;		/* line buffer */
+} LINEINDEX;
+
+void lineindex_put(const char *, const char *);
+LINEINDEX *lineindex_open(const char *, const char *);
+const char *lineindex_read(LINEINDEX *, int);
+void lineindex_close(LINEINDEX *);
+
+#endif /* ! _LINEINDEX_H */
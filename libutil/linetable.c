@@ -20,6 +20,8 @@
 #ifdef HAVE_CONFIG_H
 #include <config.h>
 #endif
+#include <sys/types.h>
+#include <sys/stat.h>
 #ifdef STDC_HEADERS
 #include <stdlib.h>
 #endif
@@ -28,18 +30,30 @@
 #else
 #include <strings.h>
 #endif
-#include <sys/stat.h>
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+#ifdef HAVE_FCNTL_H
+#include <fcntl.h>
+#else
+#include <sys/file.h>
+#endif
+#if defined(HAVE_SYS_MMAN_H) && defined(HAVE_MMAP)
+#include <sys/mman.h>
+#define USE_MMAP
+#endif
 
+#include "checkalloc.h"
 #include "die.h"
 #include "linetable.h"
+#include "tab.h"
 #include "varray.h"
-#include "strbuf.h"
 
 /* File buffer */
 #define EXPAND 1024
-static STRBUF *ib;
 static char *filebuf;
 static int filesize;
+static int mapped;			/* 1: filebuf is mapped */
 
 /* File pointer */
 static char *curp;
@@ -55,34 +69,62 @@ static void linetable_put(int, int);
  *	i)	path	path
  *	r)		0: normal
  *			-1: cannot open file.
+ *
+ * The file is mapped into memory if possible. Since the callers may
+ * put '\0' at the end of a line temporarily and expect that the last
+ * line is terminated, the file which doesn't end with newline is read
+ * into a buffer with '\0' instead.
  */
 int
 linetable_open(const char *path)
 {
-	FILE *ip;
 	struct stat sb;
-	int lineno, offset;
+	char *p, *nl;
+	int fd, lineno;
 
-	if (stat(path, &sb) < 0)
+	if ((fd = open(path, O_RDONLY)) < 0)
 		return -1;
-	ib = strbuf_open(sb.st_size);
-	vb = varray_open(sizeof(int), EXPAND);
-	if ((ip = fopen(path, "r")) == NULL)
+	if (fstat(fd, &sb) < 0) {
+		close(fd);
 		return -1;
-	lineno = 1;
-	offset = 0;
-	for (offset = 0;
-		(strbuf_fgets(ib, ip, STRBUF_APPEND), offset != strbuf_getlen(ib));
-		offset = strbuf_getlen(ib))
+	}
+	filesize = sb.st_size;
+	mapped = 0;
+#ifdef USE_MMAP
+	if (filesize > 0) {
+		filebuf = mmap(NULL, filesize, PROT_READ|PROT_WRITE, MAP_PRIVATE, fd, 0);
+		if (filebuf != MAP_FAILED) {
+			if (filebuf[filesize - 1] == '\n')
+				mapped = 1;
+			else
+				munmap(filebuf, filesize);
+		}
+	}
+	if (!mapped)
+#endif
 	{
-		linetable_put(offset, lineno++);
+		int n, count = 0;
+
+		filebuf = check_malloc(filesize + 1);
+		while (count < filesize && (n = read(fd, filebuf + count, filesize - count)) > 0)
+			count += n;
+		filesize = count;
+		filebuf[filesize] = '\0';
 	}
-	fclose(ip);
-	curp = filebuf = strbuf_value(ib);
-	filesize = offset;
+	close(fd);
+	curp = filebuf;
 	endp = filebuf + filesize;
-	/* strbuf_close(ib); */
-
+	/*
+	 * Make the offset table. Memchr(3) is usually faster than
+	 * looking at each character.
+	 */
+	vb = varray_open(sizeof(int), EXPAND);
+	lineno = 1;
+	for (p = filebuf; p < endp; p = nl + 1) {
+		linetable_put(p - filebuf, lineno++);
+		if ((nl = memchr(p, '\n', endp - p)) == NULL)
+			break;
+	}
 	return 0;
 }
 /*
@@ -107,6 +149,22 @@ linetable_read(char *buf, int size)
 
 	return size;
 }
+/*
+ * linetable_read_detabing: read linetable converting tabs into spaces.
+ *
+ *	o)	buf	read buffer
+ *	i)	size	buffer size
+ *	o)	dest_saved	current column in 'buf'
+ *	o)	spaces_saved	left spaces
+ *	r)		size of data (0: end of file)
+ *
+ * This is the same as read_file_detabing() except for the input.
+ */
+int
+linetable_read_detabing(char *buf, int size, int *dest_saved, int *spaces_saved)
+{
+	return read_buffer_detabing(buf, size, (const char **)&curp, endp, dest_saved, spaces_saved);
+}
 /*
  * linetable_put: put a line into table.
  *
@@ -150,7 +208,13 @@ void
 linetable_close(void)
 {
 	varray_close(vb);
-	strbuf_close(ib);
+#ifdef USE_MMAP
+	if (mapped)
+		munmap(filebuf, filesize);
+	else
+#endif
+		free(filebuf);
+	filebuf = curp = endp = NULL;
 }
 /*
  * linetable_print: print a line.
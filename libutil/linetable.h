@@ -23,6 +23,7 @@
 
 int linetable_open(const char *);
 int linetable_read(char *, int);
+int linetable_read_detabing(char *, int, int *, int *);
 char *linetable_get(int, int *);
 void linetable_close(void);
 void linetable_print(FILE *, int);
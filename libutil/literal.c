@@ -0,0 +1,259 @@
+/*
+ * Copyright (c) 2012 Tama Communications Corporation
+ *
+ * This file is part of GNU GLOBAL.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+#include <ctype.h>
+#ifdef STDC_HEADERS
+#include <stdlib.h>
+#endif
+#ifdef HAVE_STRING_H
+#include <string.h>
+#else
+#include <strings.h>
+#endif
+
+#include "checkalloc.h"
+#include "literal.h"
+#include "strbuf.h"
+
+/*
+ * Literal search using Boyer-Moore-Horspool algorithm.
+ *
+ * Unlike locatestring(), the text need not be terminated by '\0'.
+ * So, it can be applied to a whole file image at once.
+ */
+#define FOLD(c)	(icase ? tolower(c) : (c))
+
+/*
+ * literal_open: compile a literal pattern
+ *
+ *	i)	pattern	pattern
+ *	i)	icase	1: ignore case
+ *	r)		LITERAL structure
+ */
+LITERAL *
+literal_open(const char *pattern, int icase)
+{
+	LITERAL *lit = (LITERAL *)check_malloc(sizeof(LITERAL));
+	int i;
+
+	lit->length = strlen(pattern);
+	lit->icase = icase;
+	lit->pattern = (unsigned char *)check_strdup(pattern);
+	for (i = 0; i < lit->length; i++)
+		lit->pattern[i] = FOLD(lit->pattern[i]);
+	for (i = 0; i < 256; i++)
+		lit->skip[i] = lit->length;
+	for (i = 0; i < lit->length - 1; i++) {
+		lit->skip[lit->pattern[i]] = lit->length - 1 - i;
+		if (icase)
+			lit->skip[toupper(lit->pattern[i])] = lit->length - 1 - i;
+	}
+	return lit;
+}
+/*
+ * literal_search: search the pattern in text
+ *
+ *	i)	lit	LITERAL structure
+ *	i)	text	start of text
+ *	i)	end	end of text
+ *	r)		pointer to the first occurrence
+ *			NULL: not found
+ */
+const char *
+literal_search(const LITERAL *lit, const char *text, const char *end)
+{
+	const unsigned char *p = (const unsigned char *)text;
+	const unsigned char *last = (const unsigned char *)end - lit->length;
+	const unsigned char *pat = lit->pattern;
+	const int icase = lit->icase;
+	int m = lit->length - 1;
+	int i;
+
+	if (lit->length == 0)
+		return text;
+	if (end - text < lit->length)
+		return NULL;
+	/*
+	 * memchr(3) is usually faster than anything else for one character.
+	 */
+	if (lit->length == 1 && !(icase && isalpha(pat[0])))
+		return memchr(text, pat[0], end - text);
+	while (p <= last) {
+		if (FOLD(p[m]) == pat[m]) {
+			for (i = m - 1; i >= 0 && FOLD(p[i]) == pat[i]; i--)
+				;
+			if (i < 0)
+				return (const char *)p;
+		}
+		p += lit->skip[p[m]];
+	}
+	return NULL;
+}
+/*
+ * literal_close: close LITERAL structure
+ *
+ *	i)	lit	LITERAL structure
+ */
+void
+literal_close(LITERAL *lit)
+{
+	free(lit->pattern);
+	free(lit);
+}
+/*
+ * literal_from_regex: extract a literal string from regular expression
+ *
+ *	i)	pattern	regular expression
+ *	i)	basic	1: basic regular expression, 0: extended
+ *	i)	icase	1: ignore case
+ *	r)		the longest literal string which every matched line has
+ *			NULL: not found
+ *
+ * The result is used as a prefilter. So, it should be conservative:
+ * if the regular expression has alternation, nothing is extracted,
+ * and characters in a group or followed by a quantifier are ignored.
+ * The returned string should be freed by the caller.
+ */
+char *
+literal_from_regex(const char *pattern, int basic, int icase)
+{
+	STRBUF *run = strbuf_open(0);
+	STRBUF *best = strbuf_open(0);
+	const char *p;
+	char *result = NULL;
+	int depth = 0;
+
+#define END_OF_RUN() do {							\
+		if (strbuf_getlen(run) > strbuf_getlen(best)) {			\
+			strbuf_reset(best);					\
+			strbuf_puts(best, strbuf_value(run));			\
+		}								\
+		strbuf_reset(run);						\
+	} while (0)
+	/*
+	 * Alternation.
+	 */
+	if (basic ? strstr(pattern, "\\|") != NULL : strchr(pattern, '|') != NULL)
+		goto out;
+	for (p = pattern; *p; p++) {
+		int c = (unsigned char)*p;
+		int quantified = 0;
+
+		if (c == '[') {
+			END_OF_RUN();
+			/*
+			 * Skip bracket expression.
+			 */
+			p++;
+			if (*p == '^')
+				p++;
+			if (*p == ']')
+				p++;
+			for (; *p && *p != ']'; p++) {
+				if (*p == '[' && (p[1] == ':' || p[1] == '.' || p[1] == '=')) {
+					const char *q = strchr(p + 2, ']');
+					if (q == NULL)
+						goto out;
+					p = q;
+				}
+			}
+			if (*p == '\0')
+				goto out;
+			continue;
+		}
+		if (c == '\\') {
+			END_OF_RUN();
+			if (p[1] == '\0')
+				goto out;
+			p++;
+			if (basic && *p == '(')
+				depth++;
+			else if (basic && *p == ')')
+				depth--;
+			else if (basic && *p == '{') {
+				/*
+				 * Skip interval expression.
+				 */
+				if ((p = strstr(p, "\\}")) == NULL)
+					goto out;
+				p++;
+			}
+			continue;
+		}
+		if (!basic && c == '{') {
+			END_OF_RUN();
+			if ((p = strchr(p, '}')) == NULL)
+				goto out;
+			continue;
+		}
+		if (!basic && c == '(') {
+			END_OF_RUN();
+			depth++;
+			continue;
+		}
+		if (!basic && c == ')') {
+			END_OF_RUN();
+			depth--;
+			continue;
+		}
+		if (c == '.' || c == '^' || c == '$' || c == '*'
+		    || (!basic && (c == '+' || c == '?'))) {
+			END_OF_RUN();
+			continue;
+		}
+		/*
+		 * Ordinary character.
+		 */
+		if (depth > 0)
+			continue;
+		/*
+		 * Case folding of multibyte characters is not predictable.
+		 */
+		if (icase && c >= 0x80) {
+			END_OF_RUN();
+			continue;
+		}
+		if (p[1] == '*')
+			quantified = 1;
+		else if (basic && p[1] == '\\' && (p[2] == '{' || p[2] == '?' || p[2] == '+'))
+			quantified = 1;
+		else if (!basic && (p[1] == '?' || p[1] == '{' || p[1] == '+'))
+			quantified = 1;
+		if (quantified) {
+			/*
+			 * 'a+' requires 'a', but the run cannot continue after it.
+			 */
+			if (p[1] == '+' || (basic && p[1] == '\\' && p[2] == '+'))
+				strbuf_putc(run, c);
+			END_OF_RUN();
+			continue;
+		}
+		strbuf_putc(run, c);
+	}
+	END_OF_RUN();
+	if (strbuf_getlen(best) > 0)
+		result = check_strdup(strbuf_value(best));
+out:
+	strbuf_close(run);
+	strbuf_close(best);
+	return result;
+}
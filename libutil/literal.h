@@ -0,0 +1,35 @@
+/*
+ * Copyright (c) 2012 Tama Communications Corporation
+ *
+ * This file is part of GNU GLOBAL.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _LITERAL_H
+#define _LITERAL_H
+
+typedef struct {
+	unsigned char *pattern;		/* pattern (folded if icase) */
+	int length;			/* length of pattern */
+	int icase;			/* ignore case */
+	int skip[256];			/* shift table */
+} LITERAL;
+
+LITERAL *literal_open(const char *, int);
+const char *literal_search(const LITERAL *, const char *, const char *);
+void literal_close(LITERAL *);
+char *literal_from_regex(const char *, int, int);
+
+#endif /* ! _LITERAL_H */
@@ -29,6 +29,9 @@
 #else
 #include <strings.h>
 #endif
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
 
 #include "abs2rel.h"
 #include "checkalloc.h"
@@ -46,6 +49,21 @@ static int encoding;
 static int newline = '\n';
 
 #define required_encode(c) encode[(unsigned char)c]
+
+/*
+ * Output buffer.
+ *
+ * Records are formatted into the output buffer of CONVERT and written
+ * by a fwrite(3) call when the buffer is full, instead of calling stdio
+ * for each field. If the output is a terminal, each record is written
+ * immediately as line buffered stdio does.
+ */
+#define CONVERT_BUFSIZE	65536
+
+static void put_padding(STRBUF *, const char *, int);
+static void put_number(STRBUF *, int, int);
+static void put_newline(CONVERT *);
+static void convert_flush(CONVERT *);
 /*
  * set_encode_chars: stores chars to be encoded.
  */
@@ -114,6 +132,14 @@ convert_pathname(CONVERT *cv, const char *path)
 	static char buf[MAXPATHLEN];
 	const char *a, *b;
 
+	/*
+	 * Since records are sorted by path name, the same path name
+	 * usually continues. The last result is reused for it.
+	 */
+	if (strbuf_getlen(cv->lastpath) > 0 && !strcmp(path, strbuf_value(cv->lastpath)))
+		return strbuf_value(cv->lastconv);
+	strbuf_reset(cv->lastpath);
+	strbuf_puts(cv->lastpath, path);
 	if (cv->type != PATH_THROUGH) {
 		/*
 		 * make absolute path name.
@@ -176,7 +202,74 @@ convert_pathname(CONVERT *cv, const char *path)
 			path = buf;
 		}
 	}
-	return (const char *)path;
+	strbuf_reset(cv->lastconv);
+	strbuf_puts(cv->lastconv, path);
+	return strbuf_value(cv->lastconv);
+}
+/*
+ * put_padding: put string and pad it with blanks.
+ *
+ *	i)	sb	output buffer
+ *	i)	s	string
+ *	i)	width	minimum width (printf("%-*s", width, s))
+ */
+static void
+put_padding(STRBUF *sb, const char *s, int width)
+{
+	const char *p = s;
+
+	while (*p)
+		p++;
+	strbuf_nputs(sb, s, p - s);
+	strbuf_nputc(sb, ' ', width - (p - s));
+}
+/*
+ * put_number: put number with right alignment.
+ *
+ *	i)	sb	output buffer
+ *	i)	n	number
+ *	i)	width	minimum width (printf("%*d", width, n))
+ */
+static void
+put_number(STRBUF *sb, int n, int width)
+{
+	char num[32], *p = num + sizeof(num);
+	unsigned int u = n < 0 ? -(unsigned int)n : (unsigned int)n;
+
+	do {
+		*--p = u % 10 + '0';
+		u /= 10;
+	} while (u);
+	if (n < 0)
+		*--p = '-';
+	strbuf_nputc(sb, ' ', width - (num + sizeof(num) - p));
+	strbuf_nputs(sb, p, num + sizeof(num) - p);
+}
+/*
+ * put_newline: terminate a record.
+ *
+ *	i)	cv	CONVERT structure
+ */
+static void
+put_newline(CONVERT *cv)
+{
+	strbuf_putc(cv->ob, newline);
+	if (cv->interactive || strbuf_getlen(cv->ob) >= CONVERT_BUFSIZE)
+		convert_flush(cv);
+}
+/*
+ * convert_flush: write the output buffer.
+ *
+ *	i)	cv	CONVERT structure
+ */
+static void
+convert_flush(CONVERT *cv)
+{
+	int len = strbuf_getlen(cv->ob);
+
+	if (len > 0 && fwrite(strbuf_value(cv->ob), 1, len, cv->op) != (size_t)len)
+		die("cannot write output.");
+	strbuf_reset(cv->ob);
 }
 /*
  * convert_open: open convert filter
@@ -211,6 +304,10 @@ convert_open(int type, int format, const char *root, const char *cwd, const char
 	cv->format = format;
 	cv->op = op;
 	cv->db = db;
+	cv->ob = strbuf_open(CONVERT_BUFSIZE + MAXBUFLEN);
+	cv->interactive = isatty(fileno(op));
+	cv->lastpath = strbuf_open(MAXPATHLEN);
+	cv->lastconv = strbuf_open(MAXPATHLEN);
 	/*
 	 * open GPATH.
 	 */
@@ -233,6 +330,7 @@ convert_put(CONVERT *cv, const char *ctags_x)
 	int tagnextc = 0;
 	char *tag = NULL, *lineno = NULL, *path, *rest = NULL;
 	const char *fid = NULL;
+	STRBUF *ob = cv->ob;
 
 	if (cv->format == FORMAT_PATH)
 		die("convert_put: internal error.");	/* Use convert_put_path() */
@@ -289,65 +387,65 @@ convert_put(CONVERT *cv, const char *ctags_x)
 	path = decode_path(path);
 	switch (cv->format) {
 	case FORMAT_CTAGS:
-		fputs(tag, cv->op);
-		fputc('\t', cv->op);
-		fputs(convert_pathname(cv, path), cv->op);
-		fputc('\t', cv->op);
-		fputs(lineno, cv->op);
+		strbuf_puts(ob, tag);
+		strbuf_putc(ob, '\t');
+		strbuf_puts(ob, convert_pathname(cv, path));
+		strbuf_putc(ob, '\t');
+		strbuf_puts(ob, lineno);
 		break;
 	case FORMAT_CTAGS_XID:
 		fid = gpath_path2fid(path, NULL);
 		if (fid == NULL)
 			die("convert_put: unknown file. '%s'", path);
-		fputs(fid, cv->op);
-		fputc(' ', cv->op);
+		strbuf_puts(ob, fid);
+		strbuf_putc(ob, ' ');
 		/* PASS THROUGH */
 	case FORMAT_CTAGS_X:
 		/*
 		 * print until path name.
 		 */
 		*tagnextp = tagnextc;
-		fputs(ctags_x, cv->op);
-		fputc(' ', cv->op);
+		strbuf_puts(ob, ctags_x);
+		strbuf_putc(ob, ' ');
 		/*
 		 * print path name and the rest.
 		 */
-		fputs(convert_pathname(cv, path), cv->op);
-		fputc(' ', cv->op);
-		fputs(rest, cv->op);
+		strbuf_puts(ob, convert_pathname(cv, path));
+		strbuf_putc(ob, ' ');
+		strbuf_puts(ob, rest);
 		break;
 	case FORMAT_CTAGS_MOD:
-		fputs(convert_pathname(cv, path), cv->op);
-		fputc('\t', cv->op);
-		fputs(lineno, cv->op);
-		fputc('\t', cv->op);
-		fputs(rest, cv->op);
+		strbuf_puts(ob, convert_pathname(cv, path));
+		strbuf_putc(ob, '\t');
+		strbuf_puts(ob, lineno);
+		strbuf_putc(ob, '\t');
+		strbuf_puts(ob, rest);
 		break;
 	case FORMAT_GREP:
-		fputs(convert_pathname(cv, path), cv->op);
-		fputc(':', cv->op);
-		fputs(lineno, cv->op);
-		fputc(':', cv->op);
-		fputs(rest, cv->op);
+		strbuf_puts(ob, convert_pathname(cv, path));
+		strbuf_putc(ob, ':');
+		strbuf_puts(ob, lineno);
+		strbuf_putc(ob, ':');
+		strbuf_puts(ob, rest);
 		break;
 	case FORMAT_CSCOPE:
-		fputs(convert_pathname(cv, path), cv->op);
-		fputc(' ', cv->op);
-		fputs(tag, cv->op);
-		fputc(' ', cv->op);
-		fputs(lineno, cv->op);
-		fputc(' ', cv->op);
+		strbuf_puts(ob, convert_pathname(cv, path));
+		strbuf_putc(ob, ' ');
+		strbuf_puts(ob, tag);
+		strbuf_putc(ob, ' ');
+		strbuf_puts(ob, lineno);
+		strbuf_putc(ob, ' ');
 		for (; *rest && isspace(*rest); rest++)
 			;
 		if (*rest)
-			fputs(rest, cv->op);
+			strbuf_puts(ob, rest);
 		else
-			fputs("<unknown>", cv->op);
+			strbuf_puts(ob, "<unknown>");
 		break;
 	default:
 		die("unknown format type.");
 	}
-	(void)fputc(newline, cv->op);
+	put_newline(cv);
 }
 /*
  * convert_put_path: convert path into relative or absolute and print.
@@ -360,8 +458,12 @@ convert_put_path(CONVERT *cv, const char *path)
 {
 	if (cv->format != FORMAT_PATH)
 		die("convert_put_path: internal error.");
-	fputs(convert_pathname(cv, path), cv->op);
-	(void)fputc(newline, cv->op);
+	if (cv->label) {
+		strbuf_puts(cv->ob, cv->label);
+		strbuf_putc(cv->ob, '\t');
+	}
+	strbuf_puts(cv->ob, convert_pathname(cv, path));
+	put_newline(cv);
 }
 /*
  * convert_put_using: convert path into relative or absolute and print.
@@ -372,20 +474,28 @@ convert_put_path(CONVERT *cv, const char *path)
  *      i)      lineno  line number
  *      i)      line    line image
  *	i)	fid	file id (only when fid != NULL)
+ *
+ * If cv->label is set, it is printed with a tab at the head of the record.
  */
 void
 convert_put_using(CONVERT *cv, const char *tag, const char *path, int lineno, const char *rest, const char *fid)
 {
+	STRBUF *ob = cv->ob;
+
+	if (cv->label) {
+		strbuf_puts(ob, cv->label);
+		strbuf_putc(ob, '\t');
+	}
 	switch (cv->format) {
 	case FORMAT_PATH:
-		fputs(convert_pathname(cv, path), cv->op);
+		strbuf_puts(ob, convert_pathname(cv, path));
 		break;
 	case FORMAT_CTAGS:
-		fputs(tag, cv->op);
-		fputc('\t', cv->op);
-		fputs(convert_pathname(cv, path), cv->op);
-		fputc('\t', cv->op);
-		fprintf(cv->op, "%d", lineno);
+		strbuf_puts(ob, tag);
+		strbuf_putc(ob, '\t');
+		strbuf_puts(ob, convert_pathname(cv, path));
+		strbuf_putc(ob, '\t');
+		put_number(ob, lineno, 0);
 		break;
 	case FORMAT_CTAGS_XID:
 		if (fid == NULL) {
@@ -393,49 +503,66 @@ convert_put_using(CONVERT *cv, const char *tag, const char *path, int lineno, co
 			if (fid == NULL)
 				die("convert_put_using: unknown file. '%s'", path);
 		}
-		fputs(fid, cv->op);
-		fputc(' ', cv->op);
+		strbuf_puts(ob, fid);
+		strbuf_putc(ob, ' ');
 		/* PASS THROUGH */
 	case FORMAT_CTAGS_X:
-		fprintf(cv->op, "%-16s %4d %-16s %s",
-			tag, lineno, convert_pathname(cv, path), rest);
+		/* "%-16s %4d %-16s %s" */
+		put_padding(ob, tag, 16);
+		strbuf_putc(ob, ' ');
+		put_number(ob, lineno, 4);
+		strbuf_putc(ob, ' ');
+		put_padding(ob, convert_pathname(cv, path), 16);
+		strbuf_putc(ob, ' ');
+		strbuf_puts(ob, rest);
 		break;
 	case FORMAT_CTAGS_MOD:
-		fputs(convert_pathname(cv, path), cv->op);
-		fputc('\t', cv->op);
-		fprintf(cv->op, "%d", lineno);
-		fputc('\t', cv->op);
-		fputs(rest, cv->op);
+		strbuf_puts(ob, convert_pathname(cv, path));
+		strbuf_putc(ob, '\t');
+		put_number(ob, lineno, 0);
+		strbuf_putc(ob, '\t');
+		strbuf_puts(ob, rest);
 		break;
 	case FORMAT_GREP:
-		fputs(convert_pathname(cv, path), cv->op);
-		fputc(':', cv->op);
-		fprintf(cv->op, "%d", lineno);
-		fputc(':', cv->op);
-		fputs(rest, cv->op);
+		strbuf_puts(ob, convert_pathname(cv, path));
+		strbuf_putc(ob, ':');
+		put_number(ob, lineno, 0);
+		strbuf_putc(ob, ':');
+		strbuf_puts(ob, rest);
 		break;
 	case FORMAT_CSCOPE:
-		fputs(convert_pathname(cv, path), cv->op);
-		fputc(' ', cv->op);
-		fputs(tag, cv->op);
-		fputc(' ', cv->op);
-		fprintf(cv->op, "%d", lineno);
-		fputc(' ', cv->op);
+		strbuf_puts(ob, convert_pathname(cv, path));
+		strbuf_putc(ob, ' ');
+		strbuf_puts(ob, tag);
+		strbuf_putc(ob, ' ');
+		put_number(ob, lineno, 0);
+		strbuf_putc(ob, ' ');
 		for (; *rest && isspace(*rest); rest++)
 			;
 		if (*rest)
-			fputs(rest, cv->op);
+			strbuf_puts(ob, rest);
 		else
-			fputs("<unknown>", cv->op);
+			strbuf_puts(ob, "<unknown>");
 		break;
 	default:
 		die("unknown format type.");
 	}
-	(void)fputc(newline, cv->op);
+	put_newline(cv);
 }
+/*
+ * convert_close: close convert filter
+ *
+ *	i)	cv	CONVERT structure
+ *
+ * The rest of the output buffer is written.
+ */
 void
 convert_close(CONVERT *cv)
 {
+	convert_flush(cv);
+	strbuf_close(cv->ob);
+	strbuf_close(cv->lastpath);
+	strbuf_close(cv->lastconv);
 	strbuf_close(cv->abspath);
 	gpath_close();
 	free(cv);
@@ -31,7 +31,11 @@ typedef struct {
 	char basedir[MAXPATHLEN];
 	int start_point;
 	int db;			/* for gtags-cscope */
-
+	STRBUF *ob;		/* output buffer */
+	int interactive;	/* 1: flush output buffer every line */
+	STRBUF *lastpath;	/* last path name given */
+	STRBUF *lastconv;	/* converted last path name */
+	const char *label;	/* printed at the head of each record */
 } CONVERT;
 
 void set_encode_chars(const unsigned char *);
@@ -0,0 +1,397 @@
+/*
+ * Copyright (c) 2012 Tama Communications Corporation
+ *
+ * This file is part of GNU GLOBAL.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <stdio.h>
+#ifdef STDC_HEADERS
+#include <stdlib.h>
+#endif
+#ifdef HAVE_STRING_H
+#include <string.h>
+#else
+#include <strings.h>
+#endif
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+#ifdef HAVE_FCNTL_H
+#include <fcntl.h>
+#else
+#include <sys/file.h>
+#endif
+#ifdef HAVE_DIRENT_H
+#include <dirent.h>
+#endif
+#include <utime.h>
+
+#include "checkalloc.h"
+#include "dbop.h"
+#include "die.h"
+#include "getdbpath.h"
+#include "gpathop.h"
+#include "gtagsop.h"
+#include "locatestring.h"
+#include "makepath.h"
+#include "path.h"
+#include "querycache.h"
+#include "strbuf.h"
+#include "strhash.h"
+#include "test.h"
+#include "varray.h"
+
+#ifndef O_BINARY
+#define O_BINARY 0
+#endif
+
+/*
+ * Query cache: cache of the output of global(1).
+ *
+ * If environment variable GTAGSQUERYCACHE is set, global(1) saves the output
+ * of a tag search in the directory GCACHE in the dbpath, and prints it
+ * again for the same query without reading tag files.
+ *
+ * The key of a result consists of the query (command line, current
+ * directory and environment variables which affect the output) and
+ * the generation numbers of the tag files of the project and library
+ * trees in GTAGSLIBPATH. Since gtags(1) increments the generation number
+ * whenever it modifies tag files (See gpathop.c), an old result
+ * never matches. If the generation number is not available
+ * (tag files made by older gtags), the cache is not used.
+ *
+ * Each result is a file whose name is the hash value of the key.
+ *
+ *	<length of the key>\n<key><output>
+ *
+ * The value of GTAGSQUERYCACHE is the max size of the cache in kilobytes.
+ * (GTAGSCACHE is the size of the B-tree cache. See dbop.c)
+ * When the total size exceeds it, the least recently used results are
+ * removed.
+ */
+#define QUERYCACHE_SIZE	8192		/* default max size (KB) */
+
+static int active;			/* 1: the output is being saved */
+static int saved_fd = -1;		/* original standard output */
+static long header;			/* size of the header */
+static unsigned long limit;		/* max size of the cache (bytes) */
+static STRBUF *cachefile;		/* path of the result */
+static STRBUF *tmppath;			/* path of the temporary file */
+static STRBUF *cachedir;		/* path of the cache directory */
+
+static int generation(const char *, STRBUF *);
+static void copy_rest(int, int);
+static void evict(void);
+static void querycache_exit(void);
+
+/*
+ * generation: put the generation number of tag files.
+ *
+ *	i)	dbpath	dbpath directory
+ *	o)	sb	generation number is appended
+ *	r)		0: normal, -1: not available
+ */
+static int
+generation(const char *dbpath, STRBUF *sb)
+{
+	DBOP *dbop = dbop_open(makepath(dbpath, dbname(GPATH), NULL), 0, 0, 0);
+	const char *p;
+	int status = -1;
+
+	if (dbop == NULL)
+		return -1;
+	if ((p = dbop_get(dbop, GENERATIONKEY)) != NULL) {
+		strbuf_puts(sb, dbpath);
+		strbuf_putc(sb, ' ');
+		strbuf_puts(sb, p);
+		strbuf_putc(sb, '\n');
+		status = 0;
+	}
+	dbop_close(dbop);
+	return status;
+}
+/*
+ * querycache_begin: begin a cached query.
+ *
+ *	i)	dbpath	dbpath directory
+ *	i)	query	query (any bytes)
+ *	i)	len	length of the query
+ *	r)		1: hit; the cached output has been printed
+ *			0: miss; the output is saved until querycache_end()
+ *			-1: the cache is not used
+ *
+ * On miss, the standard output is redirected to a temporary file.
+ * Querycache_end() must be called after the query.
+ */
+int
+querycache_begin(const char *dbpath, const char *query, int len)
+{
+	STRBUF *key = strbuf_open(0);
+	const char *env = getenv("GTAGSQUERYCACHE");
+	const char *libpath = getenv("GTAGSLIBPATH");
+	unsigned long hash;
+	char buf[32];
+	int fd;
+
+	if (env == NULL)
+		return -1;
+	limit = (atol(env) > 0 ? atol(env) : QUERYCACHE_SIZE) * 1024UL;
+	/*
+	 * make key.
+	 */
+	strbuf_nputs(key, query, len);
+	strbuf_putc(key, '\n');
+	if (generation(dbpath, key) < 0) {
+		strbuf_close(key);
+		return -1;
+	}
+	if (libpath) {
+		STRBUF *sb = strbuf_open(0);
+		char libdbpath[MAXPATHLEN];
+		char *libdir, *nextp = NULL;
+
+		strbuf_puts(sb, libpath);
+		for (libdir = strbuf_value(sb); libdir; libdir = nextp) {
+			if ((nextp = locatestring(libdir, PATHSEP, MATCH_FIRST)) != NULL)
+				*nextp++ = 0;
+			if (!gtagsexist(libdir, libdbpath, sizeof(libdbpath), 0))
+				continue;
+			if (generation(libdbpath, key) < 0) {
+				strbuf_close(sb);
+				strbuf_close(key);
+				return -1;
+			}
+		}
+		strbuf_close(sb);
+	}
+	hash = strhash_value(strbuf_value(key), strbuf_getlen(key));
+	cachedir = strbuf_open(0);
+	strbuf_puts(cachedir, makepath(dbpath, QUERYCACHE_NAME, NULL));
+	cachefile = strbuf_open(0);
+	snprintf(buf, sizeof(buf), "%08lx", hash);
+	strbuf_puts(cachefile, makepath(strbuf_value(cachedir), buf, NULL));
+	snprintf(buf, sizeof(buf), "%d", (int)strbuf_getlen(key));
+	/*
+	 * Hit: print the output after the key.
+	 */
+	if ((fd = open(strbuf_value(cachefile), O_RDONLY|O_BINARY)) >= 0) {
+		STRBUF *ib = strbuf_open(0);
+		char *p;
+		int n, size = strlen(buf) + 1 + strbuf_getlen(key);
+
+		strbuf_nputc(ib, 0, size);
+		p = strbuf_value(ib);
+		n = read(fd, p, size);
+		if (n == size && !memcmp(p, buf, strlen(buf)) && p[strlen(buf)] == '\n'
+			&& !memcmp(p + strlen(buf) + 1, strbuf_value(key), strbuf_getlen(key)))
+		{
+			fflush(stdout);
+			copy_rest(fd, fileno(stdout));
+			close(fd);
+			/* the result is recently used. */
+			utime(strbuf_value(cachefile), NULL);
+			strbuf_close(ib);
+			strbuf_close(key);
+			return 1;
+		}
+		close(fd);
+		strbuf_close(ib);
+	}
+	/*
+	 * Miss: redirect the standard output to a temporary file.
+	 */
+	if (!test("d", strbuf_value(cachedir)) && mkdir(strbuf_value(cachedir), 0775) < 0) {
+		strbuf_close(key);
+		return -1;
+	}
+	tmppath = strbuf_open(0);
+	strbuf_puts(tmppath, strbuf_value(cachefile));
+	strbuf_sprintf(tmppath, ".%d", getpid());
+	if ((fd = open(strbuf_value(tmppath), O_RDWR|O_CREAT|O_TRUNC|O_BINARY, 0664)) < 0) {
+		strbuf_close(key);
+		return -1;
+	}
+	header = strlen(buf) + 1 + strbuf_getlen(key);
+	if (write(fd, buf, strlen(buf)) < 0 || write(fd, "\n", 1) < 0
+	    || write(fd, strbuf_value(key), strbuf_getlen(key)) < 0) {
+		close(fd);
+		unlink(strbuf_value(tmppath));
+		strbuf_close(key);
+		return -1;
+	}
+	strbuf_close(key);
+	fflush(stdout);
+	saved_fd = dup(fileno(stdout));
+	if (saved_fd < 0 || dup2(fd, fileno(stdout)) < 0)
+		die("cannot redirect standard output.");
+	close(fd);
+	active = 1;
+	/*
+	 * If global dies, the output is printed and the result is discarded.
+	 */
+	atexit(querycache_exit);
+	return 0;
+}
+/*
+ * querycache_end: end a cached query.
+ *
+ *	i)	store	1: save the result, 0: discard it
+ *
+ * The saved output is printed to the original standard output.
+ */
+void
+querycache_end(int store)
+{
+	int fd;
+
+	if (!active)
+		return;
+	active = 0;
+	fflush(stdout);
+	if (dup2(saved_fd, fileno(stdout)) < 0)
+		die("cannot restore standard output.");
+	close(saved_fd);
+	if ((fd = open(strbuf_value(tmppath), O_RDONLY|O_BINARY)) < 0)
+		die("cannot open '%s'.", strbuf_value(tmppath));
+	if (lseek(fd, header, SEEK_SET) < 0)
+		die("cannot seek '%s'.", strbuf_value(tmppath));
+	copy_rest(fd, fileno(stdout));
+	close(fd);
+	if (store && rename(strbuf_value(tmppath), strbuf_value(cachefile)) == 0)
+		evict();
+	else
+		unlink(strbuf_value(tmppath));
+}
+/*
+ * querycache_exit: discard the result at exit.
+ */
+static void
+querycache_exit(void)
+{
+	querycache_end(0);
+}
+/*
+ * copy_rest: copy the rest of a file.
+ *
+ *	i)	in	input file descriptor
+ *	i)	out	output file descriptor
+ */
+static void
+copy_rest(int in, int out)
+{
+	char buf[65536];
+	int n;
+
+	while ((n = read(in, buf, sizeof(buf))) > 0) {
+		char *p = buf;
+
+		while (n > 0) {
+			int w = write(out, p, n);
+
+			if (w < 0)
+				return;
+			p += w;
+			n -= w;
+		}
+	}
+}
+/*
+ * Cache entry for eviction.
+ */
+struct cache_entry {
+	char name[16];
+	time_t mtime;
+	off_t size;
+};
+static int
+compare_entry(const void *v1, const void *v2)
+{
+	const struct cache_entry *e1 = v1, *e2 = v2;
+
+	if (e1->mtime != e2->mtime)
+		return e1->mtime < e2->mtime ? -1 : 1;
+	return strcmp(e1->name, e2->name);
+}
+/*
+ * evict: remove least recently used results until the total size
+ * becomes less than the limit.
+ */
+static void
+evict(void)
+{
+	VARRAY *vb = varray_open(sizeof(struct cache_entry), 100);
+	struct cache_entry *entry;
+	struct dirent *dp;
+	struct stat st;
+	unsigned long total = 0;
+	DIR *dirp;
+	int i;
+
+	if ((dirp = opendir(strbuf_value(cachedir))) == NULL)
+		return;
+	while ((dp = readdir(dirp)) != NULL) {
+		if (strlen(dp->d_name) != 8)	/* skip temporary files */
+			continue;
+		if (stat(makepath(strbuf_value(cachedir), dp->d_name, NULL), &st) < 0)
+			continue;
+		entry = varray_append(vb);
+		strcpy(entry->name, dp->d_name);
+		entry->mtime = st.st_mtime;
+		entry->size = st.st_size;
+		total += st.st_size;
+	}
+	closedir(dirp);
+	if (total > limit) {
+		entry = varray_assign(vb, 0, 0);
+		qsort(entry, vb->length, sizeof(struct cache_entry), compare_entry);
+		for (i = 0; i < vb->length && total > limit; i++) {
+			unlink(makepath(strbuf_value(cachedir), entry[i].name, NULL));
+			total -= entry[i].size;
+		}
+	}
+	varray_close(vb);
+}
+/*
+ * querycache_purge: remove all results.
+ *
+ *	i)	dbpath	dbpath directory
+ *
+ * Gtags(1) calls this when it makes new tag files, since the generation
+ * number starts from 1 again.
+ */
+void
+querycache_purge(const char *dbpath)
+{
+	STRBUF *dir = strbuf_open(0);
+	struct dirent *dp;
+	DIR *dirp;
+
+	strbuf_puts(dir, makepath(dbpath, QUERYCACHE_NAME, NULL));
+	if ((dirp = opendir(strbuf_value(dir))) != NULL) {
+		while ((dp = readdir(dirp)) != NULL) {
+			if (!strcmp(dp->d_name, ".") || !strcmp(dp->d_name, ".."))
+				continue;
+			unlink(makepath(strbuf_value(dir), dp->d_name, NULL));
+		}
+		closedir(dirp);
+	}
+	strbuf_close(dir);
+}
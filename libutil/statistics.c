@@ -115,10 +115,21 @@ struct statistics_time {
 	char name[1];
 };
 
+struct statistics_count {
+	STAILQ_ENTRY(statistics_count) next;
+
+	unsigned long value;
+
+	int name_len;
+	char name[1];
+};
+
 static STRBUF *sb;
 static STATISTICS_TIME *T_all;
 static STAILQ_HEAD(statistics_time_list, statistics_time)
 	statistics_time_list = STAILQ_HEAD_INITIALIZER(statistics_time_list);
+static STAILQ_HEAD(statistics_count_list, statistics_count)
+	statistics_count_list = STAILQ_HEAD_INITIALIZER(statistics_count_list);
 
 void
 init_statistics(void)
@@ -134,6 +145,8 @@ statistics_time_start(const char *fmt, ...)
 	STATISTICS_TIME *t;
 	va_list ap;
 
+	if (sb == NULL)
+		return NULL;
 	strbuf_reset(sb);
 
 	va_start(ap, fmt);
@@ -163,6 +176,8 @@ statistics_time_end(STATISTICS_TIME *t)
 	CPU_TIME_TYPE system_end;
 #endif
 
+	if (t == NULL)
+		return;
 	GET_ELAPSED_TIME(&elapsed_end);
 	SUB_ELAPSED_TIME(&elapsed_end, &t->elapsed_start, &t->elapsed);
 
@@ -186,6 +201,37 @@ statistics_time_end(STATISTICS_TIME *t)
 	STAILQ_INSERT_TAIL(&statistics_time_list, t, next);
 }
 
+/*
+ * statistics_count: add value to the counter of the name.
+ *
+ *	i)	name	counter name
+ *	i)	value	value to add
+ *
+ * Counters of the same name are accumulated, and printed in the
+ * order of first appearance.
+ */
+void
+statistics_count(const char *name, unsigned long value)
+{
+	struct statistics_count *c;
+	int name_len;
+
+	if (sb == NULL)
+		return;
+	STAILQ_FOREACH(c, &statistics_count_list, next) {
+		if (!strcmp(c->name, name)) {
+			c->value += value;
+			return;
+		}
+	}
+	name_len = strlen(name);
+	c = check_malloc(offsetof(struct statistics_count, name) + name_len + 1);
+	c->value = value;
+	c->name_len = name_len;
+	strcpy(c->name, name);
+	STAILQ_INSERT_TAIL(&statistics_count_list, c, next);
+}
+
 struct printing_width {
 	int name;
 	int elapsed;
@@ -405,6 +451,97 @@ print_time_table(const STATISTICS_TIME *t, void *priv)
 #endif
 }
 
+static void
+print_time_tsv(const STATISTICS_TIME *t, void *priv)
+{
+#if CPU_TIME_AVAILABLE
+	message("time\t%s"
+		"\t%." PRECISION_STRING(USER) "f"
+		"\t%." PRECISION_STRING(SYSTEM) "f"
+		"\t%." PRECISION_STRING(ELAPSED) "f"
+		"\t%." PRECISION_STRING(PERCENT) "f",
+		t->name, t->user, t->system, t->elapsed, t->percent);
+#else
+	message("time\t%s\t-\t-\t%." PRECISION_STRING(ELAPSED) "f\t-",
+		t->name, t->elapsed);
+#endif
+}
+
+static int
+get_count_width(int *value_width)
+{
+	const struct statistics_count *c;
+	int name_width = 0;
+	int w;
+
+	STAILQ_FOREACH(c, &statistics_count_list, next) {
+		if (c->name_len > name_width)
+			name_width = c->name_len;
+		w = decimal_width(c->value);
+		if (w > *value_width)
+			*value_width = w;
+	}
+	return name_width;
+}
+
+static void
+print_counts_list(void)
+{
+	const struct statistics_count *c;
+	int name_width, value_width = 0;
+	char *dots;
+
+	name_width = get_count_width(&value_width);
+	dots = check_malloc(name_width + MIN_DOTS_LEN + 1);
+	memset(dots, '.', name_width + MIN_DOTS_LEN);
+	dots[name_width + MIN_DOTS_LEN] = '\0';
+	STAILQ_FOREACH(c, &statistics_count_list, next)
+		message("- %s %s %*lu", c->name, dots + c->name_len, value_width, c->value);
+	free(dots);
+}
+
+static const char count_heading_string[] = "counter";
+static const char value_heading_string[] = "value";
+
+static void
+print_counts_table(void)
+{
+	const struct statistics_count *c;
+	int name_width, value_width = sizeof(value_heading_string) - 1;
+	char *bar;
+	int bar_len;
+
+	name_width = get_count_width(&value_width);
+	if (name_width < sizeof(count_heading_string) - 1)
+		name_width = sizeof(count_heading_string) - 1;
+	bar_len = (name_width > value_width) ? name_width : value_width;
+	bar = check_malloc(bar_len + 1);
+	memset(bar, '-', bar_len);
+	bar[bar_len] = '\0';
+	message("%s", "");
+	message("%-*s %*s", name_width, count_heading_string, value_width, value_heading_string);
+	message("%.*s %.*s", name_width, bar, value_width, bar);
+	STAILQ_FOREACH(c, &statistics_count_list, next)
+		message("%-*s %*lu", name_width, c->name, value_width, c->value);
+	free(bar);
+}
+
+static void
+print_counts_tsv(void)
+{
+	const struct statistics_count *c;
+
+	STAILQ_FOREACH(c, &statistics_count_list, next)
+		message("count\t%s\t%lu", c->name, c->value);
+}
+
+static void
+print_header_tsv(void **ppriv)
+{
+	*ppriv = NULL;
+	setverbose();
+}
+
 static void
 print_footer_common(void *priv)
 {
@@ -415,15 +552,18 @@ struct printng_style {
 	void (*print_header)(void **);
 	void (*print_time)(const STATISTICS_TIME *, void *);
 	void (*print_footer)(void *);
+	void (*print_counts)(void);
 };
 
 static const struct printng_style printing_styles[] = {
 	/* STATISTICS_STYLE_NONE */
-	{ NULL, NULL, NULL },
+	{ NULL, NULL, NULL, NULL },
 	/* STATISTICS_STYLE_LIST */
-	{ print_header_list, print_time_list, print_footer_common },
+	{ print_header_list, print_time_list, print_footer_common, print_counts_list },
 	/* STATISTICS_STYLE_TABLE */
-	{ print_header_table, print_time_table, print_footer_common },
+	{ print_header_table, print_time_table, print_footer_common, print_counts_table },
+	/* STATISTICS_STYLE_TSV */
+	{ print_header_tsv, print_time_tsv, print_footer_common, print_counts_tsv },
 };
 
 #if !defined(ARRAY_SIZE)
@@ -459,6 +599,15 @@ print_statistics(int style_no)
 	if (style->print_footer != NULL)
 		style->print_footer(priv);
 
+	if (style->print_counts != NULL && !STAILQ_EMPTY(&statistics_count_list))
+		style->print_counts();
+	while (!STAILQ_EMPTY(&statistics_count_list)) {
+		struct statistics_count *c = STAILQ_FIRST(&statistics_count_list);
+
+		STAILQ_REMOVE_HEAD(&statistics_count_list, next);
+		free(c);
+	}
+
 	strbuf_close(sb);
 	T_all = NULL;
 	sb = NULL;
@@ -54,6 +54,10 @@
  *         print_statistics(style);
  *         exit(0);
  *     }
+ *
+ * statistics_time_start() returns NULL, and statistics_time_end() and
+ * statistics_count() do nothing unless init_statistics() was called,
+ * so that instrumented code need not check whether statistics are wanted.
  */
 struct statistics_time;
 typedef struct statistics_time STATISTICS_TIME;
@@ -82,17 +86,29 @@ typedef struct statistics_time STATISTICS_TIME;
  *     Time of making bar2    18.325       2.112       16.010 127.3
  *     ------------------- --------- ----------- ------------ -----
  *     The entire time        21.721       2.420       18.989 127.4
+ *
+ * STATISTICS_STYLE_TSV:
+ *    Print statistics information in tab separated values for programs,
+ *    and deallocate resource. Each line is either of:
+ *
+ *     time<TAB>name<TAB>user<TAB>system<TAB>elapsed<TAB>%CPU
+ *     count<TAB>name<TAB>value
+ *
+ * Counters recorded by statistics_count() are printed after the times
+ * in the same style.
  */
 enum {
 	STATISTICS_STYLE_NONE,
 	STATISTICS_STYLE_LIST,
-	STATISTICS_STYLE_TABLE
+	STATISTICS_STYLE_TABLE,
+	STATISTICS_STYLE_TSV
 };
 
 void init_statistics(void);
 STATISTICS_TIME *statistics_time_start(const char *, ...)
 	__attribute__ ((__format__ (__printf__, 1, 2)));
 void statistics_time_end(STATISTICS_TIME *);
+void statistics_count(const char *, unsigned long);
 void print_statistics(int);
 
 #endif
@@ -179,6 +179,28 @@ strhash_next(STRHASH *sh)
 	}
 	return entry;
 }
+/*
+ * strhash_value: FNV-1a hash value of a string.
+ *
+ *	i)	s	string
+ *	i)	len	length of the string
+ *	r)		hash value (32 bits)
+ *
+ * Unlike the hash for the buckets, the value is fixed by the algorithm,
+ * so it may be saved in files and compared with it in a later run.
+ */
+unsigned long
+strhash_value(const char *s, int len)
+{
+	unsigned long hash = 2166136261UL;
+	int i;
+
+	for (i = 0; i < len; i++) {
+		hash ^= (unsigned char)s[i];
+		hash = (hash * 16777619UL) & 0xffffffffUL;
+	}
+	return hash;
+}
 /*
  * strhash_reset: reset string hash.
  *
@@ -47,6 +47,7 @@ struct sh_entry *strhash_assign(STRHASH *, const char *, int);
 char * strhash_strdup(STRHASH *, const char *, int);
 struct sh_entry *strhash_first(STRHASH *);
 struct sh_entry *strhash_next(STRHASH *);
+unsigned long strhash_value(const char *, int);
 void strhash_reset(STRHASH *);
 void strhash_close(STRHASH *);
 
@@ -22,6 +22,11 @@
 #include <config.h>
 #endif
 #include <stdio.h>
+#ifdef HAVE_STRING_H
+#include <string.h>
+#else
+#include <strings.h>
+#endif
 
 #include "die.h"
 #include "tab.h"
@@ -112,6 +117,64 @@ read_file_detabing(char *buf, size_t size, FILE *ip, int *dest_saved, int *space
 	*spaces_saved = spaces;
 	return p - buf;
 }
+/*
+ * Read buffer converting tabs into spaces.
+ *
+ *	o)	buf	
+ *	i)	size	size of 'buf'
+ *	io)	curp	current pointer of the input buffer
+ *	i)	endp	end of the input buffer
+ *	o)	dest_saved	current column in 'buf'
+ *	o)	spaces_saved	left spaces
+ *	r)		size of data
+ *
+ * This is the same as read_file_detabing() except that the input is
+ * a memory buffer. A tab-free run is copied at a time.
+ */
+size_t
+read_buffer_detabing(char *buf, size_t size, const char **curp, const char *endp, int *dest_saved, int *spaces_saved)
+{
+	const char *q = *curp;
+	char *p;
+	int dest, spaces;
+
+	if (size == 0)
+		return 0;
+	p = buf;
+	dest = *dest_saved;
+	spaces = *spaces_saved;
+	if (spaces > 0)
+		PUTSPACES;
+	while (size > 0 && q < endp) {
+		if (*q == '\t') {
+			q++;
+			spaces = tabs - dest % tabs;
+			PUTSPACES;
+		} else {
+			const char *tab;
+			size_t n = endp - q, i;
+
+			if (n > size)
+				n = size;
+			if ((tab = memchr(q, '\t', n)) != NULL)
+				n = tab - q;
+			memcpy(p, q, n);
+			/*
+			 * The column restarts after the last newline.
+			 */
+			for (i = n; i > 0 && q[i - 1] != '\n'; i--)
+				;
+			dest = (i > 0) ? n - i : dest + n;
+			p += n;
+			q += n;
+			size -= n;
+		}
+	}
+	*curp = q;
+	*dest_saved = dest;
+	*spaces_saved = spaces;
+	return p - buf;
+}
 /*
  * detab_replacing: convert tabs into spaces and print with replacing.
  *
@@ -25,6 +25,7 @@
 
 void settabs(int);
 size_t read_file_detabing(char *, size_t, FILE *, int *, int *);
+size_t read_buffer_detabing(char *, size_t, const char **, const char *, int *, int *);
 void detab_replacing(FILE *op, const char *buf, const char *(*replace)(int c));
 
 